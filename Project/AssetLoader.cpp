@@ -0,0 +1,266 @@
+#include "AssetLoader.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <glad/glad.h>
+
+#include "Model.h"
+#include "TextureCache.h"
+#include "ThreadPool.h"
+
+AssetLoader::AssetLoader() : runningJobs(0), uploadBuffers(), nextUploadBuffer(0)
+{
+}
+
+AssetLoader & AssetLoader::shared()
+{
+	static AssetLoader loader;
+	return loader;
+}
+
+void AssetLoader::submit(const void * owner, std::function<void()> work, std::function<bool()> finish)
+{
+	queuedJobs.push_back(std::make_shared<Job>(Job{ owner, std::move(work), std::move(finish), false }));
+}
+
+void AssetLoader::cancel(const void * owner)
+{
+	queuedJobs.erase(std::remove_if(queuedJobs.begin(), queuedJobs.end(), [owner](const std::shared_ptr<Job>& job) { return job->owner == owner; }), queuedJobs.end());
+
+	// Jobs already handed to workers can't be stopped, they are skipped once they complete
+	for (auto& job : activeJobs)
+	{
+		if (job->owner == owner)
+		{
+			job->cancelled = true;
+			job->finish = nullptr;
+		}
+	}
+}
+
+unsigned int AssetLoader::requestTexture(const std::string & path)
+{
+	unsigned int textureID = TextureCache::acquire(path);
+	if (textureID != 0)
+	{
+		return textureID;
+	}
+
+	textureID = Model::createPlaceholderTexture(GL_TEXTURE_2D);
+	TextureCache::insert(path, textureID);
+	streamTexture(path, textureID, GL_TEXTURE_2D, { path });
+	return textureID;
+}
+
+unsigned int AssetLoader::requestCubemap(const std::string & cacheKey, const std::vector<std::string>& faces)
+{
+	unsigned int textureID = TextureCache::acquire(cacheKey);
+	if (textureID != 0)
+	{
+		return textureID;
+	}
+
+	textureID = Model::createPlaceholderTexture(GL_TEXTURE_CUBE_MAP);
+	TextureCache::insert(cacheKey, textureID);
+	streamTexture(cacheKey, textureID, GL_TEXTURE_CUBE_MAP, faces);
+	return textureID;
+}
+
+void AssetLoader::streamTexture(const std::string & cacheKey, unsigned int textureID, unsigned int target, const std::vector<std::string>& paths)
+{
+	TextureCache::acquire(cacheKey);
+
+	auto images = std::make_shared<std::vector<ImageData>>(paths.size());
+	submit(this, [images, paths]()
+	{
+		for (size_t i = 0; i < paths.size(); ++i)
+		{
+			Model::decodeImage(paths[i].c_str(), (*images)[i]);
+		}
+	},
+	[this, textureID, target, images]()
+	{
+		if (!uploadTexture(textureID, target, *images))
+		{
+			return false;
+		}
+		TextureCache::release(textureID);
+		return true;
+	});
+}
+
+bool AssetLoader::uploadTexture(unsigned int textureID, unsigned int target, const std::vector<ImageData>& images)
+{
+	size_t totalSize = 0;
+	for (const auto& image : images)
+	{
+		totalSize += image.getDataSize();
+	}
+	if (totalSize == 0)
+	{
+		// Nothing was decoded, texture keeps its placeholder
+		return true;
+	}
+
+	// The GPU may still be reading the previous upload from this buffer, try again next frame instead of waiting
+	UploadBuffer& upload = uploadBuffers[nextUploadBuffer];
+	if (upload.fence != nullptr)
+	{
+		GLenum status = glClientWaitSync(static_cast<GLsync>(upload.fence), 0, 0);
+		if (status == GL_TIMEOUT_EXPIRED)
+		{
+			return false;
+		}
+		glDeleteSync(static_cast<GLsync>(upload.fence));
+		upload.fence = nullptr;
+	}
+
+	if (upload.buffer == 0)
+	{
+		glGenBuffers(1, &upload.buffer);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.buffer);
+	if (upload.capacity < totalSize)
+	{
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, totalSize, nullptr, GL_STREAM_DRAW);
+		upload.capacity = totalSize;
+	}
+
+	unsigned char* mapped = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, totalSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+	if (mapped == nullptr)
+	{
+		// Fall back to uploading straight from client memory
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		std::vector<const unsigned char*> data;
+		for (const auto& image : images)
+		{
+			data.push_back(image.getData());
+		}
+		if (target == GL_TEXTURE_CUBE_MAP)
+		{
+			Model::setCubemapImages(textureID, images, data);
+		}
+		else
+		{
+			Model::setTextureImage(textureID, images[0], data[0]);
+		}
+		return true;
+	}
+
+	// With the buffer bound, texture upload takes offsets into it instead of pointers
+	std::vector<const unsigned char*> offsets;
+	size_t offset = 0;
+	for (const auto& image : images)
+	{
+		size_t size = image.getDataSize();
+		if (size != 0)
+		{
+			memcpy(mapped + offset, image.getData(), size);
+		}
+		offsets.push_back(reinterpret_cast<const unsigned char*>(offset));
+		offset += size;
+	}
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+	if (target == GL_TEXTURE_CUBE_MAP)
+	{
+		Model::setCubemapImages(textureID, images, offsets);
+	}
+	else if (images[0].isValid())
+	{
+		Model::setTextureImage(textureID, images[0], offsets[0]);
+	}
+
+	upload.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	nextUploadBuffer = (nextUploadBuffer + 1) % UPLOAD_RING_SIZE;
+	return true;
+}
+
+void AssetLoader::update(float budgetMs)
+{
+	deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(static_cast<long long>(budgetMs * 1000.0f));
+	dispatchJobs();
+
+	while (!isOverBudget())
+	{
+		std::shared_ptr<Job> job;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (completedJobs.empty())
+			{
+				break;
+			}
+			job = completedJobs.front();
+		}
+
+		// A finish that couldn't complete stays at the front so jobs finish in the order they were submitted
+		if (!job->cancelled && !job->finish())
+		{
+			break;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			completedJobs.pop_front();
+		}
+		removeActiveJob(job);
+		dispatchJobs();
+	}
+}
+
+bool AssetLoader::isOverBudget() const
+{
+	return std::chrono::steady_clock::now() >= deadline;
+}
+
+void AssetLoader::shutdown()
+{
+	queuedJobs.clear();
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		jobCompleted.wait(lock, [this]() { return runningJobs == 0; });
+		completedJobs.clear();
+	}
+	activeJobs.clear();
+
+	for (auto& upload : uploadBuffers)
+	{
+		if (upload.fence != nullptr)
+		{
+			glDeleteSync(static_cast<GLsync>(upload.fence));
+		}
+		glDeleteBuffers(1, &upload.buffer);
+		upload = UploadBuffer();
+	}
+}
+
+void AssetLoader::dispatchJobs()
+{
+	while (!queuedJobs.empty() && activeJobs.size() < MAX_JOBS_IN_FLIGHT)
+	{
+		std::shared_ptr<Job> job = queuedJobs.front();
+		queuedJobs.pop_front();
+		activeJobs.push_back(job);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			++runningJobs;
+		}
+
+		ThreadPool::shared().submit([this, job]()
+		{
+			job->work();
+
+			std::lock_guard<std::mutex> lock(mutex);
+			completedJobs.push_back(job);
+			--runningJobs;
+			jobCompleted.notify_all();
+		});
+	}
+}
+
+void AssetLoader::removeActiveJob(const std::shared_ptr<Job>& job)
+{
+	activeJobs.erase(std::remove(activeJobs.begin(), activeJobs.end(), job), activeJobs.end());
+}
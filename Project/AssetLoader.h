@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct ImageData;
+
+// Streams assets in the background. File reading and decoding runs on the shared thread pool, while GL work is queued
+// and drained on the GL thread by update() within a per-frame time budget. Texture data goes to the GPU through a ring
+// of pixel unpack buffers so the driver copy doesn't stall the frame. Must only be called from the GL thread
+class AssetLoader
+{
+public:
+	// Loader shared by the whole application, created on first use
+	static AssetLoader& shared();
+	// Queues a job: work runs on a worker thread, then finish runs on the GL thread during update().
+	// Finish returns false when it ran out of budget and has to be called again next frame.
+	// Jobs of an owner that is about to be destroyed must be cancelled
+	void submit(const void* owner, std::function<void()> work, std::function<bool()> finish);
+	// Drops queued and finished jobs of the owner, their finish is never called
+	void cancel(const void* owner);
+	// Returns shared texture for the path immediately. Until the image is decoded and uploaded the texture holds
+	// a 1x1 placeholder. Increments reference count in TextureCache like TextureCache::load
+	unsigned int requestTexture(const std::string& path);
+	// Same as requestTexture for a cubemap made of 6 faces, cached under cacheKey
+	unsigned int requestCubemap(const std::string& cacheKey, const std::vector<std::string>& faces);
+	// Dispatches queued jobs to workers and finishes completed ones until budget runs out. Called once per frame
+	void update(float budgetMs);
+	// True when the current update() has used up its budget, lets long finish steps split their work across frames
+	bool isOverBudget() const;
+	// Waits for running jobs and releases GL resources, must be called before the GL context is destroyed
+	void shutdown();
+
+	AssetLoader(const AssetLoader& loader) = delete;
+	AssetLoader& operator=(const AssetLoader& loader) = delete;
+private:
+	struct Job
+	{
+		const void* owner;
+		std::function<void()> work;
+		std::function<bool()> finish;
+		bool cancelled;
+	};
+
+	// Pixel unpack buffer that can be reused once the GPU signals it has consumed its previous upload
+	struct UploadBuffer
+	{
+		unsigned int buffer;
+		size_t capacity;
+		void* fence;
+	};
+
+	static const unsigned int UPLOAD_RING_SIZE = 3;
+	// Decoded images wait in memory until uploaded, so the number of jobs handed to workers at once is bounded
+	static const unsigned int MAX_JOBS_IN_FLIGHT = 8;
+
+	std::deque<std::shared_ptr<Job>> queuedJobs;     // Waiting for a free slot, GL thread only
+	std::deque<std::shared_ptr<Job>> completedJobs;  // Work done, waiting for finish; guarded by mutex
+	std::vector<std::shared_ptr<Job>> activeJobs;    // Dispatched and not finished yet, GL thread only
+	std::mutex mutex;
+	std::condition_variable jobCompleted;
+	unsigned int runningJobs;
+	UploadBuffer uploadBuffers[UPLOAD_RING_SIZE];
+	unsigned int nextUploadBuffer;
+	std::chrono::steady_clock::time_point deadline;
+
+	AssetLoader();
+	// Queues decoding of images and their upload into an existing texture. The loader holds a reference to the
+	// texture until the upload is done so it can't be deleted in between
+	void streamTexture(const std::string& cacheKey, unsigned int textureID, unsigned int target, const std::vector<std::string>& paths);
+	// Uploads decoded images to the texture through the next buffer of the ring, returns false if the buffer is still in use
+	bool uploadTexture(unsigned int textureID, unsigned int target, const std::vector<ImageData>& images);
+	void dispatchJobs();
+	void removeActiveJob(const std::shared_ptr<Job>& job);
+};
@@ -0,0 +1,141 @@
+#include "AtlasPacker.h"
+
+#include <algorithm>
+#include <cstring>
+
+bool AtlasPacker::pack(std::vector<Rect>& rects, int padding, int maxSize, int& atlasWidth, int& atlasHeight)
+{
+	// Tall images first leave the flattest skyline
+	std::vector<size_t> order(rects.size());
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&rects](size_t a, size_t b) {
+		return rects[a].height != rects[b].height ? rects[a].height > rects[b].height : rects[a].width > rects[b].width;
+	});
+
+	// Width is doubled first, so the atlas stays square or twice as wide as tall
+	int width = 4;
+	int height = 4;
+	while (width <= maxSize && height <= maxSize)
+	{
+		if (packInto(rects, order, padding, width, height))
+		{
+			atlasWidth = width;
+			atlasHeight = height;
+			return true;
+		}
+		if (width == height)
+		{
+			width *= 2;
+		}
+		else
+		{
+			height *= 2;
+		}
+	}
+	return false;
+}
+
+void AtlasPacker::copyImage(std::vector<unsigned char>& atlas, int atlasWidth, int atlasHeight, const unsigned char* pixels, const Rect& rect, int padding)
+{
+	for (int y = -padding; y < rect.height + padding; ++y)
+	{
+		int atlasY = rect.y + y;
+		if (atlasY < 0 || atlasY >= atlasHeight)
+		{
+			continue;
+		}
+		int sourceY = std::min(std::max(y, 0), rect.height - 1);
+		for (int x = -padding; x < rect.width + padding; ++x)
+		{
+			int atlasX = rect.x + x;
+			if (atlasX < 0 || atlasX >= atlasWidth)
+			{
+				continue;
+			}
+			int sourceX = std::min(std::max(x, 0), rect.width - 1);
+			memcpy(&atlas[(static_cast<size_t>(atlasY) * atlasWidth + atlasX) * 4], &pixels[(static_cast<size_t>(sourceY) * rect.width + sourceX) * 4], 4);
+		}
+	}
+}
+
+bool AtlasPacker::packInto(std::vector<Rect>& rects, const std::vector<size_t>& order, int padding, int width, int height)
+{
+	std::vector<SkylineNode> skyline = { SkylineNode{ 0, 0, width } };
+	for (size_t index : order)
+	{
+		int paddedWidth = rects[index].width + 2 * padding;
+		int paddedHeight = rects[index].height + 2 * padding;
+
+		// Place where the image top ends lowest, leftmost one among equal places
+		size_t bestNode = skyline.size();
+		int bestY = 0;
+		for (size_t node = 0; node < skyline.size(); ++node)
+		{
+			int y = findRestingY(skyline, node, paddedWidth, width);
+			if (y >= 0 && y + paddedHeight <= height && (bestNode == skyline.size() || y < bestY))
+			{
+				bestNode = node;
+				bestY = y;
+			}
+		}
+		if (bestNode == skyline.size())
+		{
+			return false;
+		}
+
+		int x = skyline[bestNode].x;
+		rects[index].x = x + padding;
+		rects[index].y = bestY + padding;
+
+		// New node covers the image, nodes under it are shortened or removed
+		skyline.insert(skyline.begin() + bestNode, SkylineNode{ x, bestY + paddedHeight, paddedWidth });
+		for (size_t node = bestNode + 1; node < skyline.size();)
+		{
+			int overlap = x + paddedWidth - skyline[node].x;
+			if (overlap <= 0)
+			{
+				break;
+			}
+			if (overlap < skyline[node].width)
+			{
+				skyline[node].x += overlap;
+				skyline[node].width -= overlap;
+				break;
+			}
+			skyline.erase(skyline.begin() + node);
+		}
+		// Neighbours of the same height become one node
+		for (size_t node = 0; node + 1 < skyline.size();)
+		{
+			if (skyline[node].y == skyline[node + 1].y)
+			{
+				skyline[node].width += skyline[node + 1].width;
+				skyline.erase(skyline.begin() + node + 1);
+			}
+			else
+			{
+				++node;
+			}
+		}
+	}
+	return true;
+}
+
+int AtlasPacker::findRestingY(const std::vector<SkylineNode>& skyline, size_t index, int width, int atlasWidth)
+{
+	if (skyline[index].x + width > atlasWidth)
+	{
+		return -1;
+	}
+	int y = 0;
+	int remaining = width;
+	for (size_t node = index; remaining > 0 && node < skyline.size(); ++node)
+	{
+		y = std::max(y, skyline[node].y);
+		remaining -= skyline[node].width;
+	}
+	return y;
+}
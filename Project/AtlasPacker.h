@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Packs images into one atlas with a skyline bottom-left packer. Doesn't touch GL, so it is shared by the game,
+// which packs an atlas at runtime when it wasn't cooked, and by TextureCooker
+class AtlasPacker
+{
+public:
+	// Place of one image in the atlas, padding around it is not included
+	struct Rect
+	{
+		int x = 0;
+		int y = 0;
+		int width = 0;
+		int height = 0;
+	};
+
+	// Padding around images and largest atlas size used by the game and TextureCooker, so both pack the same way
+	static const int SPRITE_PADDING = 2;
+	static const int MAX_ATLAS_SIZE = 4096;
+
+	// Places every rect, sizes are given and positions are filled in. Atlas is the smallest power of two size up to
+	// maxSize that fits all of them, false if even that is too small
+	static bool pack(std::vector<Rect>& rects, int padding, int maxSize, int& atlasWidth, int& atlasHeight);
+	// Copies RGBA image into the RGBA atlas at rect. Edge pixels are repeated into the padding, so filtering and
+	// smaller mip levels don't pick up pixels of neighbouring images
+	static void copyImage(std::vector<unsigned char>& atlas, int atlasWidth, int atlasHeight, const unsigned char* pixels, const Rect& rect, int padding);
+private:
+	// Top edge of already placed images over a span of the atlas width
+	struct SkylineNode
+	{
+		int x;
+		int y;
+		int width;
+	};
+
+	static bool packInto(std::vector<Rect>& rects, const std::vector<size_t>& order, int padding, int width, int height);
+	// Lowest y where a rect of the width can rest on the skyline starting at node index, -1 if it doesn't fit
+	static int findRestingY(const std::vector<SkylineNode>& skyline, size_t index, int width, int atlasWidth);
+};
@@ -3,8 +3,6 @@
 out vec4 FragColor;
 
 struct Material {
-    sampler2D texture_diffuse1;
-    sampler2D texture_specular1;
     vec3 ambient;
     vec3 diffuse;
     vec3 specular;
@@ -18,18 +16,6 @@ struct DirectionLight {
     vec3 specular;
 };
 
-struct PointLight {
-    vec3 position;
-    
-    float constant;
-    float linear;
-    float quadratic;
-	
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
 struct SpotLight {
     vec3 position;
     vec3 direction;
@@ -49,32 +35,94 @@ in vec3 FragPos;
 in vec3 Normal;  
 in vec2 TexCoords;
   
-uniform vec3 viewPos;
-uniform Material material;
-uniform DirectionLight dirLight;
-uniform PointLight pointLight;
-uniform SpotLight spotLight;
+layout (std140) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+
+// Point and spot lights are assigned to clusters of the view frustum on the CPU (see LightClusters), a fragment only
+// evaluates the lights of its cluster. Cluster scale maps fragment coordinates to the column and row and log of view
+// depth to the slice
+layout (std140) uniform Lights
+{
+    DirectionLight dirLight;
+    SpotLight spotLight;
+    vec4 clusterScale;
+    ivec4 clusterCount;
+};
+
+#ifndef NO_CLUSTERED_LIGHTS
+// 5 texels per light, point lights are spot lights with a cone that includes everything
+uniform samplerBuffer lightData;
+// First index and number of lights of every cluster
+uniform usamplerBuffer lightClusters;
+uniform usamplerBuffer lightIndices;
+#endif
+
+layout (std140) uniform MaterialData
+{
+    Material material;
+};
+
+// Features of the variant are defined by ShaderVariants, code of the missing ones is compiled away
+uniform sampler2D texture_diffuse1;
+#ifdef HAS_SPECULAR_MAP
+uniform sampler2D texture_specular1;
+#endif
+
+// Material colors of the fragment, textures are sampled once for all lights
+struct Surface {
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
 
-vec3 CalculateDirectionLight(DirectionLight light, vec3 normal, vec3 viewDir);
-vec3 CalculatePointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
-vec3 CalculateSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+vec3 CalculateDirectionLight(DirectionLight light, Surface surface, vec3 normal, vec3 viewDir);
+vec3 CalculateSpotLight(SpotLight light, Surface surface, vec3 normal, vec3 fragPos, vec3 viewDir);
+SpotLight FetchLight(int index);
 
 void main()
 {
+    vec4 diffuseColor = texture(texture_diffuse1, TexCoords);
+#ifdef ALPHA_TEST
+    if (diffuseColor.a < 0.1)
+        discard;
+#endif
+#ifdef HAS_SPECULAR_MAP
+    vec3 specularColor = vec3(texture(texture_specular1, TexCoords));
+#else
+    // Without specular map the diffuse map modulates the highlights
+    vec3 specularColor = diffuseColor.rgb;
+#endif
+    Surface surface = Surface(material.ambient * diffuseColor.rgb, material.diffuse * diffuseColor.rgb, material.specular * specularColor);
+
     vec3 norm = normalize(Normal);    
     // Directional Light
     vec3 viewDir = normalize(viewPos - FragPos);
-    vec3 result = CalculateDirectionLight(dirLight, norm, viewDir);
-    // Point light
-    result += CalculatePointLight(pointLight, norm, FragPos, viewDir);
-    // Spot light
-    result += CalculateSpotLight(spotLight, norm, FragPos, viewDir);
+    vec3 result = CalculateDirectionLight(dirLight, surface, norm, viewDir);
+#ifndef NO_SPOTLIGHT
+    // Flashlight
+    result += CalculateSpotLight(spotLight, surface, norm, FragPos, viewDir);
+#endif
+#ifndef NO_CLUSTERED_LIGHTS
+    // Point and spot lights of the cluster
+    float viewDepth = -(view * vec4(FragPos, 1.0)).z;
+    ivec3 cluster = ivec3(gl_FragCoord.xy * clusterScale.xy, log(max(viewDepth, 1e-4)) * clusterScale.z + clusterScale.w);
+    cluster = clamp(cluster, ivec3(0), clusterCount.xyz - 1);
+    uvec2 lights = texelFetch(lightClusters, (cluster.z * clusterCount.y + cluster.y) * clusterCount.x + cluster.x).xy;
+    for (uint i = 0u; i < lights.y; ++i)
+    {
+        result += CalculateSpotLight(FetchLight(int(texelFetch(lightIndices, int(lights.x + i)).x)), surface, norm, FragPos, viewDir);
+    }
+#endif
     // Result color
-    FragColor = vec4(result, texture(material.texture_diffuse1, TexCoords).a);
+    FragColor = vec4(result, diffuseColor.a);
 }
 
 // calculates the color when using a directional light.
-vec3 CalculateDirectionLight(DirectionLight light, vec3 normal, vec3 viewDir)
+vec3 CalculateDirectionLight(DirectionLight light, Surface surface, vec3 normal, vec3 viewDir)
 {
     vec3 lightDir = normalize(-light.direction);
     // diffuse shading
@@ -83,36 +131,14 @@ vec3 CalculateDirectionLight(DirectionLight light, vec3 normal, vec3 viewDir)
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
     // combine results
-    vec3 ambient = light.ambient * material.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * material.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * material.specular * spec * vec3(texture(material.texture_specular1, TexCoords));
-    return (ambient + diffuse + specular);
-}
-
-// calculates the color when using a point light.
-vec3 CalculatePointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
-{
-    vec3 lightDir = normalize(light.position - fragPos);
-    // diffuse shading
-    float diff = max(dot(normal, lightDir), 0.0);
-    // specular shading
-    vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    // attenuation
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
-    // combine results
-    vec3 ambient = light.ambient * material.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * material.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * material.specular * spec * vec3(texture(material.texture_specular1, TexCoords));
-    ambient *= attenuation;
-    diffuse *= attenuation;
-    specular *= attenuation;
+    vec3 ambient = light.ambient * surface.ambient;
+    vec3 diffuse = light.diffuse * surface.diffuse * diff;
+    vec3 specular = light.specular * surface.specular * spec;
     return (ambient + diffuse + specular);
 }
 
 // calculates the color when using a spot light.
-vec3 CalculateSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+vec3 CalculateSpotLight(SpotLight light, Surface surface, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
     vec3 lightDir = normalize(light.position - fragPos);
     // diffuse shading
@@ -128,11 +154,23 @@ vec3 CalculateSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir
     float epsilon = light.cutOff - light.outerCutOff;
     float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
     // combine results
-    vec3 ambient = light.ambient * material.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * material.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * material.specular * spec * vec3(texture(material.texture_specular1, TexCoords));
-    ambient *= attenuation * intensity;
-    diffuse *= attenuation * intensity;
-    specular *= attenuation * intensity;
-    return (ambient + diffuse + specular);
-}
\ No newline at end of file
+    vec3 ambient = light.ambient * surface.ambient;
+    vec3 diffuse = light.diffuse * surface.diffuse * diff;
+    vec3 specular = light.specular * surface.specular * spec;
+    return (ambient + diffuse + specular) * attenuation * intensity;
+}
+
+#ifndef NO_CLUSTERED_LIGHTS
+// reads a light of the clusters from the light buffer
+SpotLight FetchLight(int index)
+{
+    int texel = index * 5;
+    vec4 positionConstant = texelFetch(lightData, texel);
+    vec4 ambientLinear = texelFetch(lightData, texel + 1);
+    vec4 diffuseQuadratic = texelFetch(lightData, texel + 2);
+    vec4 specularOuterCutOff = texelFetch(lightData, texel + 3);
+    vec4 directionCutOff = texelFetch(lightData, texel + 4);
+    return SpotLight(positionConstant.xyz, directionCutOff.xyz, directionCutOff.w, specularOuterCutOff.w, positionConstant.w, ambientLinear.w,
+        diffuseQuadratic.w, ambientLinear.xyz, diffuseQuadratic.xyz, specularOuterCutOff.xyz);
+}
+#endif
@@ -0,0 +1,245 @@
+#include "Bvh.h"
+
+#include <numeric>
+
+void Bvh::build(const Bounds * bounds, size_t count)
+{
+	clear();
+	if (count == 0)
+	{
+		return;
+	}
+
+	ownedPrimitives.resize(count);
+	std::iota(ownedPrimitives.begin(), ownedPrimitives.end(), 0);
+	std::vector<glm::vec3> centroids(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		centroids[i] = (bounds[i].min + bounds[i].max) * 0.5f;
+	}
+
+	ownedNodes.reserve(count * 2 - 1);
+	buildNode(bounds, centroids, 0, static_cast<uint32_t>(count), 0);
+	attach(ownedNodes.data(), static_cast<uint32_t>(ownedNodes.size()), ownedPrimitives.data(), static_cast<uint32_t>(ownedPrimitives.size()));
+}
+
+void Bvh::attach(const BvhNode * attachedNodes, uint32_t attachedNodeCount, const uint32_t * attachedPrimitives, uint32_t attachedPrimitiveCount)
+{
+	nodes = attachedNodes;
+	nodeCount = attachedNodeCount;
+	primitives = attachedPrimitives;
+	primitiveCount = attachedPrimitiveCount;
+}
+
+void Bvh::refit(const Bounds * bounds)
+{
+	// Children always follow their parent, so walking backwards updates them before it
+	for (size_t i = ownedNodes.size(); i > 0; --i)
+	{
+		BvhNode& node = ownedNodes[i - 1];
+		if (node.count > 0)
+		{
+			node.min = glm::vec3(FLT_MAX);
+			node.max = glm::vec3(-FLT_MAX);
+			for (uint32_t j = 0; j < node.count; ++j)
+			{
+				const Bounds& primitive = bounds[ownedPrimitives[node.offset + j]];
+				node.min = glm::min(node.min, primitive.min);
+				node.max = glm::max(node.max, primitive.max);
+			}
+		}
+		else
+		{
+			const BvhNode& left = ownedNodes[i];
+			const BvhNode& right = ownedNodes[node.offset];
+			node.min = glm::min(left.min, right.min);
+			node.max = glm::max(left.max, right.max);
+		}
+	}
+}
+
+void Bvh::clear()
+{
+	ownedNodes.clear();
+	ownedPrimitives.clear();
+	attach(nullptr, 0, nullptr, 0);
+}
+
+Bounds Bvh::getBounds() const
+{
+	Bounds bounds;
+	bounds.min = nodeCount > 0 ? nodes[0].min : glm::vec3(0.0f);
+	bounds.max = nodeCount > 0 ? nodes[0].max : glm::vec3(0.0f);
+	bounds.sphereCenter = (bounds.min + bounds.max) * 0.5f;
+	bounds.sphereRadius = glm::length(bounds.max - bounds.min) * 0.5f;
+	return bounds;
+}
+
+bool Bvh::validate(const BvhNode * nodes, uint32_t nodeCount, const uint32_t * primitives, uint32_t primitiveCount, uint32_t primitiveLimit)
+{
+	for (uint32_t i = 0; i < primitiveCount; ++i)
+	{
+		if (primitives[i] >= primitiveLimit)
+		{
+			return false;
+		}
+	}
+	if (nodeCount == 0)
+	{
+		return true;
+	}
+
+	// Walk the tree from the root, every node must be reached exactly once within the depth limit
+	struct Entry
+	{
+		uint32_t node;
+		unsigned int depth;
+	};
+	std::vector<Entry> stack = { { 0, 0 } };
+	uint32_t visited = 0;
+	while (!stack.empty())
+	{
+		Entry entry = stack.back();
+		stack.pop_back();
+		const BvhNode& node = nodes[entry.node];
+		++visited;
+		if (node.count > 0)
+		{
+			if (uint64_t(node.offset) + node.count > primitiveCount)
+			{
+				return false;
+			}
+			continue;
+		}
+		// Left child follows the node and the right child comes after the left subtree
+		if (entry.depth >= MAX_DEPTH || node.offset <= entry.node + 1 || node.offset >= nodeCount || entry.node + 1 >= nodeCount)
+		{
+			return false;
+		}
+		stack.push_back({ node.offset, entry.depth + 1 });
+		stack.push_back({ entry.node + 1, entry.depth + 1 });
+	}
+	return visited == nodeCount;
+}
+
+uint32_t Bvh::buildNode(const Bounds * bounds, const std::vector<glm::vec3>& centroids, uint32_t first, uint32_t count, unsigned int depth)
+{
+	uint32_t index = static_cast<uint32_t>(ownedNodes.size());
+	ownedNodes.push_back(BvhNode());
+
+	glm::vec3 nodeMin(FLT_MAX), nodeMax(-FLT_MAX);
+	glm::vec3 centroidMin(FLT_MAX), centroidMax(-FLT_MAX);
+	for (uint32_t i = first; i < first + count; ++i)
+	{
+		uint32_t primitive = ownedPrimitives[i];
+		nodeMin = glm::min(nodeMin, bounds[primitive].min);
+		nodeMax = glm::max(nodeMax, bounds[primitive].max);
+		centroidMin = glm::min(centroidMin, centroids[primitive]);
+		centroidMax = glm::max(centroidMax, centroids[primitive]);
+	}
+	ownedNodes[index].min = nodeMin;
+	ownedNodes[index].max = nodeMax;
+	ownedNodes[index].offset = first;
+	ownedNodes[index].count = count;
+	if (count <= MAX_LEAF_SIZE || depth >= MAX_DEPTH)
+	{
+		return index;
+	}
+
+	// Find the cheapest split between bins of centroids along any axis
+	struct Bin
+	{
+		glm::vec3 min = glm::vec3(FLT_MAX);
+		glm::vec3 max = glm::vec3(-FLT_MAX);
+		uint32_t count = 0;
+	};
+	float bestCost = FLT_MAX;
+	int bestAxis = -1;
+	unsigned int bestSplit = 0;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float extent = centroidMax[axis] - centroidMin[axis];
+		if (extent <= 0.0f)
+		{
+			continue;
+		}
+
+		Bin bins[BIN_COUNT];
+		float binScale = BIN_COUNT / extent;
+		for (uint32_t i = first; i < first + count; ++i)
+		{
+			uint32_t primitive = ownedPrimitives[i];
+			unsigned int bin = std::min(BIN_COUNT - 1, static_cast<unsigned int>((centroids[primitive][axis] - centroidMin[axis]) * binScale));
+			bins[bin].min = glm::min(bins[bin].min, bounds[primitive].min);
+			bins[bin].max = glm::max(bins[bin].max, bounds[primitive].max);
+			++bins[bin].count;
+		}
+
+		// Sweep from the right to get the cost of every right side, then from the left to combine them
+		float rightCosts[BIN_COUNT];
+		Bin right;
+		for (unsigned int i = BIN_COUNT - 1; i > 0; --i)
+		{
+			right.min = glm::min(right.min, bins[i].min);
+			right.max = glm::max(right.max, bins[i].max);
+			right.count += bins[i].count;
+			rightCosts[i] = right.count > 0 ? right.count * getArea(right.min, right.max) : 0.0f;
+		}
+		Bin left;
+		for (unsigned int i = 1; i < BIN_COUNT; ++i)
+		{
+			left.min = glm::min(left.min, bins[i - 1].min);
+			left.max = glm::max(left.max, bins[i - 1].max);
+			left.count += bins[i - 1].count;
+			if (left.count == 0 || left.count == count)
+			{
+				continue;
+			}
+			float cost = left.count * getArea(left.min, left.max) + rightCosts[i];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = i;
+			}
+		}
+	}
+
+	// Keep primitives together if no split is cheaper than testing all of them
+	float area = getArea(nodeMin, nodeMax);
+	if (bestAxis < 0 || (area > 0.0f && TRAVERSAL_COST + bestCost / area >= count))
+	{
+		return index;
+	}
+
+	float binScale = BIN_COUNT / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+	auto middle = std::partition(ownedPrimitives.begin() + first, ownedPrimitives.begin() + first + count, [&](uint32_t primitive)
+	{
+		unsigned int bin = std::min(BIN_COUNT - 1, static_cast<unsigned int>((centroids[primitive][bestAxis] - centroidMin[bestAxis]) * binScale));
+		return bin < bestSplit;
+	});
+	uint32_t leftCount = static_cast<uint32_t>(middle - ownedPrimitives.begin()) - first;
+
+	ownedNodes[index].count = 0;
+	buildNode(bounds, centroids, first, leftCount, depth + 1);
+	uint32_t rightChild = buildNode(bounds, centroids, first + leftCount, count - leftCount, depth + 1);
+	ownedNodes[index].offset = rightChild;
+	return index;
+}
+
+float Bvh::getArea(const glm::vec3 & min, const glm::vec3 & max)
+{
+	glm::vec3 size = max - min;
+	return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+float Bvh::intersectRay(const glm::vec3 & boxMin, const glm::vec3 & boxMax, const glm::vec3 & origin, const glm::vec3 & inverseDirection, float maxDistance)
+{
+	glm::vec3 t0 = (boxMin - origin) * inverseDirection;
+	glm::vec3 t1 = (boxMax - origin) * inverseDirection;
+	glm::vec3 tNear = glm::min(t0, t1);
+	glm::vec3 tFar = glm::max(t0, t1);
+	float entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+	float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+	return entry <= exit ? entry : FLT_MAX;
+}
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Frustum.h"
+#include "Mesh.h"
+
+// Node of a flattened hierarchy, 32 bytes so two share a cache line. Nodes are stored depth first: the left child of
+// an inner node directly follows it, so only the right child index is stored
+struct BvhNode
+{
+	glm::vec3 min;
+	uint32_t offset;   // Inner node: index of the right child, leaf: first entry of the primitive index array
+	glm::vec3 max;
+	uint32_t count;    // Number of primitives of a leaf, 0 for inner nodes
+};
+
+// Bounding volume hierarchy over boxes of primitives (meshes of a model, models of a scene) built with the binned surface
+// area heuristic. Queries report primitives by their index in the array the hierarchy was built from. Nodes are either
+// owned or attached from memory owned elsewhere, e.g. mapped from the cooked mesh file
+class Bvh
+{
+public:
+	Bvh() = default;
+	// Builds hierarchy over the primitive boxes
+	void build(const Bounds* bounds, size_t count);
+	// Uses nodes and primitive indices that must outlive the hierarchy; they aren't copied
+	void attach(const BvhNode* nodes, uint32_t nodeCount, const uint32_t* primitives, uint32_t primitiveCount);
+	// Updates boxes of the owned nodes after primitives moved, keeps the tree structure. Cheaper than a rebuild but the
+	// tree degrades when primitives move far
+	void refit(const Bounds* bounds);
+	void clear();
+
+	bool isEmpty() const { return nodeCount == 0; }
+	const BvhNode* getNodes() const { return nodes; }
+	uint32_t getNodeCount() const { return nodeCount; }
+	const uint32_t* getPrimitives() const { return primitives; }
+	uint32_t getPrimitiveCount() const { return primitiveCount; }
+	// Box enclosing all primitives
+	Bounds getBounds() const;
+
+	// Checks that stored nodes only reference nodes and primitives within the arrays, so a corrupted file can't make
+	// traversal read out of bounds or loop
+	static bool validate(const BvhNode* nodes, uint32_t nodeCount, const uint32_t* primitives, uint32_t primitiveCount, uint32_t primitiveLimit);
+	// Distance at which the ray enters the box, FLT_MAX if it misses it within maxDistance
+	static float intersectRay(const glm::vec3& boxMin, const glm::vec3& boxMax, const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance);
+
+	// Calls visit(primitive, inside) for primitives in nodes intersecting the frustum. Inside is true when the node is
+	// completely within the frustum so the primitive needs no further test. Planes a node is inside of aren't tested
+	// for its children
+	template <typename Visit>
+	void cull(const Frustum& frustum, Visit visit) const;
+	// Calls visit(primitive) for primitives in nodes overlapping the sphere
+	template <typename Visit>
+	void query(const glm::vec3& center, float radius, Visit visit) const;
+	// Visits leaves the ray enters within maxDistance, nearer child first. hit(primitive, maxDistance) returns distance of
+	// the primitive's own hit or a negative value on a miss, closer hits shorten the ray. Returns distance of the
+	// nearest hit or a negative value
+	template <typename Hit>
+	float raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Hit hit) const;
+
+	Bvh(const Bvh& bvh) = delete;
+	Bvh& operator=(const Bvh& bvh) = delete;
+private:
+	static const unsigned int BIN_COUNT = 12;
+	static const uint32_t MAX_LEAF_SIZE = 4;
+	// Deeper nodes are made leaves, so traversal stacks have a fixed size
+	static const unsigned int MAX_DEPTH = 48;
+	static const unsigned int STACK_SIZE = MAX_DEPTH + 2;
+	// Cost of visiting a node relative to testing one primitive
+	static constexpr float TRAVERSAL_COST = 1.0f;
+
+	std::vector<BvhNode> ownedNodes;
+	std::vector<uint32_t> ownedPrimitives;
+	const BvhNode* nodes = nullptr;
+	uint32_t nodeCount = 0;
+	const uint32_t* primitives = nullptr;
+	uint32_t primitiveCount = 0;
+
+	// Appends node over primitives [first, first + count) and its subtree, returns its index
+	uint32_t buildNode(const Bounds* bounds, const std::vector<glm::vec3>& centroids, uint32_t first, uint32_t count, unsigned int depth);
+	// Half of the box surface area, only ratios matter
+	static float getArea(const glm::vec3& min, const glm::vec3& max);
+};
+
+template <typename Visit>
+void Bvh::cull(const Frustum & frustum, Visit visit) const
+{
+	if (nodeCount == 0)
+	{
+		return;
+	}
+
+	struct Entry
+	{
+		uint32_t node;
+		unsigned int planeMask;
+	};
+	Entry stack[STACK_SIZE];
+	unsigned int stackSize = 0;
+	stack[stackSize++] = { 0, Frustum::ALL_PLANES };
+	while (stackSize > 0)
+	{
+		Entry entry = stack[--stackSize];
+		const BvhNode& node = nodes[entry.node];
+		if (entry.planeMask != 0 && !frustum.intersects(node.min, node.max, entry.planeMask))
+		{
+			continue;
+		}
+
+		if (node.count > 0)
+		{
+			for (uint32_t i = 0; i < node.count; ++i)
+			{
+				visit(primitives[node.offset + i], entry.planeMask == 0);
+			}
+			continue;
+		}
+		stack[stackSize++] = { node.offset, entry.planeMask };
+		stack[stackSize++] = { entry.node + 1, entry.planeMask };
+	}
+}
+
+template <typename Visit>
+void Bvh::query(const glm::vec3 & center, float radius, Visit visit) const
+{
+	if (nodeCount == 0)
+	{
+		return;
+	}
+
+	uint32_t stack[STACK_SIZE];
+	unsigned int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		uint32_t index = stack[--stackSize];
+		const BvhNode& node = nodes[index];
+		glm::vec3 offset = center - glm::clamp(center, node.min, node.max);
+		if (glm::dot(offset, offset) > radius * radius)
+		{
+			continue;
+		}
+
+		if (node.count > 0)
+		{
+			for (uint32_t i = 0; i < node.count; ++i)
+			{
+				visit(primitives[node.offset + i]);
+			}
+			continue;
+		}
+		stack[stackSize++] = node.offset;
+		stack[stackSize++] = index + 1;
+	}
+}
+
+template <typename Hit>
+float Bvh::raycast(const glm::vec3 & origin, const glm::vec3 & direction, float maxDistance, Hit hit) const
+{
+	float nearest = -1.0f;
+	if (nodeCount == 0)
+	{
+		return nearest;
+	}
+
+	// Division by zero components gives infinities, which the slab test handles
+	glm::vec3 inverseDirection = 1.0f / direction;
+	uint32_t stack[STACK_SIZE];
+	unsigned int stackSize = 0;
+	if (intersectRay(nodes[0].min, nodes[0].max, origin, inverseDirection, maxDistance) != FLT_MAX)
+	{
+		stack[stackSize++] = 0;
+	}
+	while (stackSize > 0)
+	{
+		const BvhNode& node = nodes[stack[--stackSize]];
+		if (node.count > 0)
+		{
+			for (uint32_t i = 0; i < node.count; ++i)
+			{
+				float distance = hit(primitives[node.offset + i], maxDistance);
+				if (distance >= 0.0f && distance < maxDistance)
+				{
+					maxDistance = distance;
+					nearest = distance;
+				}
+			}
+			continue;
+		}
+
+		uint32_t left = static_cast<uint32_t>(&node - nodes) + 1;
+		uint32_t right = node.offset;
+		float leftDistance = intersectRay(nodes[left].min, nodes[left].max, origin, inverseDirection, maxDistance);
+		float rightDistance = intersectRay(nodes[right].min, nodes[right].max, origin, inverseDirection, maxDistance);
+		// Nearer child is pushed last so it's visited first and shortens the ray for the other one
+		if (leftDistance > rightDistance)
+		{
+			std::swap(left, right);
+			std::swap(leftDistance, rightDistance);
+		}
+		if (rightDistance != FLT_MAX)
+		{
+			stack[stackSize++] = right;
+		}
+		if (leftDistance != FLT_MAX)
+		{
+			stack[stackSize++] = left;
+		}
+	}
+	return nearest;
+}
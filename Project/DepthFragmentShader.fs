@@ -0,0 +1,6 @@
+#version 330 core
+
+// Depth is written by the fixed function, color writes are disabled
+void main()
+{
+}
@@ -0,0 +1,43 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+// Position must match VertexShader.vs bit for bit, the shading pass tests depth for equality
+invariant gl_Position;
+
+layout (std140) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+
+uniform mat4 model;
+
+// Instanced draws read model matrices from the instance buffer, 8 texels per instance
+uniform bool instanced;
+uniform int firstInstance;
+uniform samplerBuffer instanceMatrices;
+
+uniform bool compactVertices;
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
+mat4 fetchMatrix(int texel)
+{
+    return mat4(texelFetch(instanceMatrices, texel), texelFetch(instanceMatrices, texel + 1),
+        texelFetch(instanceMatrices, texel + 2), texelFetch(instanceMatrices, texel + 3));
+}
+
+void main()
+{
+    vec3 position = compactVertices ? positionOffset + aPos * positionScale : aPos;
+
+    mat4 modelMatrix = model;
+    if (instanced)
+    {
+        modelMatrix = fetchMatrix((firstInstance + gl_InstanceID) * 8);
+    }
+
+    vec3 fragPos = vec3(modelMatrix * vec4(position, 1.0));
+    gl_Position = projection * view * vec4(fragPos, 1.0);
+}
@@ -1,24 +1,187 @@
 #include "FileUtil.h"
 #include <fstream>
+#include <cstring>
+#include <sstream>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 std::string FileUtil::loadFile(const char * path)
 {
-	std::string fileContent;
-	std::ifstream FileStream(path, std::ios::in);
+	std::ifstream fileStream(path, std::ios::in);
+	if (!fileStream.is_open())
+	{
+		printf("Impossible to open %s. Are you in the right directory?\n", path);
+		return std::string();
+	}
 
-	if (FileStream.is_open())
+	// One read of the whole stream instead of concatenating it line by line
+	std::ostringstream content;
+	content << fileStream.rdbuf();
+	return content.str();
+}
+
+bool FileUtil::loadBinaryFile(const std::string & path, std::string & content)
+{
+	std::ifstream fileStream(path, std::ios::in | std::ios::binary | std::ios::ate);
+	if (!fileStream.is_open())
 	{
-		std::string line = "";
-		while (getline(FileStream, line))
-		{
-			fileContent += "\n" + line;
-		}
-		FileStream.close();
+		return false;
 	}
-	else
+
+	std::streamsize size = fileStream.tellg();
+	fileStream.seekg(0, std::ios::beg);
+	content.resize(static_cast<size_t>(size));
+	fileStream.read(&content[0], size);
+	return fileStream.good() || fileStream.eof();
+}
+
+bool FileUtil::fileExists(const std::string & path)
+{
+	std::ifstream fileStream(path, std::ios::in | std::ios::binary);
+	return fileStream.is_open();
+}
+
+bool FileUtil::isUpToDate(const std::string & sourcePath, const std::string & builtPath)
+{
+	struct stat sourceStat;
+	struct stat builtStat;
+	if (stat(sourcePath.c_str(), &sourceStat) != 0 || stat(builtPath.c_str(), &builtStat) != 0)
 	{
-		printf("Impossible to open %s. Are you in the right directory?\n", path);
+		return false;
+	}
+	return builtStat.st_mtime >= sourceStat.st_mtime;
+}
+
+bool FileUtil::createDirectory(const std::string & path)
+{
+#ifdef _WIN32
+	return CreateDirectoryA(path.c_str(), nullptr) != 0 || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+	struct stat status;
+	return mkdir(path.c_str(), 0755) == 0 || (stat(path.c_str(), &status) == 0 && S_ISDIR(status.st_mode));
+#endif
+}
+
+uint64_t FileUtil::hash(const void * data, size_t size, uint64_t seed)
+{
+	// FNV-1a style mixing applied to whole 64-bit words, so hashing large model files stays cheap
+	const uint64_t prime = 1099511628211ull;
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	uint64_t result = seed ^ (size * prime);
+
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		uint64_t word;
+		memcpy(&word, bytes + i, sizeof(word));
+		result = (result ^ word) * prime;
+		result ^= result >> 32;
+	}
+	for (; i < size; ++i)
+	{
+		result = (result ^ bytes[i]) * prime;
+	}
+
+	return result;
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const std::string & path)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
 	}
 
-	return fileContent;
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	fileHandle = file;
+	mappingHandle = mapping;
+	data = static_cast<const unsigned char*>(view);
+	size = static_cast<size_t>(fileSize.QuadPart);
+#else
+	int file = ::open(path.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		return false;
+	}
+
+	struct stat fileStat;
+	if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		::close(file);
+		return false;
+	}
+
+	void* view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	// Mapping keeps its own reference to the file
+	::close(file);
+	if (view == MAP_FAILED)
+	{
+		return false;
+	}
+
+	data = static_cast<const unsigned char*>(view);
+	size = static_cast<size_t>(fileStat.st_size);
+#endif
+
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (data == nullptr)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+	CloseHandle(mappingHandle);
+	CloseHandle(fileHandle);
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+#else
+	munmap(const_cast<unsigned char*>(data), size);
+#endif
+
+	data = nullptr;
+	size = 0;
 }
@@ -1,9 +1,46 @@
 #pragma once
 
 #include <string>
+#include <cstdint>
 
 class FileUtil
 {
 public:
+	// Reads the whole text file, returns empty string if it can't be opened
 	static std::string loadFile(const char* path);
-};
\ No newline at end of file
+	// Reads the whole file as binary data, returns false if it can't be opened
+	static bool loadBinaryFile(const std::string& path, std::string& content);
+	// Checks if file at the given path exists
+	static bool fileExists(const std::string& path);
+	// Checks if file built from the source exists and was written after the source was last modified
+	static bool isUpToDate(const std::string& sourcePath, const std::string& builtPath);
+	// Creates directory if it doesn't exist yet, parent directories must exist. Returns false if it can't be created
+	static bool createDirectory(const std::string& path);
+	// Computes 64-bit hash of the data. Pass previous hash as seed to hash several buffers as one
+	static uint64_t hash(const void* data, size_t size, uint64_t seed = 14695981039346656037ull);
+};
+
+// Read-only memory mapping of a whole file. The mapped data stays valid until the file is closed
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+	// Maps file at path, returns false if it can't be opened or is empty
+	bool open(const std::string& path);
+	// Unmaps the file
+	void close();
+	bool isOpen() const { return data != nullptr; }
+	const unsigned char* getData() const { return data; }
+	size_t getSize() const { return size; }
+
+	MappedFile(const MappedFile& file) = delete;
+	MappedFile& operator=(const MappedFile& file) = delete;
+private:
+	const unsigned char* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#endif
+};
@@ -0,0 +1,168 @@
+#include "Frustum.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <xmmintrin.h>
+
+void BoundsArrays::clear()
+{
+	centerX.clear();
+	centerY.clear();
+	centerZ.clear();
+	extentX.clear();
+	extentY.clear();
+	extentZ.clear();
+	radius.clear();
+}
+
+void BoundsArrays::add(const glm::vec3 & center, const glm::vec3 & extents, float sphereRadius)
+{
+	centerX.push_back(center.x);
+	centerY.push_back(center.y);
+	centerZ.push_back(center.z);
+	extentX.push_back(extents.x);
+	extentY.push_back(extents.y);
+	extentZ.push_back(extents.z);
+	radius.push_back(sphereRadius);
+}
+
+void Frustum::update(const glm::mat4 & viewProjection)
+{
+	// Clip space planes are sums and differences of the matrix rows, glm matrices are indexed by column
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; ++i)
+	{
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	}
+	planes[0] = rows[3] + rows[0];   // Left
+	planes[1] = rows[3] - rows[0];   // Right
+	planes[2] = rows[3] + rows[1];   // Bottom
+	planes[3] = rows[3] - rows[1];   // Top
+	planes[4] = rows[3] + rows[2];   // Near
+	planes[5] = rows[3] - rows[2];   // Far
+	normalize();
+}
+
+Frustum Frustum::transformed(const glm::mat4 & model) const
+{
+	// Plane dot (model * point) equals (transpose(model) * plane) dot point
+	Frustum frustum;
+	glm::mat4 transposed = glm::transpose(model);
+	for (int i = 0; i < 6; ++i)
+	{
+		frustum.planes[i] = transposed * planes[i];
+	}
+	frustum.normalize();
+	return frustum;
+}
+
+bool Frustum::intersects(const glm::vec3 & center, const glm::vec3 & extents, float radius) const
+{
+	for (const auto& plane : planes)
+	{
+		glm::vec3 normal(plane);
+		float distance = glm::dot(normal, center) + plane.w;
+		float boxRadius = glm::dot(glm::abs(normal), extents);
+		if (distance + std::min(boxRadius, radius) < 0.0f)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Frustum::intersects(const glm::vec3 & boxMin, const glm::vec3 & boxMax, unsigned int & planeMask) const
+{
+	glm::vec3 center = (boxMin + boxMax) * 0.5f;
+	glm::vec3 extents = (boxMax - boxMin) * 0.5f;
+	for (int i = 0; i < 6; ++i)
+	{
+		unsigned int bit = 1u << i;
+		if ((planeMask & bit) == 0)
+		{
+			continue;
+		}
+
+		glm::vec3 normal(planes[i]);
+		float distance = glm::dot(normal, center) + planes[i].w;
+		float boxRadius = glm::dot(glm::abs(normal), extents);
+		if (distance + boxRadius < 0.0f)
+		{
+			return false;
+		}
+		if (distance - boxRadius >= 0.0f)
+		{
+			planeMask &= ~bit;
+		}
+	}
+	return true;
+}
+
+void Frustum::intersects(const BoundsArrays & bounds, std::vector<uint8_t>& visible) const
+{
+	size_t count = bounds.size();
+	visible.resize(count);
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	__m128 normalX[6], normalY[6], normalZ[6], offset[6], absX[6], absY[6], absZ[6];
+	for (int p = 0; p < 6; ++p)
+	{
+		normalX[p] = _mm_set1_ps(planes[p].x);
+		normalY[p] = _mm_set1_ps(planes[p].y);
+		normalZ[p] = _mm_set1_ps(planes[p].z);
+		offset[p] = _mm_set1_ps(planes[p].w);
+		absX[p] = _mm_andnot_ps(signMask, normalX[p]);
+		absY[p] = _mm_andnot_ps(signMask, normalY[p]);
+		absZ[p] = _mm_andnot_ps(signMask, normalZ[p]);
+	}
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 centerX = _mm_loadu_ps(&bounds.centerX[i]);
+		__m128 centerY = _mm_loadu_ps(&bounds.centerY[i]);
+		__m128 centerZ = _mm_loadu_ps(&bounds.centerZ[i]);
+		__m128 extentX = _mm_loadu_ps(&bounds.extentX[i]);
+		__m128 extentY = _mm_loadu_ps(&bounds.extentY[i]);
+		__m128 extentZ = _mm_loadu_ps(&bounds.extentZ[i]);
+		__m128 radius = _mm_loadu_ps(&bounds.radius[i]);
+
+		__m128 inside = _mm_cmpeq_ps(zero, zero);
+		for (int p = 0; p < 6; ++p)
+		{
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX[p], centerX), _mm_mul_ps(normalY[p], centerY)),
+				_mm_add_ps(_mm_mul_ps(normalZ[p], centerZ), offset[p]));
+			__m128 boxRadius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absX[p], extentX), _mm_mul_ps(absY[p], extentY)), _mm_mul_ps(absZ[p], extentZ));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, _mm_min_ps(boxRadius, radius)), zero));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		visible[i] = mask & 1;
+		visible[i + 1] = (mask >> 1) & 1;
+		visible[i + 2] = (mask >> 2) & 1;
+		visible[i + 3] = (mask >> 3) & 1;
+	}
+
+	// Remaining objects that don't fill a whole register
+	for (; i < count; ++i)
+	{
+		glm::vec3 center(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]);
+		glm::vec3 extents(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i]);
+		visible[i] = intersects(center, extents, bounds.radius[i]) ? 1 : 0;
+	}
+}
+
+void Frustum::normalize()
+{
+	// Normalized planes give distances in world units, which the radii are compared to
+	for (auto& plane : planes)
+	{
+		float length = glm::length(glm::vec3(plane));
+		if (length > 0.0f)
+		{
+			plane /= length;
+		}
+	}
+}
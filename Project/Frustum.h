@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// World space bounds of many objects stored as separate arrays per component, so four of them are tested at once with SSE.
+// Every object has a box given by center and half extents and a sphere around the same center
+struct BoundsArrays
+{
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+	std::vector<float> radius;
+
+	void clear();
+	void add(const glm::vec3& center, const glm::vec3& extents, float sphereRadius);
+	size_t size() const { return radius.size(); }
+};
+
+// View frustum as six planes with normals pointing inside
+class Frustum
+{
+public:
+	// Plane mask with all six planes to test
+	static const unsigned int ALL_PLANES = 0x3F;
+
+	// Extracts planes from the combined projection and view matrix
+	void update(const glm::mat4& viewProjection);
+	// Returns the frustum in the model space of the transform, so model space bounds can be tested without transforming them
+	Frustum transformed(const glm::mat4& model) const;
+	// Returns false when the object lies completely outside of any plane. An object is kept only if both its box and its sphere
+	// reach inside every plane, both are conservative so the tighter of the two decides
+	bool intersects(const glm::vec3& center, const glm::vec3& extents, float radius) const;
+	// Same test for every object of the arrays, four per iteration. visible[i] is set to 1 for objects intersecting the frustum
+	void intersects(const BoundsArrays& bounds, std::vector<uint8_t>& visible) const;
+	// Tests the box against planes set in the mask and clears the bits of planes the box is completely inside of, so
+	// boxes nested in it can skip them. Mask of 0 means the box is inside the frustum
+	bool intersects(const glm::vec3& boxMin, const glm::vec3& boxMax, unsigned int& planeMask) const;
+private:
+	glm::vec4 planes[6];
+
+	// Scales planes to unit normals, so plane distances are in world units
+	void normalize();
+};
@@ -1,6 +1,8 @@
 #include "GameScene.h"
 
 #include <algorithm>
+#include <cstring>
+#include <fstream>
 #include <time.h>
 #include <iostream>
 
@@ -15,11 +17,13 @@
 #include "Camera.h"
 #include "HiddenObject.h"
 #include "Model3D.h"
-#include "Model2D.h"
+#include "SpriteBatch.h"
+#include "HitchDetector.h"
+#include "ThreadPool.h"
 
 using namespace tinyxml2;
 
-GameScene::GameScene() : camera(vec3(1.f, 1.f, 3.f)), firstMouse(true)
+GameScene::GameScene() : litShaders("VertexShader.vs", "BlendFragmentShader.fs"), camera(vec3(1.f, 1.f, 3.f)), firstMouse(true)
 {
 }
 
@@ -27,6 +31,7 @@ GameScene::~GameScene()
 {
 	delete skybox;
 	delete textModel;
+	delete hudSprites;
 
 	for (auto object : models)
 	{
@@ -47,11 +52,6 @@ GameScene::~GameScene()
 	{
 		delete object;
 	}
-
-	for (auto object : hiddenObjectIcons)
-	{
-		delete object;
-	}
 }
 
 void GameScene::initialize(Window* _window)
@@ -60,6 +60,61 @@ void GameScene::initialize(Window* _window)
 
 	loadShaders();
 	loadScene();
+	// Variants of materials with and without specular maps start compiling before the first frame, lights are known by
+	// now. They link while textures of the scene upload. Variants of other features, e.g. alpha tested materials, are
+	// issued by the models as their materials are created
+	litShaders.get(0);
+	litShaders.get(ShaderVariants::HAS_SPECULAR_MAP);
+	for (const auto model : models)
+	{
+		model->setShaderVariants(&litShaders);
+	}
+	for (const auto model : blendModels)
+	{
+		model->setShaderVariants(&litShaders);
+	}
+	for (const auto object : hiddenObjects)
+	{
+		object->setShaderVariants(&litShaders);
+	}
+
+	// Icons of all hidden objects come from one atlas, so found ones are drawn together
+	std::vector<std::string> iconPaths;
+	for (const auto object : hiddenObjects)
+	{
+		iconPaths.push_back(object->getIconFileName());
+	}
+	hudAtlas.load(SpriteAtlas::HUD_ATLAS_PATH, iconPaths);
+	hudSprites = new SpriteBatch(hudAtlas);
+	// Every icon gets a hidden quad now, slot of an icon is the index of its object. Finding an object only moves
+	// and shows the quad, so nothing is created in the middle of gameplay
+	for (const auto& iconPath : iconPaths)
+	{
+		hudSprites->addSprite(iconPath, 0, 10, 40, 40, false);
+	}
+
+	// Hidden objects are placed at shuffled spawn points
+	for (size_t i = 0; i < hiddenObjects.size() && i < spawnPoints.size(); ++i)
+	{
+		hiddenObjects[i]->setPosition(spawnPoints[i]);
+	}
+	for (const auto model : models)
+	{
+		sceneHierarchy.addModel(model, RenderPass::Opaque);
+	}
+	for (const auto model : blendModels)
+	{
+		sceneHierarchy.addModel(model, RenderPass::Transparent);
+	}
+	for (const auto object : hiddenObjects)
+	{
+		sceneHierarchy.addObject(object);
+	}
+	renderQueue.setOcclusionCuller(&occlusionCuller);
+
+	lightsBlockOffset = UniformBuffer::alignSize(sizeof(CameraBlock));
+	frameUniformData.resize(lightsBlockOffset + sizeof(LightsBlock));
+	frameUniforms.create(frameUniformData.size());
 	loadPlayerData();
 
 	aspectRatio = window->getScreenWidth() / window->getScreenHeight();
@@ -69,10 +124,9 @@ void GameScene::initialize(Window* _window)
 
 void GameScene::loadShaders()
 {
-	shader.compile("VertexShader.vs", "BlendFragmentShader.fs");
-	discardShader.compile("VertexShader.vs", "DiscardFragmentShader.fs");
 	skyboxShader.compile("SkyboxVertexShader.vs", "SkyboxFragmentShader.fs");
 	textShader.compile("TextVertexShader.vs", "TextFragmentShader.fs");
+	depthShader.compile("DepthVertexShader.vs", "DepthFragmentShader.fs");
 }
 
 void GameScene::loadScene()
@@ -89,6 +143,20 @@ void GameScene::loadScene()
 	XMLElement* gameElement = document.FirstChildElement("Game");
 	if (gameElement == nullptr) throw std::exception("Game element is missing");
 
+	// Load level of detail settings, they apply to models loaded after them
+	XMLElement* levelsOfDetailElement = gameElement->FirstChildElement("LevelsOfDetail");
+	if (levelsOfDetailElement != nullptr)
+	{
+		loadLevelsOfDetail(levelsOfDetailElement);
+	}
+
+	// Load static batching settings, they apply to models loaded after them
+	XMLElement* staticBatchingElement = gameElement->FirstChildElement("StaticBatching");
+	if (staticBatchingElement != nullptr)
+	{
+		loadStaticBatching(staticBatchingElement);
+	}
+
 	// Load static models of a scene (decorations)
 	XMLElement* staticModelsElement = gameElement->FirstChildElement("StaticModels");
 	if (staticModelsElement != nullptr)
@@ -132,6 +200,48 @@ void GameScene::loadScene()
 	}
 }
 
+void GameScene::loadLevelsOfDetail(XMLElement * element)
+{
+	MeshOptimizer::LodSettings settings;
+	settings.levelCount = 0;
+	XMLElement* levelElement = element->FirstChildElement("Level");
+	while (levelElement != nullptr && settings.levelCount < Mesh::MAX_LODS - 1)
+	{
+		float triangleRatio = 0.5f, maxError = 0.01f;
+		levelElement->FirstChildElement("TriangleRatio")->QueryFloatText(&triangleRatio);
+		levelElement->FirstChildElement("MaxError")->QueryFloatText(&maxError);
+		settings.triangleRatios[settings.levelCount] = triangleRatio;
+		settings.maxErrors[settings.levelCount] = maxError;
+		++settings.levelCount;
+		levelElement = levelElement->NextSiblingElement("Level");
+	}
+	Model3D::setLodSettings(settings);
+
+	float pixelError = 1.0f;
+	XMLElement* pixelErrorElement = element->FirstChildElement("PixelError");
+	if (pixelErrorElement != nullptr)
+	{
+		pixelErrorElement->QueryFloatText(&pixelError);
+	}
+	renderQueue.setLodPixelError(pixelError);
+}
+
+void GameScene::loadStaticBatching(XMLElement * element)
+{
+	Model3D::BatchSettings settings;
+	XMLElement* cellSizeElement = element->FirstChildElement("CellSize");
+	if (cellSizeElement != nullptr)
+	{
+		cellSizeElement->QueryFloatText(&settings.cellSize);
+	}
+	XMLElement* maxVerticesElement = element->FirstChildElement("MaxVertices");
+	if (maxVerticesElement != nullptr)
+	{
+		maxVerticesElement->QueryUnsignedText(&settings.maxVertices);
+	}
+	Model3D::setBatchSettings(settings);
+}
+
 void GameScene::loadModels(XMLElement* element)
 {
 	// Load city (opaque objects only)
@@ -144,7 +254,7 @@ void GameScene::loadModels(XMLElement* element)
 			auto filePath = modelElement->GetText();
 			if (filePath != nullptr)
 			{
-				models.push_back(new Model3D(filePath));
+				models.push_back(new Model3D(filePath, true, getVertexFormat(modelElement), isAlphaTested(modelElement)));
 			}
 			modelElement = modelElement->NextSiblingElement("Model");
 		}	
@@ -160,7 +270,7 @@ void GameScene::loadModels(XMLElement* element)
 			auto filePath = modelElement->GetText();
 			if (filePath != nullptr)
 			{
-				blendModels.push_back(new Model3D(filePath));
+				blendModels.push_back(new Model3D(filePath, true, getVertexFormat(modelElement), isAlphaTested(modelElement)));
 			}
 			modelElement = modelElement->NextSiblingElement("Model");
 		}
@@ -177,8 +287,23 @@ void GameScene::loadModels(XMLElement* element)
 			faces.push_back(faceElement->GetText());
 			faceElement = faceElement->NextSiblingElement("Face");
 		}
-		skybox = new SkyBoxModel(faces);
+		skybox = new SkyBoxModel(faces, true);
+	}
+}
+
+VertexFormat GameScene::getVertexFormat(XMLElement * modelElement)
+{
+	const char* format = modelElement->Attribute("vertexFormat");
+	if (format != nullptr && strcmp(format, "compact") == 0)
+	{
+		return VertexFormat::Compact;
 	}
+	return VertexFormat::Standard;
+}
+
+bool GameScene::isAlphaTested(XMLElement * modelElement)
+{
+	return modelElement->BoolAttribute("alphaTest");
 }
 
 void GameScene::loadGameObjects(XMLElement * element)
@@ -200,7 +325,7 @@ void GameScene::loadGameObjects(XMLElement * element)
 			iconFileName = iconElement->GetText();
 		}
 
-		hiddenObjects.push_back(new HiddenObject(modelName, iconFileName));
+		hiddenObjects.push_back(new HiddenObject(modelName, iconFileName, true));
 		hiddenObjectElement = hiddenObjectElement->NextSiblingElement("HiddenObject");
 	}
 }
@@ -234,19 +359,46 @@ void GameScene::loadLightSources(XMLElement * element)
 		directionalLight.load(dirLightElement);
 	}
 
-	// Load spot light
+	// Load spot lights
 	XMLElement* spotLightElement = element->FirstChildElement("SpotLight");
-	if (spotLightElement != nullptr)
+	while (spotLightElement != nullptr)
 	{
-		spotLight.load(spotLightElement);
+		if (spotLightElement->FirstChildElement("Position") == nullptr)
+		{
+			flashlight.load(spotLightElement);
+			hasFlashlight = true;
+		}
+		else
+		{
+			SpotLight spotLight;
+			spotLight.load(spotLightElement);
+			spotLights.push_back(spotLight);
+		}
+		spotLightElement = spotLightElement->NextSiblingElement("SpotLight");
 	}
 
-	// Load point light
+	// Load point lights
 	XMLElement* pointLightElement = element->FirstChildElement("PointLight");
-	if (pointLightElement != nullptr)
+	while (pointLightElement != nullptr)
 	{
+		PointLight pointLight;
 		pointLight.load(pointLightElement);
+		pointLights.push_back(pointLight);
+		pointLightElement = pointLightElement->NextSiblingElement("PointLight");
 	}
+	lightClusters.setLights(pointLights, spotLights);
+
+	// Lit shaders leave out light sources the scene doesn't have
+	uint32_t sceneFeatures = 0;
+	if (!hasFlashlight)
+	{
+		sceneFeatures |= ShaderVariants::NO_SPOTLIGHT;
+	}
+	if (pointLights.empty() && spotLights.empty())
+	{
+		sceneFeatures |= ShaderVariants::NO_CLUSTERED_LIGHTS;
+	}
+	litShaders.setSceneFeatures(sceneFeatures);
 }
 
 void GameScene::updateCamera(float deltaTime)
@@ -283,9 +435,9 @@ void GameScene::printElapsedTime()
 {
 	// Create string of the form hh:mm:ss from the elapsed time
 	std::string timerText = PlayerData::formatTime(totalTimeElapsed);
-	// Set text to render to TextModel object
+	// Set text to render to TextModel object, it's laid out again only when a second passes
 	float letterSize = 20.0f;
-	textModel->setTextToRender(timerText, 10, window->getScreenHeight() - letterSize, letterSize);
+	textModel->setText(TIMER_TEXT, timerText, 10, window->getScreenHeight() - letterSize, letterSize);
 }
 
 void GameScene::loadPlayerData()
@@ -339,7 +491,21 @@ void GameScene::savePlayerData()
 		iter.second.save(playerElement);
 	}
 
-	document.SaveFile(recordFileName.c_str());
+	// Document is only printed here, the file is written on a worker so finishing the game doesn't stall the frame
+	XMLPrinter printer;
+	document.Print(&printer);
+	std::string content = printer.CStr();
+	std::string path = recordFileName;
+	ThreadPool::shared().submit([path, content]()
+	{
+		std::ofstream stream(path, std::ios::out | std::ios::trunc);
+		if (!stream.is_open())
+		{
+			std::cout << "Unable to save " << path << std::endl;
+			return;
+		}
+		stream << content;
+	});
 }
 
 void GameScene::renderPlayerList()
@@ -347,15 +513,30 @@ void GameScene::renderPlayerList()
 	float letterSize = 20.0f;
 	float x = window->getScreenWidth() / 2 - 10 * letterSize;
 	int index = 3;
+	size_t slot = PLAYER_LIST_TEXT;
 	for (auto& player : players)
 	{
 		std::string playerStr = player.second.getPlayerName() + "  " + player.second.getFormattedGameTime();
-		textModel->setTextToRender(playerStr, x, window->getScreenHeight() - letterSize * index, letterSize);
-		textModel->render(textShader);
+		textModel->setText(slot++, playerStr, x, window->getScreenHeight() - letterSize * index, letterSize);
 		++index;
 	}
 }
 
+void GameScene::renderFrameStats()
+{
+	float letterSize = 20.0f;
+	std::string statsStr = "Draws " + std::to_string(renderQueue.getDrawCalls()) + "  Instanced " + std::to_string(renderQueue.getInstancedItems()) + "  Triangles " + std::to_string(renderQueue.getDrawnTriangles())
+		+ "  Culled " + std::to_string(renderQueue.getCulledItems()) + "/"
+		+ std::to_string(renderQueue.getSubmittedItems()) + "  Skipped state " + std::to_string(renderQueue.getSkippedStateChanges())
+		+ "  Depth pre-pass " + (renderQueue.hasDepthPrePass() ? std::to_string(renderQueue.getDepthDrawCalls()) + " draws" : std::string("off"));
+	textModel->setText(STATS_TEXT, statsStr, 10, window->getScreenHeight() - letterSize * 2, letterSize);
+	std::string occlusionStr = "Occluders " + std::to_string(occlusionCuller.getOccluderCount()) + " (" + std::to_string(occlusionCuller.getOccluderTriangles())
+		+ " tris)  Occluded " + std::to_string(occlusionCuller.getCulledItems()) + "/" + std::to_string(occlusionCuller.getTestedItems())
+		+ "  Lights " + std::to_string(lightClusters.getVisibleLights()) + "/" + std::to_string(lightClusters.getLightCount()) + " (max "
+		+ std::to_string(lightClusters.getMaxClusterLights()) + " per cluster)";
+	textModel->setText(OCCLUSION_TEXT, occlusionStr, 10, window->getScreenHeight() - letterSize * 3, letterSize);
+}
+
 void GameScene::render(float deltaTime)
 {
 	if (!initialized)
@@ -372,65 +553,42 @@ void GameScene::render(float deltaTime)
 	glDisable(GL_BLEND);
 
 	// Calculate MVP matrices
-	glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), aspectRatio, 0.1f, 100.0f);
+	const float nearPlane = 0.1f;
+	const float farPlane = 100.0f;
+	glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), aspectRatio, nearPlane, farPlane);
 	glm::mat4 view = camera.GetViewMatrix();
-	glm::mat4 model;
-	glm::mat4 inverseModel = glm::transpose(glm::inverse(model));
-	// Use shader program
-	shader.bind();
-	// Set MVP matrices in shader
-	shader.bindUniform("projection", projection);
-	shader.bindUniform("view", view);
-	shader.bindUniform("model", model);
-	shader.bindUniform("inverseModel", inverseModel);
-	shader.bindUniform("viewPos", camera.Position);
-	// Set directional light properties in shader
-	shader.bindUniform("dirLight.direction", directionalLight.direction);
-	shader.bindUniform("dirLight.ambient", directionalLight.ambient);
-	shader.bindUniform("dirLight.diffuse", directionalLight.diffuse);
-	shader.bindUniform("dirLight.specular", directionalLight.specular);
-	// Set spot light properties in shader
-	shader.bindUniform("spotLight.position", camera.Position);
-	shader.bindUniform("spotLight.direction", camera.Front);
-	shader.bindUniform("spotLight.cutOff", spotLight.cutOff);
-	shader.bindUniform("spotLight.outerCutOff", spotLight.outerCutOff);
-	shader.bindUniform("spotLight.ambient", spotLight.ambient);
-	shader.bindUniform("spotLight.diffuse", spotLight.diffuse);
-	shader.bindUniform("spotLight.specular", spotLight.specular);
-	shader.bindUniform("spotLight.constant", spotLight.constant);
-	shader.bindUniform("spotLight.linear", spotLight.linear);
-	shader.bindUniform("spotLight.quadratic", spotLight.quadratic);
-	// Set point light properties in shader
-	shader.bindUniform("pointLight.position", pointLight.position);
-	shader.bindUniform("pointLight.ambient", pointLight.ambient);
-	shader.bindUniform("pointLight.diffuse", pointLight.diffuse);
-	shader.bindUniform("pointLight.specular", pointLight.specular);
-	shader.bindUniform("pointLight.constant", pointLight.constant);
-	shader.bindUniform("pointLight.linear", pointLight.linear);
-	shader.bindUniform("pointLight.quadratic", pointLight.quadratic);
-
-	// Draw opaque models
-	for (const auto model : models)
-	{
-		model->render(shader);
-	}
-
-	// Draw hidden objects
-	for (int i = 0; i < hiddenObjects.size(); ++i)
-	{
-		glm::mat4 model2;
-		model2 = glm::translate(model2, spawnPoints[i]);
-		shader.bindUniform("model", model2);
-		hiddenObjects[i]->render(shader);
-
-		// If camera is close enough to hidden object, it is considered found
-		if (!hiddenObjects[i]->isFound() && glm::length(camera.Position - spawnPoints[i]) < 1.5f)
+	// Camera and lights are shared by all lit shaders of the frame, the queue binds light buffers to every shader it draws with
+	lightClusters.assign(view, projection, nearPlane, farPlane);
+	lightClusters.upload();
+	renderQueue.setFrameTexture("lightData", GL_TEXTURE_BUFFER, lightClusters.getLightTexture());
+	renderQueue.setFrameTexture("lightClusters", GL_TEXTURE_BUFFER, lightClusters.getClusterTexture());
+	renderQueue.setFrameTexture("lightIndices", GL_TEXTURE_BUFFER, lightClusters.getIndexTexture());
+	updateFrameUniforms(projection, view);
+
+	// Collect draws of the whole frame. The hierarchy skips models and meshes outside of the view, the queue drops draws
+	// hidden behind the rasterized occluders and orders the rest to minimize state changes. Transparent models are drawn
+	// last (after skybox as well) for blending to work properly
+	sceneHierarchy.update();
+	// Projection scale is half of the screen height over the tangent of half of the field of view
+	renderQueue.begin(projection * view, camera.Position, farPlane, window->getScreenHeight() * 0.5f * projection[1][1]);
+	occlusionCuller.begin(projection * view, camera.Position);
+	sceneHierarchy.addOccluders(occlusionCuller, renderQueue.getFrustum());
+	occlusionCuller.rasterize();
+	sceneHierarchy.submit(renderQueue, litShaders);
+
+	// If camera is close enough to hidden object, it is considered found
+	nearbyObjects.clear();
+	sceneHierarchy.findObjects(camera.Position, DISCOVERY_DISTANCE, nearbyObjects);
+	for (const auto object : nearbyObjects)
+	{
+		if (!object->isFound() && glm::length(camera.Position - object->getPosition()) < DISCOVERY_DISTANCE)
 		{
-			hiddenObjects[i]->setFound(true);
-			// Find next x coordinate to place new icon on screen
-			int x = 40 * hiddenObjectIcons.size();
-			// Create icon model
-			hiddenObjectIcons.push_back(new Model2D(hiddenObjects[i]->getIconFileName(), x, 10, 40));
+			object->setFound(true);
+			HitchDetector::shared().addEvent("found " + object->getIconFileName());
+			// Icons are placed next to each other in the order objects are found
+			size_t iconSlot = std::find(hiddenObjects.begin(), hiddenObjects.end(), object) - hiddenObjects.begin();
+			hudSprites->setPosition(iconSlot, 40.0f * objectsFound, 10);
+			hudSprites->setVisible(iconSlot, true);
 			++objectsFound;
 			// Game is completed when all objects are found, save new player time
 			if (objectsFound == 5)
@@ -438,78 +596,85 @@ void GameScene::render(float deltaTime)
 				PlayerData player(window->getPlayerName(), totalTimeElapsed);
 				addPlayerData(player);
 				savePlayerData();
+				HitchDetector::shared().addEvent("player data saved");
 			}
 		}
 	}
 
+	renderQueue.sort();
+
+	// Draw opaque models and hidden objects, with the pre-pass they are shaded only where they are the nearest surface
+	renderQueue.setDepthPrePass(depthPrePass ? &depthShader : nullptr);
+	renderQueue.flush(RenderPass::Opaque);
+
 	// Draw skybox
 	skyboxShader.bind();
-	skyboxShader.bindUniform("projection", projection);
+	const SceneBindings& skyboxBindings = skyboxShader.getBindings<SceneBindings>();
+	skyboxShader.bindUniform(skyboxBindings.projection, projection);
 	glm::mat4 skyboxView = glm::mat4(glm::mat3(view));  // Remove translation from skybox
-	skyboxShader.bindUniform("view", skyboxView);
+	skyboxShader.bindUniform(skyboxBindings.view, skyboxView);
 	skybox->render(skyboxShader);
 
-	// Enable blending and set blending function
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-	// Transparent models must be rendered last (after skybox as well) for blending to work properly
-	shader.bind();
-	// Set MVP matrices in shader
-	shader.bindUniform("projection", projection);
-	shader.bindUniform("view", view);
-	shader.bindUniform("model", model);
-	shader.bindUniform("inverseModel", inverseModel);
-	shader.bindUniform("viewPos", camera.Position);
-	// Set directional light properties in shader
-	shader.bindUniform("dirLight.direction", directionalLight.direction);
-	shader.bindUniform("dirLight.ambient", directionalLight.ambient);
-	shader.bindUniform("dirLight.diffuse", directionalLight.diffuse);
-	shader.bindUniform("dirLight.specular", directionalLight.specular);
-	// Set spot light properties in shader
-	shader.bindUniform("spotLight.position", camera.Position);
-	shader.bindUniform("spotLight.direction", camera.Front);
-	shader.bindUniform("spotLight.cutOff", spotLight.cutOff);
-	shader.bindUniform("spotLight.outerCutOff", spotLight.outerCutOff);
-	shader.bindUniform("spotLight.ambient", spotLight.ambient);
-	shader.bindUniform("spotLight.diffuse", spotLight.diffuse);
-	shader.bindUniform("spotLight.specular", spotLight.specular);
-	shader.bindUniform("spotLight.constant", spotLight.constant);
-	shader.bindUniform("spotLight.linear", spotLight.linear);
-	shader.bindUniform("spotLight.quadratic", spotLight.quadratic);
-	// Set point light properties in shader
-	shader.bindUniform("pointLight.position", pointLight.position);
-	shader.bindUniform("pointLight.ambient", pointLight.ambient);
-	shader.bindUniform("pointLight.diffuse", pointLight.diffuse);
-	shader.bindUniform("pointLight.specular", pointLight.specular);
-	shader.bindUniform("pointLight.constant", pointLight.constant);
-	shader.bindUniform("pointLight.linear", pointLight.linear);
-	shader.bindUniform("pointLight.quadratic", pointLight.quadratic);
-
-	// Draw transparent models (must be last in order to blend with skybox properly)
-	for (const auto model : blendModels)
-	{
-		model->render(shader);
-	}
+	// Draw transparent models with blending enabled (must be last in order to blend with skybox properly)
+	renderQueue.flush(RenderPass::Transparent);
 
 	// Disable depth test here so text and icons are always rendered on top of everything
 	glDisable(GL_DEPTH_TEST);
 
-	// Render Text
 	textShader.bind();
-	textShader.bindUniform("halfScreenSize", vec2(window->getScreenWidth() / 2, window->getScreenHeight() / 2));
-	textModel->render(textShader);
+	textShader.bindUniform(textShader.getBindings<SceneBindings>().halfScreenSize, vec2(window->getScreenWidth() / 2, window->getScreenHeight() / 2));
 
 	// Render found objects' icons
-	for (const auto& icon : hiddenObjectIcons)
-	{
-		icon->render(textShader);
-	}
+	hudSprites->render(textShader);
 
+	// Update strings of the overlays, all text is then rendered in one draw
 	if (printPlayers)
 	{
 		renderPlayerList();
 	}
+	else
+	{
+		textModel->clearTextFrom(PLAYER_LIST_TEXT);
+	}
+
+	if (printFrameStats)
+	{
+		renderFrameStats();
+	}
+	else
+	{
+		textModel->clearText(STATS_TEXT);
+		textModel->clearText(OCCLUSION_TEXT);
+	}
+	textModel->render(textShader);
+}
+
+void GameScene::updateFrameUniforms(const glm::mat4 & projection, const glm::mat4 & view)
+{
+	CameraBlock cameraBlock = {};
+	cameraBlock.projection = projection;
+	cameraBlock.view = view;
+	cameraBlock.viewPos = camera.Position;
+
+	// Spot light works as a flashlight attached to the camera
+	LightsBlock lightsBlock;
+	lightsBlock.dirLight = directionalLight.getBlock();
+	lightsBlock.spotLight = flashlight.getBlock();
+	lightsBlock.spotLight.position = camera.Position;
+	lightsBlock.spotLight.direction = camera.Front;
+	lightsBlock.clusters = lightClusters.getBlock(window->getScreenWidth(), window->getScreenHeight());
+
+	memcpy(frameUniformData.data(), &cameraBlock, sizeof(cameraBlock));
+	memcpy(frameUniformData.data() + lightsBlockOffset, &lightsBlock, sizeof(lightsBlock));
+	frameUniforms.update(frameUniformData.data(), frameUniformData.size());
+	frameUniforms.bindRange(UniformBuffer::CAMERA_BLOCK, 0, sizeof(CameraBlock));
+	frameUniforms.bindRange(UniformBuffer::LIGHTS_BLOCK, lightsBlockOffset, sizeof(LightsBlock));
+}
+
+GameScene::SceneBindings::SceneBindings(const Shader & shader)
+	: projection(shader.getUniform<glm::mat4>("projection")), view(shader.getUniform<glm::mat4>("view")),
+	halfScreenSize(shader.getUniform<glm::vec2>("halfScreenSize"))
+{
 }
 
 bool GameScene::processKeyEvent(int key, int action)
@@ -555,6 +720,23 @@ bool GameScene::processKeyEvent(int key, int action)
 		{
 			printPlayers = !printPlayers;
 		}
+		else if (key == GLFW_KEY_F)
+		{
+			printFrameStats = !printFrameStats;
+		}
+		else if (key == GLFW_KEY_Z)
+		{
+			depthPrePass = !depthPrePass;
+		}
+		// Save occlusion depth buffer of the last frame
+		else if (key == GLFW_KEY_O)
+		{
+			const std::string depthFileName = "occlusion_depth.pgm";
+			if (occlusionCuller.saveDepthBuffer(depthFileName))
+			{
+				std::cout << "Occlusion depth buffer saved to " << depthFileName << std::endl;
+			}
+		}
 	}
 
 	return false;
@@ -5,14 +5,23 @@
 #include "Scene.h"
 #include "Camera.h"
 #include "Light.h"
+#include "LightClusters.h"
 #include "Shader.h"
+#include "ShaderVariants.h"
 #include "PlayerData.h"
+#include "Mesh.h"
+#include "OcclusionCuller.h"
+#include "RenderQueue.h"
+#include "SceneHierarchy.h"
+#include "SpriteAtlas.h"
+#include "UniformBuffer.h"
 
 class Model;
+class Model3D;
 class SkyBoxModel;
 class TextModel;
 class HiddenObject;
-class Model2D;
+class SpriteBatch;
 
 // A scene class that loads, stores and renders all game models and light sources and contains game logic
 class GameScene : public Scene
@@ -22,6 +31,7 @@ public:
 	~GameScene();
 	// Compiles shaders and loads scene elements
 	// Compiling shaders in constructor throws exception so scene must be initialized after its construction
+	// Models and textures are streamed by AssetLoader, so the scene starts rendering before they are all resident
 	void initialize(Window* _window) override;
 	// Renders the scene
 	void render(float deltaTime) override;
@@ -42,24 +52,78 @@ private:
 		DOWN
 	};
 
-	Shader shader, discardShader, skyboxShader, textShader;
+	// Slots of the HUD strings in the text batch, every player of the list gets a slot from PLAYER_LIST_TEXT on
+	enum TextSlot : size_t {
+		TIMER_TEXT,
+		STATS_TEXT,
+		OCCLUSION_TEXT,
+		PLAYER_LIST_TEXT
+	};
+
+	// Hidden object is found when the camera gets closer to it than this
+	static constexpr float DISCOVERY_DISTANCE = 1.5f;
+
+	// Camera and screen uniforms of the shaders that don't use the frame uniform blocks, resolved once per program. Handles of uniforms
+	// a program doesn't declare stay inactive
+	struct SceneBindings
+	{
+		Uniform<glm::mat4> projection;
+		Uniform<glm::mat4> view;
+		Uniform<glm::vec2> halfScreenSize;
+
+		explicit SceneBindings(const Shader& shader);
+	};
+
+	// Mirror of the std140 "Camera" uniform block
+	struct CameraBlock
+	{
+		glm::mat4 projection;
+		glm::mat4 view;
+		glm::vec3 viewPos;
+		float padding;
+	};
+
+	// Variants of the lit shader selected by materials, specialized for the light sources of the scene
+	ShaderVariants litShaders;
+	Shader skyboxShader, textShader;
+	// Writes only depth of the opaque models before they are shaded, toggled at runtime
+	Shader depthShader;
+	bool depthPrePass = false;
 	Camera camera;
 	CameraMovementState cameraState;
 	DirectionalLight directionalLight;
-	SpotLight spotLight;
-	PointLight pointLight;
-	std::vector<Model*> models;
+	SpotLight flashlight;
+	bool hasFlashlight = false;
+	// Lights placed in the scene, culled per cluster of the view every frame
+	std::vector<PointLight> pointLights;
+	std::vector<SpotLight> spotLights;
+	LightClusters lightClusters;
+	// Camera and lights blocks of the frame, the lights block starts at an aligned offset after the camera block
+	UniformBuffer frameUniforms;
+	size_t lightsBlockOffset;
+	std::vector<unsigned char> frameUniformData;
+	std::vector<Model3D*> models;
 	std::vector<Model*> discardModels;
-	std::vector<Model*> blendModels;
+	std::vector<Model3D*> blendModels;
+	// Draws of opaque and transparent models collected every frame
+	RenderQueue renderQueue;
+	// Spatial index over models and hidden objects, used for culling and finding objects near the camera
+	SceneHierarchy sceneHierarchy;
+	std::vector<HiddenObject*> nearbyObjects;
+	// Depth buffer of the largest buildings, hides draws behind them before they reach the queue's sort
+	OcclusionCuller occlusionCuller;
 	SkyBoxModel* skybox = nullptr;
 	TextModel* textModel = nullptr;
 	std::vector<HiddenObject*> hiddenObjects;
 	int objectsFound;
 	std::vector<glm::vec3> spawnPoints;
-	std::vector<Model2D*> hiddenObjectIcons;
+	// Icon of every hidden object at the slot of its index, shown once it's found and drawn in one call from the HUD atlas
+	SpriteAtlas hudAtlas;
+	SpriteBatch* hudSprites = nullptr;
 	std::map<std::string, PlayerData> players;
 	std::string recordFileName;
 	bool printPlayers;
+	bool printFrameStats = false;
 
 	bool initialized;
 	float totalTimeElapsed;
@@ -76,23 +140,36 @@ private:
 	void loadShaders();
 	// Load scene file
 	void loadScene();
+	// Loads level of detail generation settings and the pixel error of their selection
+	void loadLevelsOfDetail(XMLElement* element);
+	// Loads cell size and vertex limit of static batches, a zero cell size disables batching
+	void loadStaticBatching(XMLElement* element);
 	// Loads all models
 	void loadModels(XMLElement* element);
+	// Reads vertexFormat attribute of a model element, "compact" selects quantized vertices
+	static VertexFormat getVertexFormat(XMLElement* modelElement);
+	// Reads alphaTest attribute of a model element, true for models with cutout textures
+	static bool isAlphaTested(XMLElement* modelElement);
 	// Load hidden game objects
 	void loadGameObjects(XMLElement* element);
 	// Load spawn points for hidden objects
 	void loadSpawnPoints(XMLElement* element);
-	// Loads light sources
+	// Loads the directional light and any number of point and spot lights. The spot light without a position is the
+	// flashlight attached to the camera
 	void loadLightSources(XMLElement* element);
 	// Update camera based on elapsed time from last frame and current state
 	void updateCamera(float deltaTime);
+	// Writes camera and light blocks with one buffer update and attaches them to their binding points
+	void updateFrameUniforms(const glm::mat4& projection, const glm::mat4& view);
 	// Renders text with the elapsed time
 	void printElapsedTime();
 	// Load players and their best time from file
 	void loadPlayerData();
 	void addPlayerData(const PlayerData& player);
-	// Save players and their best time from file
+	// Save players and their best time to file, the file is written in the background
 	void savePlayerData();
-	// Internal render functions
+	// Internal render functions, they set strings of the text batch which is drawn at the end of the frame
 	void renderPlayerList();
+	// Renders draw calls, triangles and culled items of the last frame
+	void renderFrameStats();
 };
\ No newline at end of file
@@ -0,0 +1,249 @@
+#include "GeometryBuffer.h"
+
+#include <cstdint>
+#include <iterator>
+
+#include <glad/glad.h>
+
+GeometryBuffer & GeometryBuffer::get(VertexFormat format)
+{
+	std::unique_ptr<GeometryBuffer>& instance = getInstance(format);
+	if (!instance)
+	{
+		instance.reset(new GeometryBuffer(format));
+	}
+	return *instance;
+}
+
+void GeometryBuffer::releaseAll()
+{
+	getInstance(VertexFormat::Standard).reset();
+	getInstance(VertexFormat::Compact).reset();
+}
+
+std::unique_ptr<GeometryBuffer>& GeometryBuffer::getInstance(VertexFormat format)
+{
+	static std::unique_ptr<GeometryBuffer> standardBuffer;
+	static std::unique_ptr<GeometryBuffer> compactBuffer;
+	return format == VertexFormat::Compact ? compactBuffer : standardBuffer;
+}
+
+GeometryBuffer::GeometryBuffer(VertexFormat format)
+	: format(format), vertexSize(format == VertexFormat::Compact ? sizeof(CompactVertex) : sizeof(Vertex)),
+	vertexCapacity(INITIAL_VERTEX_CAPACITY), indexCapacity(INITIAL_INDEX_CAPACITY)
+{
+	glGenVertexArrays(1, &vao);
+	glGenVertexArrays(1, &depthVao);
+	glGenBuffers(1, &vbo);
+	glGenBuffers(1, &ebo);
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+	glBufferData(GL_COPY_WRITE_BUFFER, indexCapacity, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+	glBufferData(GL_COPY_WRITE_BUFFER, vertexCapacity * vertexSize, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	attachBuffers();
+
+	vertexRanges.grow(0, vertexCapacity);
+	indexRanges.grow(0, indexCapacity);
+}
+
+GeometryBuffer::~GeometryBuffer()
+{
+	glDeleteVertexArrays(1, &vao);
+	glDeleteVertexArrays(1, &depthVao);
+	glDeleteBuffers(1, &vbo);
+	glDeleteBuffers(1, &ebo);
+}
+
+unsigned int GeometryBuffer::addVertices(const void * vertices, unsigned int vertexCount)
+{
+	size_t firstVertex = vertexRanges.allocate(vertexCount);
+	if (firstVertex == SIZE_MAX)
+	{
+		growVertices(vertexCount);
+		firstVertex = vertexRanges.allocate(vertexCount);
+	}
+
+	// Copy target doesn't disturb the array buffer binding of whoever is drawing
+	glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, firstVertex * vertexSize, vertexCount * vertexSize, vertices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	return static_cast<unsigned int>(firstVertex);
+}
+
+size_t GeometryBuffer::addIndices(const void * indices, size_t size)
+{
+	size_t alignedSize = (size + INDEX_ALIGNMENT - 1) / INDEX_ALIGNMENT * INDEX_ALIGNMENT;
+	size_t offset = indexRanges.allocate(alignedSize);
+	if (offset == SIZE_MAX)
+	{
+		growIndices(alignedSize);
+		offset = indexRanges.allocate(alignedSize);
+	}
+
+	// Binding the element buffer would change the VAO that happens to be bound, copy target doesn't
+	glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, indices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	return offset;
+}
+
+void GeometryBuffer::removeVertices(unsigned int firstVertex, unsigned int vertexCount)
+{
+	vertexRanges.free(firstVertex, vertexCount);
+}
+
+void GeometryBuffer::removeIndices(size_t offset, size_t size)
+{
+	indexRanges.free(offset, (size + INDEX_ALIGNMENT - 1) / INDEX_ALIGNMENT * INDEX_ALIGNMENT);
+}
+
+void GeometryBuffer::bind() const
+{
+	glBindVertexArray(vao);
+}
+
+void GeometryBuffer::unbind()
+{
+	glBindVertexArray(0);
+}
+
+void GeometryBuffer::setupAttributes(bool positionOnly) const
+{
+	if (format == VertexFormat::Compact)
+	{
+		// Normalized integers are converted to [0, 1] or [-1, 1] floats when fetched, shader only has to rescale them
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, Position));
+		if (positionOnly)
+		{
+			return;
+		}
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, Normal));
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, TexCoords));
+	}
+	else
+	{
+		// Vertex Positions
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+		if (positionOnly)
+		{
+			return;
+		}
+		// Vertex normals
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+		// Vertex texture coords
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+	}
+}
+
+void GeometryBuffer::attachBuffers() const
+{
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	setupAttributes(false);
+	glBindVertexArray(depthVao);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	setupAttributes(true);
+	glBindVertexArray(0);
+}
+
+unsigned int GeometryBuffer::resizeBuffer(unsigned int buffer, size_t oldSize, size_t newSize)
+{
+	unsigned int newBuffer;
+	glGenBuffers(1, &newBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, newSize, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	glDeleteBuffers(1, &buffer);
+	return newBuffer;
+}
+
+void GeometryBuffer::growVertices(size_t requiredVertices)
+{
+	// Doubling keeps the number of copies logarithmic while the city streams in mesh by mesh
+	size_t newCapacity = vertexCapacity * 2;
+	while (newCapacity < vertexCapacity + requiredVertices)
+	{
+		newCapacity *= 2;
+	}
+
+	vbo = resizeBuffer(vbo, vertexCapacity * vertexSize, newCapacity * vertexSize);
+	vertexRanges.grow(vertexCapacity, newCapacity);
+	vertexCapacity = newCapacity;
+
+	// Attribute pointers reference the buffer object, so they have to be set again
+	attachBuffers();
+}
+
+void GeometryBuffer::growIndices(size_t requiredSize)
+{
+	size_t newCapacity = indexCapacity * 2;
+	while (newCapacity < indexCapacity + requiredSize)
+	{
+		newCapacity *= 2;
+	}
+
+	ebo = resizeBuffer(ebo, indexCapacity, newCapacity);
+	indexRanges.grow(indexCapacity, newCapacity);
+	indexCapacity = newCapacity;
+	attachBuffers();
+}
+
+size_t GeometryBuffer::RangeAllocator::allocate(size_t size)
+{
+	for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it)
+	{
+		if (it->second < size)
+		{
+			continue;
+		}
+
+		size_t offset = it->first;
+		size_t remaining = it->second - size;
+		freeRanges.erase(it);
+		if (remaining > 0)
+		{
+			freeRanges.emplace(offset + size, remaining);
+		}
+		return offset;
+	}
+	return SIZE_MAX;
+}
+
+void GeometryBuffer::RangeAllocator::free(size_t offset, size_t size)
+{
+	if (size == 0)
+	{
+		return;
+	}
+
+	auto next = freeRanges.lower_bound(offset);
+	// Merge with the following free range
+	if (next != freeRanges.end() && offset + size == next->first)
+	{
+		size += next->second;
+		next = freeRanges.erase(next);
+	}
+	// Merge with the preceding free range
+	if (next != freeRanges.begin())
+	{
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == offset)
+		{
+			previous->second += size;
+			return;
+		}
+	}
+	freeRanges.emplace(offset, size);
+}
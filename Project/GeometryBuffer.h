@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <memory>
+
+#include "Mesh.h"
+
+// Large vertex and index buffers shared by all meshes of one vertex format, so drawing any of them needs only the
+// format's single VAO. Meshes own ranges of the buffers and are drawn with base vertex and first index offsets.
+// Buffers grow when they run out of space, ranges stay valid because they are offsets. A second VAO over the same buffers
+// fetches only positions for depth-only passes. Must only be used on the GL thread
+class GeometryBuffer
+{
+public:
+	// Buffer holding all meshes of the vertex format, created on first use
+	static GeometryBuffer& get(VertexFormat format);
+	// Deletes all buffers, must be called after every mesh is destroyed and before the GL context is
+	static void releaseAll();
+
+	// Copies vertices laid out in the buffer's format into a free range and returns index of the first one
+	unsigned int addVertices(const void* vertices, unsigned int vertexCount);
+	// Copies indices into a free range and returns its offset in bytes. Ranges are 4 byte aligned so 16 and 32-bit
+	// indices can share the buffer
+	size_t addIndices(const void* indices, size_t size);
+	void removeVertices(unsigned int firstVertex, unsigned int vertexCount);
+	void removeIndices(size_t offset, size_t size);
+	// Binds VAO with both buffers attached
+	void bind() const;
+	unsigned int getVertexArray() const { return vao; }
+	// VAO with only the position attribute enabled, the other attributes aren't fetched
+	unsigned int getDepthVertexArray() const { return depthVao; }
+	static void unbind();
+
+	~GeometryBuffer();
+	GeometryBuffer(const GeometryBuffer& buffer) = delete;
+	GeometryBuffer& operator=(const GeometryBuffer& buffer) = delete;
+private:
+	// First fit allocator of ranges within a buffer, adjacent free ranges are merged
+	class RangeAllocator
+	{
+	public:
+		// Returns offset of the allocated range, or SIZE_MAX if no free range is big enough
+		size_t allocate(size_t size);
+		void free(size_t offset, size_t size);
+		// Adds space at the end of the buffer
+		void grow(size_t oldCapacity, size_t newCapacity) { free(oldCapacity, newCapacity - oldCapacity); }
+	private:
+		std::map<size_t, size_t> freeRanges;   // Offset -> size
+	};
+
+	static const size_t INITIAL_VERTEX_CAPACITY = 1 << 16;
+	static const size_t INITIAL_INDEX_CAPACITY = 1 << 20;
+	static const size_t INDEX_ALIGNMENT = 4;
+
+	VertexFormat format;
+	size_t vertexSize;
+	unsigned int vao, depthVao, vbo, ebo;
+	size_t vertexCapacity;   // In vertices
+	size_t indexCapacity;    // In bytes
+	RangeAllocator vertexRanges;
+	RangeAllocator indexRanges;
+
+	explicit GeometryBuffer(VertexFormat format);
+	static std::unique_ptr<GeometryBuffer>& getInstance(VertexFormat format);
+	// Sets attribute pointers of the vertex format for the bound VAO and vertex buffer
+	void setupAttributes(bool positionOnly) const;
+	// Attaches current buffers to both VAOs
+	void attachBuffers() const;
+	// Reallocates buffer with the new size in bytes and copies its previous content, returns the new buffer
+	static unsigned int resizeBuffer(unsigned int buffer, size_t oldSize, size_t newSize);
+	void growVertices(size_t requiredVertices);
+	void growIndices(size_t requiredSize);
+};
@@ -1,12 +1,19 @@
 #include "HiddenObject.h"
 
-HiddenObject::HiddenObject(const std::string & modelName, const std::string& iconName)
+#include "ShaderVariants.h"
+
+HiddenObject::HiddenObject(const std::string & modelName, const std::string& iconName, bool streamed) : position(0.0f), found(false)
 {
-	objectModel = new Model3D(modelName);
+	objectModel = new Model3D(modelName, streamed);
 	iconFileName = iconName;
 }
 
-void HiddenObject::render(const Shader & shader) const
+HiddenObject::~HiddenObject()
+{
+	delete objectModel;
+}
+
+void HiddenObject::submit(RenderQueue & queue, ShaderVariants & shaders, unsigned int transform, bool inside) const
 {
-	objectModel->render(shader);
+	objectModel->submit(queue, RenderPass::Opaque, shaders, transform, inside);
 }
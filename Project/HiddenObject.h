@@ -5,17 +5,29 @@
 
 using namespace tinyxml2;
 
-// A class that represents object hidden and a game word that player must search for; it renders itself and holds file path to its icon
+class ShaderVariants;
+
+// A class that represents object hidden and a game word that player must search for; it submits its model for rendering and holds file path to its icon
 class HiddenObject
 {
 public:
-	HiddenObject(const std::string& modelFileName, const std::string& iconFileName);
-	void render(const Shader& shader) const;
+	// Streamed object model is loaded in the background, see Model3D
+	HiddenObject(const std::string& modelFileName, const std::string& iconFileName, bool streamed = false);
+	~HiddenObject();
+	// Queues the object's meshes to be drawn with the transform, without frustum tests if it's known to be inside
+	void submit(RenderQueue& queue, ShaderVariants& shaders, unsigned int transform, bool inside = false) const;
+	// Variants the object's meshes will be drawn with, see Model3D
+	void setShaderVariants(ShaderVariants* shaders) { objectModel->setShaderVariants(shaders); }
 	const std::string& getIconFileName() const { return iconFileName; }
+	const Model3D& getModel() const { return *objectModel; }
+	// World position the object model is drawn at
+	const glm::vec3& getPosition() const { return position; }
+	void setPosition(const glm::vec3& newPosition) { position = newPosition; }
 	bool isFound() const { return found; }
 	void setFound(bool isFound) { found = isFound; }
 private:
-	Model* objectModel;
+	Model3D* objectModel;
 	std::string iconFileName;
+	glm::vec3 position;
 	bool found;
 };
\ No newline at end of file
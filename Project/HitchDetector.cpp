@@ -0,0 +1,38 @@
+#include "HitchDetector.h"
+
+#include <iostream>
+
+HitchDetector::HitchDetector() : frameIndex(0), hitchCount(0)
+{
+}
+
+HitchDetector & HitchDetector::shared()
+{
+	static HitchDetector detector;
+	return detector;
+}
+
+void HitchDetector::addEvent(const std::string & event)
+{
+	events.push_back(event);
+}
+
+void HitchDetector::endFrame(float frameMs, float budgetMs)
+{
+	if (frameMs > budgetMs)
+	{
+		++hitchCount;
+		std::cout << "Hitch: frame " << frameIndex << " took " << frameMs << " ms (budget " << budgetMs << " ms)";
+		if (events.empty())
+		{
+			std::cout << ", no gameplay event";
+		}
+		for (size_t i = 0; i < events.size(); ++i)
+		{
+			std::cout << (i == 0 ? " during: " : ", ") << events[i];
+		}
+		std::cout << std::endl;
+	}
+	events.clear();
+	++frameIndex;
+}
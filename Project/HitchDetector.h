@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Logs frames that took longer than their budget together with the gameplay events that happened in them, so a
+// stutter can be traced to what caused it. Must only be called from the GL thread
+class HitchDetector
+{
+public:
+	// Detector shared by the whole application, created on first use
+	static HitchDetector& shared();
+	// Records event of the current frame, e.g. a found object or a scene change
+	void addEvent(const std::string& event);
+	// Ends the current frame which took frameMs. Logs it with its events when it took longer than budgetMs
+	void endFrame(float frameMs, float budgetMs);
+	// Number of frames over budget so far
+	unsigned int getHitchCount() const { return hitchCount; }
+
+	HitchDetector(const HitchDetector& detector) = delete;
+	HitchDetector& operator=(const HitchDetector& detector) = delete;
+private:
+	std::vector<std::string> events;
+	unsigned long long frameIndex;
+	unsigned int hitchCount;
+
+	HitchDetector();
+};
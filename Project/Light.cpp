@@ -162,3 +162,88 @@ void PointLight::load(XMLElement * element)
 		quadraticElement->QueryFloatText(&quadratic);
 	}
 }
+
+DirectionalLightBlock DirectionalLight::getBlock() const
+{
+	DirectionalLightBlock block = {};
+	block.direction = direction;
+	block.ambient = ambient;
+	block.diffuse = diffuse;
+	block.specular = specular;
+	return block;
+}
+
+SpotLightBlock SpotLight::getBlock() const
+{
+	SpotLightBlock block = {};
+	block.position = position;
+	block.direction = direction;
+	// Shaders compare cosines of the angles
+	block.cutOff = cos(cutOff);
+	block.outerCutOff = cos(outerCutOff);
+	block.constant = constant;
+	block.linear = linear;
+	block.quadratic = quadratic;
+	block.ambient = ambient;
+	block.diffuse = diffuse;
+	block.specular = specular;
+	return block;
+}
+
+PointLightBlock PointLight::getBlock() const
+{
+	PointLightBlock block = {};
+	block.position = position;
+	block.constant = constant;
+	block.linear = linear;
+	block.quadratic = quadratic;
+	block.ambient = ambient;
+	block.diffuse = diffuse;
+	block.specular = specular;
+	return block;
+}
+
+float SpotLight::getRange() const
+{
+	return getAttenuationRange(constant, linear, quadratic, ambient, diffuse, specular);
+}
+
+void SpotLight::getBoundingSphere(vec3 & center, float & radius) const
+{
+	// Narrow cones fit the sphere through the apex and the base rim, wide cones the sphere around the base
+	float range = getRange();
+	vec3 axis = normalize(direction);
+	if (outerCutOff <= radians(45.0f))
+	{
+		radius = range / (2.0f * cos(outerCutOff));
+		center = position + axis * radius;
+	}
+	else
+	{
+		radius = range * sin(outerCutOff);
+		center = position + axis * (range * cos(outerCutOff));
+	}
+}
+
+float PointLight::getRange() const
+{
+	return getAttenuationRange(constant, linear, quadratic, ambient, diffuse, specular);
+}
+
+float getAttenuationRange(float constant, float linear, float quadratic, const vec3 & ambient, const vec3 & diffuse, const vec3 & specular)
+{
+	const float maxRange = 1000.0f;
+	vec3 brightest = max(ambient, max(diffuse, specular));
+	float intensity = max(brightest.r, max(brightest.g, brightest.b));
+	// Solves constant + linear * d + quadratic * d^2 = intensity / LIGHT_CUTOFF for d
+	float target = intensity / LIGHT_CUTOFF - constant;
+	if (target <= 0.0f)
+	{
+		return 0.0f;
+	}
+	if (quadratic > 0.0f)
+	{
+		return min((-linear + sqrt(linear * linear + 4.0f * quadratic * target)) / (2.0f * quadratic), maxRange);
+	}
+	return linear > 0.0f ? min(target / linear, maxRange) : maxRange;
+}
@@ -6,6 +6,74 @@
 using namespace tinyxml2;
 using namespace glm;
 
+// Mirrors of the GLSL light structs in the std140 "Lights" uniform block. A vec3 takes 16 bytes unless a float follows it
+struct DirectionalLightBlock
+{
+	vec3 direction;
+	float padding0;
+	vec3 ambient;
+	float padding1;
+	vec3 diffuse;
+	float padding2;
+	vec3 specular;
+	float padding3;
+};
+
+struct SpotLightBlock
+{
+	vec3 position;
+	float padding0;
+	vec3 direction;
+	float cutOff;
+	float outerCutOff;
+	float constant;
+	float linear;
+	float quadratic;
+	vec3 ambient;
+	float padding1;
+	vec3 diffuse;
+	float padding2;
+	vec3 specular;
+	float padding3;
+};
+
+struct PointLightBlock
+{
+	vec3 position;
+	float constant;
+	float linear;
+	float quadratic;
+	float padding0[2];
+	vec3 ambient;
+	float padding1;
+	vec3 diffuse;
+	float padding2;
+	vec3 specular;
+	float padding3;
+};
+
+// Cluster grid of the frame: scale maps fragment coordinates to the cluster column and row, and the log of view depth
+// to the slice with its bias. Count is the number of clusters along each axis
+struct ClusterBlock
+{
+	vec4 scale;
+	ivec4 count;
+};
+
+// Point and spot lights are many, they are read from LightClusters' buffers instead of the block
+struct LightsBlock
+{
+	DirectionalLightBlock dirLight;
+	SpotLightBlock spotLight;   // Flashlight attached to the camera
+	ClusterBlock clusters;
+};
+
+static_assert(sizeof(DirectionalLightBlock) == 64 && sizeof(SpotLightBlock) == 96 && sizeof(PointLightBlock) == 80 && sizeof(ClusterBlock) == 32,
+	"Light blocks must match std140 layout");
+
+// Attenuated light dimmer than this fraction of its brightest color is treated as no light, ranges of lights end there
+static constexpr float LIGHT_CUTOFF = 1.0f / 256.0f;
+
 struct DirectionalLight
 {
 	vec3 direction;
@@ -14,6 +82,8 @@ struct DirectionalLight
 	vec3 specular;
 
 	void load(XMLElement* element);
+	// Converts to the uniform block layout
+	DirectionalLightBlock getBlock() const;
 };
 
 struct SpotLight
@@ -32,6 +102,12 @@ struct SpotLight
 	float quadratic;
 
 	void load(XMLElement* element);
+	// Converts to the uniform block layout
+	SpotLightBlock getBlock() const;
+	// Distance from the position where the light drops below LIGHT_CUTOFF
+	float getRange() const;
+	// Sphere enclosing the lit cone
+	void getBoundingSphere(vec3& center, float& radius) const;
 };
 
 struct PointLight
@@ -47,4 +123,11 @@ struct PointLight
 	vec3 specular;
 
 	void load(XMLElement* element);
-};
\ No newline at end of file
+	// Converts to the uniform block layout
+	PointLightBlock getBlock() const;
+	// Distance from the position where the light drops below LIGHT_CUTOFF
+	float getRange() const;
+};
+
+// Distance where the attenuation of the brightest color falls below LIGHT_CUTOFF, capped for lights that never fade
+float getAttenuationRange(float constant, float linear, float quadratic, const vec3& ambient, const vec3& diffuse, const vec3& specular);
\ No newline at end of file
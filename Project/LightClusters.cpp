@@ -0,0 +1,183 @@
+#include "LightClusters.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glad/glad.h>
+#include <xmmintrin.h>
+
+#include "ThreadPool.h"
+
+LightClusters::LightClusters()
+	: clusterMinX(CLUSTER_COUNT), clusterMinY(CLUSTER_COUNT), clusterMinZ(CLUSTER_COUNT), clusterMaxX(CLUSTER_COUNT), clusterMaxY(CLUSTER_COUNT),
+	clusterMaxZ(CLUSTER_COUNT), sliceNear(CLUSTERS_Z + 1), clusterLights(CLUSTER_COUNT), clusterRanges(CLUSTER_COUNT * 2),
+	lightBuffer(GL_RGBA32F), clusterBuffer(GL_RG32UI), indexBuffer(GL_R32UI)
+{
+}
+
+void LightClusters::setLights(const std::vector<PointLight>& pointLights, const std::vector<SpotLight>& spotLights)
+{
+	lights.clear();
+	bounds.clear();
+	for (const auto& light : pointLights)
+	{
+		float range = light.getRange();
+		if (range <= 0.0f)
+		{
+			continue;
+		}
+		// Cosines below -1 make the spot intensity of every direction 1
+		lights.push_back({ glm::vec4(light.position, light.constant), glm::vec4(light.ambient, light.linear), glm::vec4(light.diffuse, light.quadratic),
+			glm::vec4(light.specular, -3.0f), glm::vec4(0.0f, 0.0f, -1.0f, -2.0f) });
+		bounds.push_back({ light.position, range });
+	}
+	for (const auto& light : spotLights)
+	{
+		Sphere sphere;
+		light.getBoundingSphere(sphere.center, sphere.radius);
+		if (sphere.radius <= 0.0f)
+		{
+			continue;
+		}
+		lights.push_back({ glm::vec4(light.position, light.constant), glm::vec4(light.ambient, light.linear), glm::vec4(light.diffuse, light.quadratic),
+			glm::vec4(light.specular, cos(light.outerCutOff)), glm::vec4(glm::normalize(light.direction), cos(light.cutOff)) });
+		bounds.push_back(sphere);
+	}
+	lightsChanged = true;
+}
+
+void LightClusters::assign(const glm::mat4 & view, const glm::mat4 & projection, float nearPlane, float farPlane)
+{
+	glm::vec4 frustum(projection[0][0], projection[1][1], nearPlane, farPlane);
+	if (frustum != builtFor)
+	{
+		buildClusters(projection[0][0], projection[1][1], nearPlane, farPlane);
+		builtFor = frustum;
+	}
+
+	// View matrix is rigid, so radii stay the same
+	viewBounds.resize(bounds.size());
+	for (size_t i = 0; i < bounds.size(); ++i)
+	{
+		viewBounds[i] = { glm::vec3(view * glm::vec4(bounds[i].center, 1.0f)), bounds[i].radius };
+	}
+
+	// Slices write only their own clusters, so they need no synchronization
+	ThreadPool::shared().parallelFor(CLUSTERS_Z, [this](size_t slice)
+	{
+		assignSlice(static_cast<unsigned int>(slice));
+	});
+
+	lightIndices.clear();
+	maxClusterLights = 0;
+	for (unsigned int i = 0; i < CLUSTER_COUNT; ++i)
+	{
+		clusterRanges[i * 2] = static_cast<uint32_t>(lightIndices.size());
+		clusterRanges[i * 2 + 1] = static_cast<uint32_t>(clusterLights[i].size());
+		lightIndices.insert(lightIndices.end(), clusterLights[i].begin(), clusterLights[i].end());
+		maxClusterLights = std::max(maxClusterLights, static_cast<unsigned int>(clusterLights[i].size()));
+	}
+	std::vector<uint8_t> lightVisible(lights.size(), 0);
+	for (uint32_t light : lightIndices)
+	{
+		lightVisible[light] = 1;
+	}
+	visibleLights = static_cast<unsigned int>(std::count(lightVisible.begin(), lightVisible.end(), 1));
+}
+
+void LightClusters::upload()
+{
+	if (lightsChanged)
+	{
+		lightBuffer.update(lights.data(), lights.size() * sizeof(LightTexels));
+		lightsChanged = false;
+	}
+	clusterBuffer.update(clusterRanges.data(), clusterRanges.size() * sizeof(uint32_t));
+	indexBuffer.update(lightIndices.data(), lightIndices.size() * sizeof(uint32_t));
+}
+
+ClusterBlock LightClusters::getBlock(float screenWidth, float screenHeight) const
+{
+	ClusterBlock block;
+	block.scale = glm::vec4(CLUSTERS_X / screenWidth, CLUSTERS_Y / screenHeight, sliceScale, sliceBias);
+	block.count = glm::ivec4(CLUSTERS_X, CLUSTERS_Y, CLUSTERS_Z, 0);
+	return block;
+}
+
+void LightClusters::buildClusters(float scaleX, float scaleY, float nearPlane, float farPlane)
+{
+	// Slice k starts at near * (far / near)^(k / CLUSTERS_Z), so the slice of a depth is a linear function of its log
+	float depthRatio = log(farPlane / nearPlane);
+	sliceScale = CLUSTERS_Z / depthRatio;
+	sliceBias = -sliceScale * log(nearPlane);
+	for (unsigned int slice = 0; slice <= CLUSTERS_Z; ++slice)
+	{
+		sliceNear[slice] = nearPlane * exp(depthRatio * slice / CLUSTERS_Z);
+	}
+
+	// Sides of a cluster are planes through the eye, so its box spans the corners at both depths of the slice
+	for (unsigned int slice = 0; slice < CLUSTERS_Z; ++slice)
+	{
+		float nearDepth = sliceNear[slice];
+		float farDepth = sliceNear[slice + 1];
+		for (unsigned int row = 0; row < CLUSTERS_Y; ++row)
+		{
+			float bottom = -1.0f + 2.0f * row / CLUSTERS_Y;
+			float top = bottom + 2.0f / CLUSTERS_Y;
+			for (unsigned int column = 0; column < CLUSTERS_X; ++column)
+			{
+				float left = -1.0f + 2.0f * column / CLUSTERS_X;
+				float right = left + 2.0f / CLUSTERS_X;
+				unsigned int cluster = (slice * CLUSTERS_Y + row) * CLUSTERS_X + column;
+				clusterMinX[cluster] = std::min(left * nearDepth, left * farDepth) / scaleX;
+				clusterMaxX[cluster] = std::max(right * nearDepth, right * farDepth) / scaleX;
+				clusterMinY[cluster] = std::min(bottom * nearDepth, bottom * farDepth) / scaleY;
+				clusterMaxY[cluster] = std::max(top * nearDepth, top * farDepth) / scaleY;
+				// Camera looks down negative z
+				clusterMinZ[cluster] = -farDepth;
+				clusterMaxZ[cluster] = -nearDepth;
+			}
+		}
+	}
+}
+
+void LightClusters::assignSlice(unsigned int slice)
+{
+	unsigned int first = slice * CLUSTERS_PER_SLICE;
+	for (unsigned int i = first; i < first + CLUSTERS_PER_SLICE; ++i)
+	{
+		clusterLights[i].clear();
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+	for (uint32_t light = 0; light < viewBounds.size(); ++light)
+	{
+		const Sphere& sphere = viewBounds[light];
+		float depth = -sphere.center.z;
+		if (depth + sphere.radius < sliceNear[slice] || depth - sphere.radius > sliceNear[slice + 1])
+		{
+			continue;
+		}
+
+		// Squared distance from the sphere center to each box, zero inside of it
+		__m128 centerX = _mm_set1_ps(sphere.center.x);
+		__m128 centerY = _mm_set1_ps(sphere.center.y);
+		__m128 centerZ = _mm_set1_ps(sphere.center.z);
+		__m128 radiusSquared = _mm_set1_ps(sphere.radius * sphere.radius);
+		for (unsigned int i = first; i < first + CLUSTERS_PER_SLICE; i += 4)
+		{
+			__m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&clusterMinX[i]), centerX), _mm_sub_ps(centerX, _mm_loadu_ps(&clusterMaxX[i]))), zero);
+			__m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&clusterMinY[i]), centerY), _mm_sub_ps(centerY, _mm_loadu_ps(&clusterMaxY[i]))), zero);
+			__m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&clusterMinZ[i]), centerZ), _mm_sub_ps(centerZ, _mm_loadu_ps(&clusterMaxZ[i]))), zero);
+			__m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+			int mask = _mm_movemask_ps(_mm_cmple_ps(distanceSquared, radiusSquared));
+			for (unsigned int lane = 0; mask != 0; ++lane, mask >>= 1)
+			{
+				if (mask & 1)
+				{
+					clusterLights[i + lane].push_back(light);
+				}
+			}
+		}
+	}
+}
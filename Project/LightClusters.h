@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Light.h"
+#include "TextureBuffer.h"
+
+// Clustered light culling for forward shading. The view frustum is split into a grid of clusters, tiles on screen times
+// slices of view depth growing exponentially, and every frame the point and spot lights are assigned to the clusters
+// their bounding spheres touch. Four clusters are tested at a time with SSE and slices are spread across the shared
+// thread pool. Fragment shaders find their cluster and light only with its lights. The assignment uses no GL, only
+// upload does
+class LightClusters
+{
+public:
+	static const unsigned int CLUSTERS_X = 16;
+	static const unsigned int CLUSTERS_Y = 8;
+	static const unsigned int CLUSTERS_Z = 24;
+	static const unsigned int CLUSTER_COUNT = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+	// Texels of one light in the light buffer
+	static const unsigned int TEXELS_PER_LIGHT = 5;
+
+	LightClusters();
+	// Replaces the lights of the scene. Point lights are stored as spot lights with a cone that includes everything
+	void setLights(const std::vector<PointLight>& pointLights, const std::vector<SpotLight>& spotLights);
+	// Assigns lights to the clusters of a symmetric perspective projection
+	void assign(const glm::mat4& view, const glm::mat4& projection, float nearPlane, float farPlane);
+	// Uploads the lights, when they changed, and the clusters of the last assignment
+	void upload();
+	// Cluster parameters of the Lights block for a screen of the size in pixels
+	ClusterBlock getBlock(float screenWidth, float screenHeight) const;
+
+	// Buffer textures for the shaders' lightData (RGBA32F), lightClusters (first light and count per cluster, RG32UI)
+	// and lightIndices (R32UI) samplers
+	unsigned int getLightTexture() const { return lightBuffer.getTexture(); }
+	unsigned int getClusterTexture() const { return clusterBuffer.getTexture(); }
+	unsigned int getIndexTexture() const { return indexBuffer.getTexture(); }
+	unsigned int getLightCount() const { return static_cast<unsigned int>(lights.size()); }
+	// Lights in at least one cluster and the most lights any cluster has after the last assignment
+	unsigned int getVisibleLights() const { return visibleLights; }
+	unsigned int getMaxClusterLights() const { return maxClusterLights; }
+
+	LightClusters(const LightClusters& clusters) = delete;
+	LightClusters& operator=(const LightClusters& clusters) = delete;
+private:
+	// Layout of a light in the light buffer, the shader rebuilds a SpotLight from it
+	struct LightTexels
+	{
+		glm::vec4 positionConstant;
+		glm::vec4 ambientLinear;
+		glm::vec4 diffuseQuadratic;
+		glm::vec4 specularOuterCutOff;
+		glm::vec4 directionCutOff;
+	};
+	static_assert(sizeof(LightTexels) == TEXELS_PER_LIGHT * sizeof(glm::vec4), "Light texels must match TEXELS_PER_LIGHT");
+
+	struct Sphere
+	{
+		glm::vec3 center;
+		float radius;
+	};
+
+	static const unsigned int CLUSTERS_PER_SLICE = CLUSTERS_X * CLUSTERS_Y;
+	static_assert(CLUSTERS_PER_SLICE % 4 == 0, "Slices must be whole SSE registers");
+
+	std::vector<LightTexels> lights;
+	std::vector<Sphere> bounds;        // World space
+	std::vector<Sphere> viewBounds;    // View space of the last assignment
+	bool lightsChanged = false;
+	// View space boxes of the clusters as separate arrays, so four neighbours load into one register
+	std::vector<float> clusterMinX, clusterMinY, clusterMinZ, clusterMaxX, clusterMaxY, clusterMaxZ;
+	std::vector<float> sliceNear;      // View depth where every slice starts, one more entry for the far plane
+	std::vector<std::vector<uint32_t>> clusterLights;
+	float sliceScale = 0.0f;
+	float sliceBias = 0.0f;
+	// Last projection the boxes were built for
+	glm::vec4 builtFor = glm::vec4(0.0f);
+	std::vector<uint32_t> clusterRanges;
+	std::vector<uint32_t> lightIndices;
+	unsigned int visibleLights = 0;
+	unsigned int maxClusterLights = 0;
+	TextureBuffer lightBuffer;
+	TextureBuffer clusterBuffer;
+	TextureBuffer indexBuffer;
+
+	// Builds view space boxes of all clusters
+	void buildClusters(float scaleX, float scaleY, float nearPlane, float farPlane);
+	// Adds lights touching clusters of the slice to their lists
+	void assignSlice(unsigned int slice);
+};
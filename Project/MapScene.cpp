@@ -4,13 +4,13 @@
 #include <GLFW\glfw3.h>
 
 #include "Window.h"
-#include "Model2D.h"
+#include "SpriteBatch.h"
 #include "TextModel.h"
 
 MapScene::~MapScene()
 {
 	delete textModel;
-	delete mapModel;
+	delete mapSprites;
 }
 
 void MapScene::initialize(Window* _window)
@@ -18,14 +18,17 @@ void MapScene::initialize(Window* _window)
 	Scene::initialize(_window);
 
 	shader.compile("TextVertexShader.vs", "TextFragmentShader.fs");
-	// Load map texture and create model to render it
+	// Map is a sprite of the HUD atlas
+	const std::string mapPath = "../Assets/city_map/map.png";
 	float mapSize = 500.0f;
 	float x = window->getScreenWidth() / 2 - mapSize / 2;
 	float y = window->getScreenHeight() / 2 - mapSize / 2;
-	mapModel = new Model2D("../Assets/city_map/map.png", x, y, mapSize);
+	atlas.load(SpriteAtlas::HUD_ATLAS_PATH, { mapPath });
+	mapSprites = new SpriteBatch(atlas);
+	mapSprites->addSprite(mapPath, x, y, mapSize, mapSize);
 	// Create text
 	textModel = new TextModel("../Assets/fonts/Holstein.DDS");
-	textModel->setTextToRender("Press Enter to start game", x - 150, y - 40, 30);
+	textModel->setText(0, "Press Enter to start game", x - 150, y - 40, 30);
 }
 
 void MapScene::render(float deltaTime)
@@ -33,7 +36,7 @@ void MapScene::render(float deltaTime)
 	shader.bind();
 	shader.bindUniform("halfScreenSize", glm::vec2(window->getScreenWidth() / 2, window->getScreenHeight() / 2));
 	textModel->render(shader);
-	mapModel->render(shader);
+	mapSprites->render(shader);
 	shader.unbind();
 }
 
@@ -2,9 +2,10 @@
 
 #include "Scene.h"
 #include "Shader.h"
+#include "SpriteAtlas.h"
 
 class TextModel;
-class Model2D;
+class SpriteBatch;
 
 // Intermediate scene between game and starting scene. Shows game map
 class MapScene : public Scene
@@ -25,5 +26,6 @@ public:
 private:
 	Shader shader;
 	TextModel* textModel;
-	Model2D* mapModel;
+	SpriteAtlas atlas;
+	SpriteBatch* mapSprites;
 };
\ No newline at end of file
@@ -2,42 +2,75 @@
 #include <string>
 #include <glad/glad.h>
 #include "Shader.h"
+#include "ShaderVariants.h"
+#include "StateTracker.h"
+#include "UniformBuffer.h"
 
 
-Material::Material(const std::vector<Texture>& textures, vec3 ambient, vec3 diffuse, vec3 specular, float shininess) 
-	: textures(textures), ambient(ambient), diffuse(diffuse), specular(specular), shininess(shininess)
+Material::Material(const std::vector<Texture>& textures, vec3 ambient, vec3 diffuse, vec3 specular, float shininess, bool alphaTest)
+	: textures(textures)
 {
+	static unsigned int materialCount = 0;
+	sortId = materialCount++;
+
+	// Properties never change, so they are uploaded once
+	MaterialBlock block = {};
+	block.ambient = ambient;
+	block.diffuse = diffuse;
+	block.specular = specular;
+	block.shininess = shininess;
+	uniformBlock = UniformBlockPool::get(UniformBuffer::MATERIAL_BLOCK, sizeof(MaterialBlock)).allocate(&block);
+
+	// Retrieve texture number (the N in diffuse_textureN) for the sampler of each texture
+	unsigned int diffuseNr = 0;
+	unsigned int specularNr = 0;
+	for (const auto& texture : textures)
+	{
+		bool isSpecular = texture.type == "texture_specular";
+		unsigned int& number = isSpecular ? specularNr : diffuseNr;
+		if (number < MAX_SAMPLER_NUMBER)
+		{
+			textureBindings.push_back({ texture.id, isSpecular, number });
+		}
+		++number;
+	}
+	// Without specular map the variant modulates highlights by the diffuse map and has no specular sampler
+	shaderFeatures = specularNr > 0 ? uint32_t(ShaderVariants::HAS_SPECULAR_MAP) : 0u;
+	alphaTested = alphaTest && diffuseNr > 0;
+	if (alphaTested)
+	{
+		shaderFeatures |= ShaderVariants::ALPHA_TEST;
+	}
 }
 
-void Material::bind(const Shader& shader) const
+Material::~Material()
+{
+	UniformBlockPool::get(UniformBuffer::MATERIAL_BLOCK, sizeof(MaterialBlock)).free(uniformBlock);
+}
+
+void Material::bind(const Shader & shader, StateTracker & state) const
 {
 	// Bind material properties
-	shader.bindUniform("material.ambient", ambient);
-	shader.bindUniform("material.diffuse", diffuse);
-	shader.bindUniform("material.specular", specular);
-	shader.bindUniform("material.shininess", shininess);
+	UniformBlockPool::get(UniformBuffer::MATERIAL_BLOCK, sizeof(MaterialBlock)).bind(uniformBlock, state);
 
 	// Bind textures
-	unsigned int diffuseNr = 1;
-	unsigned int specularNr = 1;
-
-	for (unsigned int i = 0; i < textures.size(); ++i)
+	const Bindings& bindings = shader.getBindings<Bindings>();
+	for (const auto& texture : textureBindings)
 	{
-		glActiveTexture(GL_TEXTURE0 + i); // Active proper texture unit before binding
-		// Retrieve texture number (the N in diffuse_textureN)
-		std::string number;
-		std::string name = textures[i].type;
-		if (name == "texture_diffuse")
+		int unit = texture.specular ? bindings.specularUnits[texture.samplerIndex] : bindings.diffuseUnits[texture.samplerIndex];
+		if (unit >= 0)
 		{
-			number = std::to_string(diffuseNr++);
-		}
-		else if (name == "texture_specular")
-		{
-			number = std::to_string(specularNr++);
+			state.bindTexture(static_cast<unsigned int>(unit), GL_TEXTURE_2D, texture.id);
 		}
+	}
+}
 
-		shader.bindUniform(("material." + name + number).c_str(), i);
-		// Bind the texture
-		glBindTexture(GL_TEXTURE_2D, textures[i].id);
+Material::Bindings::Bindings(const Shader & shader)
+{
+	for (unsigned int i = 0; i < MAX_SAMPLER_NUMBER; ++i)
+	{
+		std::string number = std::to_string(i + 1);
+		diffuseUnits[i] = shader.getTextureUnit(("texture_diffuse" + number).c_str());
+		specularUnits[i] = shader.getTextureUnit(("texture_specular" + number).c_str());
 	}
-}
\ No newline at end of file
+}
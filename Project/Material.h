@@ -1,11 +1,15 @@
 #pragma once
 
+#include <cstdint>
+#include <string>
 #include <vector>
 #include <glm/glm.hpp>
 
-using namespace glm;
+#include "Shader.h"
+
+class StateTracker;
 
-class Shader;
+using namespace glm;
 
 struct Texture
 {
@@ -17,13 +21,59 @@ struct Texture
 class Material
 {
 public:
-	Material(const std::vector<Texture>& textures, vec3 ambient = vec3(0.0f), vec3 diffuse = vec3(0.0f), vec3 specular = vec3(0.0f), float shininess = 1.0f);
-	// Bind all material properties/textures to the shader
-	void bind(const Shader& shader) const;
+	// Largest N of texture_diffuseN and texture_specularN samplers a shader may declare
+	static const unsigned int MAX_SAMPLER_NUMBER = 4;
+
+	// Writes material properties to a block of the shared material uniform buffer, must be called on the GL thread. Alpha
+	// test only applies to materials with a diffuse map, as it's the map's alpha that is tested
+	Material(const std::vector<Texture>& textures, vec3 ambient = vec3(0.0f), vec3 diffuse = vec3(0.0f), vec3 specular = vec3(0.0f), float shininess = 1.0f,
+		bool alphaTest = false);
+	~Material();
+	// Binds the material's uniform block and its textures to the units the shader assigned to its samplers. Goes through
+	// the state tracker, which skips textures and block that are already bound
+	void bind(const Shader& shader, StateTracker& state) const;
+	// Number identifying the material in draw sort keys
+	unsigned int getSortId() const { return sortId; }
+	// ShaderVariants feature bits of the smallest variant that draws the material, selected from its textures and alpha test
+	uint32_t getShaderFeatures() const { return shaderFeatures; }
+	// Fragments of the material may be discarded, so its depth is only known once it's shaded
+	bool isAlphaTested() const { return alphaTested; }
+
+	Material(const Material& material) = delete;
+	Material& operator=(const Material& material) = delete;
 private:
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
-	float shininess;
+	// Mirror of the std140 "MaterialData" uniform block
+	struct MaterialBlock
+	{
+		vec3 ambient;
+		float padding0;
+		vec3 diffuse;
+		float padding1;
+		vec3 specular;
+		float shininess;
+	};
+
+	// Texture units of the material samplers in a shader, resolved once per program
+	struct Bindings
+	{
+		int diffuseUnits[MAX_SAMPLER_NUMBER];
+		int specularUnits[MAX_SAMPLER_NUMBER];
+
+		explicit Bindings(const Shader& shader);
+	};
+
+	// Texture with the sampler it's bound to, worked out when the material is created
+	struct TextureBinding
+	{
+		unsigned int id;
+		bool specular;
+		unsigned int samplerIndex;   // N - 1 in texture_diffuseN/texture_specularN
+	};
+
 	std::vector<Texture> textures;
+	std::vector<TextureBinding> textureBindings;
+	unsigned int uniformBlock;     // Index of the block in the material UniformBlockPool
+	unsigned int sortId;
+	uint32_t shaderFeatures;
+	bool alphaTested;
 };
\ No newline at end of file
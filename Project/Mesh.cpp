@@ -1,65 +1,191 @@
 #include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
 #include <string>
 #include <sstream> 
 #include <fstream>
+#include <glm/gtc/packing.hpp>
 #include "Mesh.h"
+#include "GeometryBuffer.h"
 #include "Shader.h"
 
-Mesh::Mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const Material& material) : vertices(vertices), indices(indices), material(material)
+Mesh::Mesh(const Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount, const Material* material,
+	const Bounds& bounds, VertexFormat vertexFormat, const MeshLod* meshLods, unsigned int meshLodCount)
+	: baseVertex(0), vertexCount(vertexCount), indexOffset(0), indexCount(indexCount), indexType(vertexCount <= 0xFFFF ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT),
+	lodCount(0), material(material), vertexFormat(vertexFormat), bounds(bounds), positionOffset(0.0f), positionScale(1.0f)
 {
-	// Set the vertex buffers and its attribute pointers on GPU
-	setupMesh();
+	// Levels pointing outside of the indices are ignored, there is always at least the full mesh
+	for (unsigned int i = 0; i < meshLodCount && lodCount < MAX_LODS; ++i)
+	{
+		if (uint64_t(meshLods[i].firstIndex) + meshLods[i].indexCount <= indexCount)
+		{
+			lods[lodCount++] = meshLods[i];
+		}
+	}
+	if (lodCount == 0)
+	{
+		lods[lodCount++] = { 0, indexCount, 0.0f };
+	}
+
+	// Copy the vertices and indices into the shared buffers on GPU
+	setupMesh(vertices, indices);
 }
 
 Mesh::~Mesh()
 {
-	glDeleteVertexArrays(1, &vao);
-	// Delete buffers
-	glDeleteBuffers(1, &vbo);
-	glDeleteBuffers(1, &ebo);
+	// Return ranges to the shared buffers
+	GeometryBuffer& geometry = GeometryBuffer::get(vertexFormat);
+	geometry.removeVertices(baseVertex, vertexCount);
+	geometry.removeIndices(indexOffset, getIndexSize());
 }
 
-void Mesh::render(const Shader& shader) const
+void Mesh::bindVertexFormat(const Shader& shader) const
 {
-	// Bind material
-	material.bind(shader);
-	// Draw mesh
-	glBindVertexArray(vao);
-	glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
-	// Set everything back to defaults once configured
-	glActiveTexture(GL_TEXTURE0);
+	// Tell vertex shader how to decode vertices
+	const Bindings& bindings = shader.getBindings<Bindings>();
+	if (vertexFormat == VertexFormat::Compact)
+	{
+		shader.bindUniform(bindings.compactVertices, 1);
+		shader.bindUniform(bindings.positionOffset, positionOffset);
+		shader.bindUniform(bindings.positionScale, positionScale);
+	}
+	else
+	{
+		shader.bindUniform(bindings.compactVertices, 0);
+	}
 }
 
-void Mesh::setupMesh()
+void Mesh::draw(unsigned int lod) const
 {
-	// Create buffers/arrays
-	glGenVertexArrays(1, &vao);
-	glGenBuffers(1, &vbo);
-	glGenBuffers(1, &ebo);
-
-	glBindVertexArray(vao);
-	// Load data into vertex buffers
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	// A great thing about structs is that their memory layout is sequential for all its items.
-	// The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-	// again translates to 3/2 floats which translates to a byte array.
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
-
-	// Set the vertex attribute pointers
-	// Vertex Positions
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-	// Vertex normals
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-	// Vertex texture coords
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-
-	// Unbind VAO so no one can change it
-	glBindVertexArray(0);
+	glDrawElementsBaseVertex(GL_TRIANGLES, getIndexCount(lod), indexType, (void*)getIndexOffset(lod), baseVertex);
+}
+
+void Mesh::drawInstanced(unsigned int lod, unsigned int instanceCount) const
+{
+	glDrawElementsInstancedBaseVertex(GL_TRIANGLES, getIndexCount(lod), indexType, (void*)getIndexOffset(lod), instanceCount, baseVertex);
+}
+
+void Mesh::setupMesh(const Vertex* vertices, const unsigned int* indices)
+{
+	GeometryBuffer& geometry = GeometryBuffer::get(vertexFormat);
+
+	if (indexType == GL_UNSIGNED_SHORT)
+	{
+		// Halves index fetch bandwidth, indices are relative to the base vertex so most meshes qualify
+		std::vector<uint16_t> shortIndices(indices, indices + indexCount);
+		indexOffset = geometry.addIndices(shortIndices.data(), getIndexSize());
+	}
+	else
+	{
+		indexOffset = geometry.addIndices(indices, getIndexSize());
+	}
+
+	if (vertexFormat == VertexFormat::Compact)
+	{
+		std::vector<CompactVertex> compactVertices = encodeVertices(vertices, vertexCount);
+		baseVertex = geometry.addVertices(compactVertices.data(), vertexCount);
+	}
+	else
+	{
+		// A great thing about structs is that their memory layout is sequential for all its items,
+		// so the array can be copied to the buffer as it is
+		baseVertex = geometry.addVertices(vertices, vertexCount);
+	}
+}
+
+Mesh::Bindings::Bindings(const Shader & shader)
+	: compactVertices(shader.getUniform<int>("compactVertices")), positionOffset(shader.getUniform<vec3>("positionOffset")),
+	positionScale(shader.getUniform<vec3>("positionScale"))
+{
+}
+
+size_t Mesh::getIndexSize() const
+{
+	return indexCount * getIndexElementSize();
+}
+
+Bounds Mesh::computeBounds(const Vertex * vertices, unsigned int vertexCount)
+{
+	Bounds bounds;
+	bounds.min = vertexCount > 0 ? vertices[0].Position : glm::vec3(0.0f);
+	bounds.max = bounds.min;
+	for (unsigned int i = 1; i < vertexCount; ++i)
+	{
+		bounds.min = glm::min(bounds.min, vertices[i].Position);
+		bounds.max = glm::max(bounds.max, vertices[i].Position);
+	}
+
+	// Sphere around the box center through the farthest vertex, never larger than the box's circumscribed sphere
+	bounds.sphereCenter = (bounds.min + bounds.max) * 0.5f;
+	float radiusSquared = 0.0f;
+	for (unsigned int i = 0; i < vertexCount; ++i)
+	{
+		glm::vec3 offset = vertices[i].Position - bounds.sphereCenter;
+		radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+	}
+	bounds.sphereRadius = std::sqrt(radiusSquared);
+	return bounds;
+}
+
+Bounds Mesh::transformBounds(const Bounds & bounds, const glm::mat4 & transform)
+{
+	// Extents of the transformed box are the extents projected onto the absolute basis vectors
+	glm::mat3 basis(transform);
+	glm::mat3 absoluteBasis(glm::abs(basis[0]), glm::abs(basis[1]), glm::abs(basis[2]));
+	glm::vec3 center = glm::vec3(transform * glm::vec4((bounds.min + bounds.max) * 0.5f, 1.0f));
+	glm::vec3 extents = absoluteBasis * ((bounds.max - bounds.min) * 0.5f);
+	float scale = std::max(glm::length(basis[0]), std::max(glm::length(basis[1]), glm::length(basis[2])));
+
+	Bounds result;
+	result.min = center - extents;
+	result.max = center + extents;
+	result.sphereCenter = glm::vec3(transform * glm::vec4(bounds.sphereCenter, 1.0f));
+	result.sphereRadius = bounds.sphereRadius * scale;
+	return result;
+}
+
+std::vector<CompactVertex> Mesh::encodeVertices(const Vertex* vertices, unsigned int vertexCount)
+{
+	// Quantize positions relative to the bounding box of the mesh to use the full 16-bit range
+	positionOffset = bounds.min;
+	positionScale = bounds.max - bounds.min;
+
+	std::vector<CompactVertex> compactVertices(vertexCount);
+	for (unsigned int i = 0; i < vertexCount; ++i)
+	{
+		CompactVertex& compact = compactVertices[i];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			// Flat axis (e.g. a quad) has zero scale, any value decodes to the offset
+			float relative = positionScale[axis] > 0.0f ? (vertices[i].Position[axis] - positionOffset[axis]) / positionScale[axis] : 0.0f;
+			compact.Position[axis] = glm::packUnorm1x16(relative);
+		}
+		compact.Position[3] = 0;
+
+		glm::vec2 normal = encodeOctahedral(vertices[i].Normal);
+		compact.Normal[0] = static_cast<int16_t>(glm::packSnorm1x16(normal.x));
+		compact.Normal[1] = static_cast<int16_t>(glm::packSnorm1x16(normal.y));
+
+		compact.TexCoords[0] = glm::packHalf1x16(vertices[i].TexCoords.x);
+		compact.TexCoords[1] = glm::packHalf1x16(vertices[i].TexCoords.y);
+	}
+	return compactVertices;
+}
+
+glm::vec2 Mesh::encodeOctahedral(const glm::vec3& normal)
+{
+	float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+	if (length == 0.0f)
+	{
+		return glm::vec2(0.0f);
+	}
+
+	// Project onto the octahedron, lower half is folded over the diagonals
+	glm::vec2 projected = glm::vec2(normal.x, normal.y) / length;
+	if (normal.z < 0.0f)
+	{
+		glm::vec2 sign(projected.x >= 0.0f ? 1.0f : -1.0f, projected.y >= 0.0f ? 1.0f : -1.0f);
+		projected = (1.0f - glm::abs(glm::vec2(projected.y, projected.x))) * sign;
+	}
+	return projected;
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -8,8 +9,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "Material.h"
-
-class Shader;
+#include "Shader.h"
 
 struct Vertex
 {
@@ -18,19 +18,113 @@ struct Vertex
 	glm::vec2 TexCoords;
 };
 
+// Quantized vertex, half the size of Vertex. Position is 16-bit unsigned normalized within the mesh bounding box
+// (4th component is padding), normal is octahedral encoded in two 16-bit signed normalized values and texture
+// coordinates are half floats. Decoded in the vertex shader
+struct CompactVertex
+{
+	uint16_t Position[4];
+	int16_t Normal[2];
+	uint16_t TexCoords[2];
+};
+
+// Bounding volumes of a mesh in model space. The sphere is centered in the box and encloses all vertices, it's usually
+// tighter than the box for elongated meshes under rotation
+struct Bounds
+{
+	glm::vec3 min;
+	glm::vec3 max;
+	glm::vec3 sphereCenter;
+	float sphereRadius;
+};
+
+// Level of detail of a mesh: a range of its indices drawn with the same vertices. Error is how far the simplified
+// surface deviates from the full one, relative to the bounding sphere radius; the full mesh has 0
+struct MeshLod
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error;
+};
+
+// Layout of vertex buffers, selected per model
+enum class VertexFormat
+{
+	Standard,
+	Compact
+};
+
 class Mesh
 {
 public:
-	Mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const Material& material);
+	// Copies vertex and index data from the passed arrays into the shared GeometryBuffer of the vertex format, they don't
+	// have to outlive the mesh. Material is owned by the model and must outlive the mesh. Bounds are computed at import
+	// with computeBounds. Compact format quantizes vertices before upload. Meshes with fewer than 65536 vertices are
+	// drawn with 16-bit indices. Indices hold all levels of detail, without levels the whole array is the only level
+	Mesh(const Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount, const Material* material,
+		const Bounds& bounds, VertexFormat vertexFormat = VertexFormat::Standard, const MeshLod* lods = nullptr, unsigned int lodCount = 0);
 	~Mesh();
-	// Render the mesh using shader passed as an argument
-	void render(const Shader& shader) const;
+	// Sets uniforms the vertex shader needs to decode this mesh's vertices
+	void bindVertexFormat(const Shader& shader) const;
+	// Issues the draw call of the level of detail, expects the GeometryBuffer of the vertex format to be bound
+	void draw(unsigned int lod = 0) const;
+	// Draws instances of the level of detail, the shader takes their transforms from gl_InstanceID
+	void drawInstanced(unsigned int lod, unsigned int instanceCount) const;
+
+	const Material* getMaterial() const { return material; }
+	VertexFormat getVertexFormat() const { return vertexFormat; }
+	unsigned int getIndexType() const { return indexType; }
+	// Indices of the level of detail, level 0 is the full mesh
+	unsigned int getIndexCount(unsigned int lod = 0) const { return lods[lod].indexCount; }
+	// Byte offset of the level's first index within the shared index buffer
+	size_t getIndexOffset(unsigned int lod = 0) const { return indexOffset + lods[lod].firstIndex * getIndexElementSize(); }
+	unsigned int getLodCount() const { return lodCount; }
+	float getLodError(unsigned int lod) const { return lods[lod].error; }
+	// Index of the first vertex within the shared vertex buffer, added to every index
+	unsigned int getBaseVertex() const { return baseVertex; }
+	// Bounding volumes in model space
+	const Bounds& getBounds() const { return bounds; }
+
+	// Computes bounding box and sphere of the vertices
+	static Bounds computeBounds(const Vertex* vertices, unsigned int vertexCount);
+	// Bounds enclosing the transformed bounds: box around the transformed box, sphere scaled by the largest axis scale
+	static Bounds transformBounds(const Bounds& bounds, const glm::mat4& transform);
+
+	static const unsigned int MAX_LODS = 4;
+
+	Mesh(const Mesh& mesh) = delete;
+	Mesh& operator=(const Mesh& mesh) = delete;
 private:
-	unsigned int vao, vbo, ebo;
-	std::vector<Vertex> vertices;
-	std::vector<unsigned int> indices;
-	Material material;
+	// Vertex decoding uniforms of a shader, resolved once per program
+	struct Bindings
+	{
+		Uniform<int> compactVertices;
+		Uniform<vec3> positionOffset;
+		Uniform<vec3> positionScale;
+
+		explicit Bindings(const Shader& shader);
+	};
+
+	unsigned int baseVertex, vertexCount;
+	size_t indexOffset;
+	unsigned int indexCount;    // Indices of all levels of detail
+	unsigned int indexType;     // GL_UNSIGNED_SHORT when all vertices are addressable with 16 bits, otherwise GL_UNSIGNED_INT
+	MeshLod lods[MAX_LODS];
+	unsigned int lodCount;
+	const Material* material;
+	VertexFormat vertexFormat;
+	Bounds bounds;
+	// Bounding box used to dequantize compact positions: position = offset + encoded * scale
+	glm::vec3 positionOffset;
+	glm::vec3 positionScale;
 
-	// Initializes all the buffer objects/arrays
-	void setupMesh();
+	// Uploads vertices and indices into the shared buffers
+	void setupMesh(const Vertex* vertices, const unsigned int* indices);
+	// Size of the index data in bytes
+	size_t getIndexSize() const;
+	size_t getIndexElementSize() const { return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int); }
+	// Quantizes vertices into the compact format relative to the bounding box
+	std::vector<CompactVertex> encodeVertices(const Vertex* vertices, unsigned int vertexCount);
+	// Maps unit vector onto the octahedron unfolded into [-1, 1] square
+	static glm::vec2 encodeOctahedral(const glm::vec3& normal);
 };
\ No newline at end of file
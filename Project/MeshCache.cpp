@@ -0,0 +1,362 @@
+#include "MeshCache.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+	const char CACHE_MAGIC[4] = { 'H', 'O', 'M', 'C' };
+	const uint32_t CACHE_VERSION = 7;
+	const size_t BLOB_ALIGNMENT = 16;
+
+	struct CacheHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t sourceHash;
+		uint32_t vertexSize;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t meshCount;
+		uint32_t materialCount;
+		uint32_t instanceCount;
+		uint32_t bvhNodeCount;
+		uint32_t bvhPrimitiveCount;
+		uint32_t occluderCount;
+		uint32_t occluderVertexCount;
+		uint32_t occluderIndexCount;
+		uint64_t meshOffset;
+		uint64_t materialOffset;
+		uint64_t instanceOffset;
+		uint64_t vertexOffset;
+		uint64_t indexOffset;
+		uint64_t bvhNodeOffset;
+		uint64_t bvhPrimitiveOffset;
+		uint64_t occluderOffset;
+		uint64_t occluderVertexOffset;
+		uint64_t occluderIndexOffset;
+		uint64_t fileSize;
+	};
+
+	// Appends plain data to the output buffer
+	class BinaryWriter
+	{
+	public:
+		std::string buffer;
+
+		void write(const void* data, size_t size) { buffer.append(static_cast<const char*>(data), size); }
+		template <typename T> void write(const T& value) { write(&value, sizeof(T)); }
+		void writeString(const std::string& str)
+		{
+			write(static_cast<uint32_t>(str.size()));
+			write(str.data(), str.size());
+		}
+		// Pads buffer so the next blob starts at an aligned offset and returns that offset
+		uint64_t align()
+		{
+			buffer.resize((buffer.size() + BLOB_ALIGNMENT - 1) / BLOB_ALIGNMENT * BLOB_ALIGNMENT, '\0');
+			return buffer.size();
+		}
+	};
+
+	// Reads plain data from the mapped file, every read is bounds checked
+	class BinaryReader
+	{
+	public:
+		BinaryReader(const unsigned char* data, size_t size, size_t offset) : data(data), size(size), offset(offset), valid(offset <= size) {}
+
+		bool isValid() const { return valid; }
+		template <typename T> void read(T& value)
+		{
+			if (!valid || size - offset < sizeof(T))
+			{
+				valid = false;
+				return;
+			}
+			memcpy(&value, data + offset, sizeof(T));
+			offset += sizeof(T);
+		}
+		void readString(std::string& str)
+		{
+			uint32_t length = 0;
+			read(length);
+			if (!valid || size - offset < length)
+			{
+				valid = false;
+				return;
+			}
+			str.assign(reinterpret_cast<const char*>(data + offset), length);
+			offset += length;
+		}
+	private:
+		const unsigned char* data;
+		size_t size;
+		size_t offset;
+		bool valid;
+	};
+
+	void writeTextureList(BinaryWriter& writer, const std::vector<std::string>& textures)
+	{
+		writer.write(static_cast<uint32_t>(textures.size()));
+		for (const auto& texture : textures)
+		{
+			writer.writeString(texture);
+		}
+	}
+
+	void readTextureList(BinaryReader& reader, std::vector<std::string>& textures)
+	{
+		uint32_t count = 0;
+		reader.read(count);
+		for (uint32_t i = 0; i < count && reader.isValid(); ++i)
+		{
+			std::string texture;
+			reader.readString(texture);
+			textures.push_back(texture);
+		}
+	}
+}
+
+std::string MeshCache::getCachePath(const std::string & modelPath)
+{
+	return modelPath + ".mesh";
+}
+
+uint64_t MeshCache::hashSource(const std::string & modelPath)
+{
+	std::string content;
+	if (!FileUtil::loadBinaryFile(modelPath, content))
+	{
+		return 0;
+	}
+	uint64_t sourceHash = FileUtil::hash(content.data(), content.size());
+
+	// Material libraries are referenced by "mtllib" lines and are relative to the model directory
+	std::string directory = modelPath.substr(0, modelPath.find_last_of('/'));
+	std::istringstream stream(content);
+	std::string line;
+	while (std::getline(stream, line))
+	{
+		if (line.compare(0, 7, "mtllib ") != 0)
+		{
+			continue;
+		}
+
+		std::string libraryName = line.substr(7);
+		libraryName.erase(libraryName.find_last_not_of(" \t\r") + 1);
+		std::string library;
+		if (FileUtil::loadBinaryFile(directory + "/" + libraryName, library))
+		{
+			sourceHash = FileUtil::hash(library.data(), library.size(), sourceHash);
+		}
+		else
+		{
+			sourceHash = FileUtil::hash(libraryName.data(), libraryName.size(), sourceHash);
+		}
+	}
+
+	// Zero is reserved for "source is unavailable"
+	return sourceHash == 0 ? 1 : sourceHash;
+}
+
+bool MeshCache::save(const std::string & cachePath, uint64_t sourceHash, const ModelData & data)
+{
+	CacheHeader header = {};
+	memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.version = CACHE_VERSION;
+	header.sourceHash = sourceHash;
+	header.vertexSize = sizeof(Vertex);
+	header.vertexCount = static_cast<uint32_t>(data.vertices.size());
+	header.indexCount = static_cast<uint32_t>(data.indices.size());
+	header.meshCount = static_cast<uint32_t>(data.meshes.size());
+	header.materialCount = static_cast<uint32_t>(data.materials.size());
+	header.instanceCount = static_cast<uint32_t>(data.instances.size());
+	header.bvhNodeCount = static_cast<uint32_t>(data.bvhNodes.size());
+	header.bvhPrimitiveCount = static_cast<uint32_t>(data.bvhPrimitives.size());
+	header.occluderCount = static_cast<uint32_t>(data.occluders.size());
+	header.occluderVertexCount = static_cast<uint32_t>(data.occluderVertices.size());
+	header.occluderIndexCount = static_cast<uint32_t>(data.occluderIndices.size());
+
+	BinaryWriter writer;
+	writer.write(header);
+
+	header.meshOffset = writer.align();
+	writer.write(data.meshes.data(), data.meshes.size() * sizeof(MeshRange));
+
+	header.materialOffset = writer.align();
+	for (const auto& material : data.materials)
+	{
+		writer.write(material.ambient);
+		writer.write(material.diffuse);
+		writer.write(material.specular);
+		writer.write(material.shininess);
+		writeTextureList(writer, material.diffuseTextures);
+		writeTextureList(writer, material.specularTextures);
+	}
+
+	header.instanceOffset = writer.align();
+	writer.write(data.instances.data(), data.instances.size() * sizeof(MeshInstance));
+
+	header.vertexOffset = writer.align();
+	writer.write(data.vertices.data(), data.vertices.size() * sizeof(Vertex));
+
+	header.indexOffset = writer.align();
+	writer.write(data.indices.data(), data.indices.size() * sizeof(unsigned int));
+
+	header.bvhNodeOffset = writer.align();
+	writer.write(data.bvhNodes.data(), data.bvhNodes.size() * sizeof(BvhNode));
+
+	header.bvhPrimitiveOffset = writer.align();
+	writer.write(data.bvhPrimitives.data(), data.bvhPrimitives.size() * sizeof(uint32_t));
+
+	header.occluderOffset = writer.align();
+	writer.write(data.occluders.data(), data.occluders.size() * sizeof(OccluderRange));
+
+	header.occluderVertexOffset = writer.align();
+	writer.write(data.occluderVertices.data(), data.occluderVertices.size() * sizeof(glm::vec3));
+
+	header.occluderIndexOffset = writer.align();
+	writer.write(data.occluderIndices.data(), data.occluderIndices.size() * sizeof(uint32_t));
+
+	header.fileSize = writer.buffer.size();
+	memcpy(&writer.buffer[0], &header, sizeof(header));
+
+	std::ofstream fileStream(cachePath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!fileStream.is_open())
+	{
+		return false;
+	}
+	fileStream.write(writer.buffer.data(), writer.buffer.size());
+	return fileStream.good();
+}
+
+bool MeshCache::open(const std::string & cachePath, uint64_t sourceHash)
+{
+	if (!file.open(cachePath))
+	{
+		return false;
+	}
+
+	const unsigned char* data = file.getData();
+	size_t size = file.getSize();
+
+	CacheHeader header;
+	if (size < sizeof(header))
+	{
+		file.close();
+		return false;
+	}
+	memcpy(&header, data, sizeof(header));
+
+	bool valid = memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0
+		&& header.version == CACHE_VERSION
+		&& header.vertexSize == sizeof(Vertex)
+		&& header.fileSize == size
+		&& (sourceHash == 0 || header.sourceHash == sourceHash)
+		&& header.meshOffset + uint64_t(header.meshCount) * sizeof(MeshRange) <= size
+		&& header.instanceOffset + uint64_t(header.instanceCount) * sizeof(MeshInstance) <= size
+		&& header.vertexOffset + uint64_t(header.vertexCount) * sizeof(Vertex) <= size
+		&& header.indexOffset + uint64_t(header.indexCount) * sizeof(unsigned int) <= size
+		&& header.bvhNodeOffset + uint64_t(header.bvhNodeCount) * sizeof(BvhNode) <= size
+		&& header.bvhPrimitiveOffset + uint64_t(header.bvhPrimitiveCount) * sizeof(uint32_t) <= size
+		&& header.occluderOffset + uint64_t(header.occluderCount) * sizeof(OccluderRange) <= size
+		&& header.occluderVertexOffset + uint64_t(header.occluderVertexCount) * sizeof(glm::vec3) <= size
+		&& header.occluderIndexOffset + uint64_t(header.occluderIndexCount) * sizeof(uint32_t) <= size;
+	if (!valid)
+	{
+		file.close();
+		return false;
+	}
+
+	meshes.resize(header.meshCount);
+	memcpy(meshes.data(), data + header.meshOffset, meshes.size() * sizeof(MeshRange));
+	instances.resize(header.instanceCount);
+	memcpy(instances.data(), data + header.instanceOffset, instances.size() * sizeof(MeshInstance));
+	occluders.resize(header.occluderCount);
+	memcpy(occluders.data(), data + header.occluderOffset, occluders.size() * sizeof(OccluderRange));
+
+	BinaryReader reader(data, size, static_cast<size_t>(header.materialOffset));
+	materials.resize(header.materialCount);
+	for (auto& material : materials)
+	{
+		reader.read(material.ambient);
+		reader.read(material.diffuse);
+		reader.read(material.specular);
+		reader.read(material.shininess);
+		readTextureList(reader, material.diffuseTextures);
+		readTextureList(reader, material.specularTextures);
+	}
+
+	// Make sure mesh ranges don't point outside of the stored arrays
+	for (const auto& mesh : meshes)
+	{
+		if (uint64_t(mesh.firstVertex) + mesh.vertexCount > header.vertexCount || uint64_t(mesh.firstIndex) + mesh.indexCount > header.indexCount
+			|| mesh.materialIndex >= header.materialCount || mesh.lodCount == 0 || mesh.lodCount > Mesh::MAX_LODS)
+		{
+			valid = false;
+			continue;
+		}
+		for (uint32_t i = 0; i < mesh.lodCount; ++i)
+		{
+			if (uint64_t(mesh.lods[i].firstIndex) + mesh.lods[i].indexCount > mesh.indexCount)
+			{
+				valid = false;
+			}
+		}
+	}
+
+	for (const auto& instance : instances)
+	{
+		if (instance.meshIndex >= header.meshCount)
+		{
+			valid = false;
+		}
+	}
+
+	// Occluder indices are only checked against the range, the rasterizer reads vertices they reference
+	const uint32_t* occluderIndexData = reinterpret_cast<const uint32_t*>(data + header.occluderIndexOffset);
+	for (const auto& occluder : occluders)
+	{
+		if (uint64_t(occluder.firstVertex) + occluder.vertexCount > header.occluderVertexCount
+			|| uint64_t(occluder.firstIndex) + occluder.indexCount > header.occluderIndexCount || occluder.meshIndex >= header.meshCount)
+		{
+			valid = false;
+			break;
+		}
+		for (uint32_t i = 0; i < occluder.indexCount; ++i)
+		{
+			if (occluderIndexData[occluder.firstIndex + i] >= occluder.vertexCount)
+			{
+				valid = false;
+				break;
+			}
+		}
+	}
+
+	const BvhNode* nodes = reinterpret_cast<const BvhNode*>(data + header.bvhNodeOffset);
+	const uint32_t* primitives = reinterpret_cast<const uint32_t*>(data + header.bvhPrimitiveOffset);
+	valid = valid && Bvh::validate(nodes, header.bvhNodeCount, primitives, header.bvhPrimitiveCount, header.instanceCount);
+
+	if (!valid || !reader.isValid())
+	{
+		std::cout << "Mesh cache " << cachePath << " is corrupted" << std::endl;
+		meshes.clear();
+		materials.clear();
+		instances.clear();
+		occluders.clear();
+		file.close();
+		return false;
+	}
+
+	vertices = reinterpret_cast<const Vertex*>(data + header.vertexOffset);
+	indices = reinterpret_cast<const unsigned int*>(data + header.indexOffset);
+	bvhNodes = nodes;
+	bvhNodeCount = header.bvhNodeCount;
+	bvhPrimitives = primitives;
+	bvhPrimitiveCount = header.bvhPrimitiveCount;
+	occluderVertices = reinterpret_cast<const glm::vec3*>(data + header.occluderVertexOffset);
+	occluderIndices = occluderIndexData;
+	return true;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "Bvh.h"
+#include "FileUtil.h"
+#include "Mesh.h"
+
+// Material properties as stored in the model file, independent of any GL objects
+struct MaterialData
+{
+	glm::vec3 ambient;
+	glm::vec3 diffuse;
+	glm::vec3 specular;
+	float shininess;
+	std::vector<std::string> diffuseTextures;   // Texture paths relative to the model directory
+	std::vector<std::string> specularTextures;
+};
+
+// Part of the shared vertex and index arrays that belongs to a single mesh. Indices are relative to firstVertex and
+// hold all levels of detail one after another, the levels' first indices are relative to firstIndex. Bounds are
+// computed at import so loading doesn't have to walk the vertices
+struct MeshRange
+{
+	uint32_t firstVertex;
+	uint32_t vertexCount;
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t materialIndex;
+	Bounds bounds;
+	uint32_t lodCount;
+	MeshLod lods[Mesh::MAX_LODS];
+};
+
+// Simplified geometry of a mesh rasterized by OcclusionCuller, stored in the occluder arrays of the model. A static
+// batch keeps one for every mesh merged into it. Indices are relative to firstVertex
+struct OccluderRange
+{
+	uint32_t firstVertex;
+	uint32_t vertexCount;
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t meshIndex;
+};
+
+// Placement of a mesh within the model. Copies of a prop exported into one file share a mesh and differ only by the
+// rigid transform of their instances. Bounds are those of the placed mesh in model space
+struct MeshInstance
+{
+	glm::mat4 transform;
+	uint32_t meshIndex;
+	Bounds bounds;
+};
+
+// Model geometry flattened into shared arrays with a material table, mesh instances and a hierarchy over their bounds
+struct ModelData
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<MeshRange> meshes;
+	std::vector<MaterialData> materials;
+	std::vector<MeshInstance> instances;
+	std::vector<BvhNode> bvhNodes;
+	std::vector<uint32_t> bvhPrimitives;   // Indices of instances
+	std::vector<glm::vec3> occluderVertices;
+	std::vector<uint32_t> occluderIndices;
+	std::vector<OccluderRange> occluders;
+};
+
+// Cooked binary model file. Vertices are stored already interleaved so the mapped data can be passed straight to GL,
+// the same holds for the mesh hierarchy which is used directly from the mapping. The file is invalidated when hash of
+// the source model or its material libraries changes
+class MeshCache
+{
+public:
+	// Returns path of the cooked file for a source model
+	static std::string getCachePath(const std::string& modelPath);
+	// Hashes model file together with all material libraries it references. Returns 0 if model file can't be read
+	static uint64_t hashSource(const std::string& modelPath);
+	// Writes model data to the cooked file
+	static bool save(const std::string& cachePath, uint64_t sourceHash, const ModelData& data);
+
+	// Maps cooked file. Fails if it's missing, corrupted or was built from a different source (source hash 0 accepts any)
+	bool open(const std::string& cachePath, uint64_t sourceHash);
+	const Vertex* getVertices() const { return vertices; }
+	const unsigned int* getIndices() const { return indices; }
+	const std::vector<MeshRange>& getMeshes() const { return meshes; }
+	const std::vector<MaterialData>& getMaterials() const { return materials; }
+	const std::vector<MeshInstance>& getInstances() const { return instances; }
+	// Instance hierarchy nodes and instance indices within the mapped file, valid as long as the cache is open
+	const BvhNode* getBvhNodes() const { return bvhNodes; }
+	uint32_t getBvhNodeCount() const { return bvhNodeCount; }
+	const uint32_t* getBvhPrimitives() const { return bvhPrimitives; }
+	uint32_t getBvhPrimitiveCount() const { return bvhPrimitiveCount; }
+	// Occluder geometry within the mapped file, valid as long as the cache is open
+	const glm::vec3* getOccluderVertices() const { return occluderVertices; }
+	const uint32_t* getOccluderIndices() const { return occluderIndices; }
+	const std::vector<OccluderRange>& getOccluders() const { return occluders; }
+private:
+	MappedFile file;
+	const Vertex* vertices = nullptr;
+	const unsigned int* indices = nullptr;
+	std::vector<MeshRange> meshes;
+	std::vector<MaterialData> materials;
+	std::vector<MeshInstance> instances;
+	const BvhNode* bvhNodes = nullptr;
+	uint32_t bvhNodeCount = 0;
+	const uint32_t* bvhPrimitives = nullptr;
+	uint32_t bvhPrimitiveCount = 0;
+	const glm::vec3* occluderVertices = nullptr;
+	const uint32_t* occluderIndices = nullptr;
+	std::vector<OccluderRange> occluders;
+};
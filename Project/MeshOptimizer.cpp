@@ -0,0 +1,724 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "FileUtil.h"
+
+namespace
+{
+	const unsigned int VERTEX_CACHE_SIZE = 32;
+	const unsigned int NO_CACHE_POSITION = ~0u;
+
+	// Forsyth's scoring: the last triangle's vertices get a fixed score so the next triangle doesn't just fan around them,
+	// older entries decay with their position and vertices with few remaining triangles get a boost to finish them off
+	float vertexScore(unsigned int cachePosition, unsigned int remainingTriangles)
+	{
+		if (remainingTriangles == 0)
+		{
+			return -1.0f;
+		}
+
+		float score = 0.0f;
+		if (cachePosition < 3)
+		{
+			score = 0.75f;
+		}
+		else if (cachePosition < VERTEX_CACHE_SIZE)
+		{
+			score = std::pow(1.0f - float(cachePosition - 3) / (VERTEX_CACHE_SIZE - 3), 1.5f);
+		}
+		return score + 2.0f / std::sqrt(float(remainingTriangles));
+	}
+
+	struct VertexHasher
+	{
+		size_t operator()(const Vertex& vertex) const { return static_cast<size_t>(FileUtil::hash(&vertex, sizeof(Vertex))); }
+	};
+
+	struct VertexEqual
+	{
+		bool operator()(const Vertex& a, const Vertex& b) const { return memcmp(&a, &b, sizeof(Vertex)) == 0; }
+	};
+
+	struct PositionHasher
+	{
+		size_t operator()(const glm::vec3& position) const { return static_cast<size_t>(FileUtil::hash(&position, sizeof(glm::vec3))); }
+	};
+
+	struct PositionEqual
+	{
+		bool operator()(const glm::vec3& a, const glm::vec3& b) const { return memcmp(&a, &b, sizeof(glm::vec3)) == 0; }
+	};
+
+	// Triangles of a cache cluster and where the cluster faces relative to the mesh center
+	struct Cluster
+	{
+		size_t firstTriangle;
+		size_t triangleCount;
+		float sortKey;
+	};
+
+	// Constraint planes along borders and seams weigh more than surface planes, so moving them is expensive
+	const float BORDER_WEIGHT = 10.0f;
+	// A level of detail must have at most this fraction of the previous level's triangles
+	const float MIN_LOD_REDUCTION = 0.85f;
+	const unsigned int NO_VERTEX = ~0u;
+	// Collapse is rejected when it turns a remaining triangle by more than 60 degrees
+	const float MIN_COLLAPSE_COSINE = 0.5f;
+
+	// Sum of planes a position should stay close to, stored as a symmetric matrix: error(p) = p^T A p + 2 b^T p + c.
+	// Weight is the summed area of the planes, dividing by it turns the error into a squared distance
+	struct Quadric
+	{
+		double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+		double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+		double c = 0.0;
+		double weight = 0.0;
+
+		// Adds plane dot(normal, p) + distance = 0
+		void addPlane(const glm::vec3& normal, float distance, float planeWeight)
+		{
+			double x = normal.x, y = normal.y, z = normal.z, d = distance, w = planeWeight;
+			a00 += w * x * x; a01 += w * x * y; a02 += w * x * z;
+			a11 += w * y * y; a12 += w * y * z; a22 += w * z * z;
+			b0 += w * x * d; b1 += w * y * d; b2 += w * z * d;
+			c += w * d * d;
+			weight += w;
+		}
+
+		void add(const Quadric& quadric)
+		{
+			a00 += quadric.a00; a01 += quadric.a01; a02 += quadric.a02;
+			a11 += quadric.a11; a12 += quadric.a12; a22 += quadric.a22;
+			b0 += quadric.b0; b1 += quadric.b1; b2 += quadric.b2;
+			c += quadric.c;
+			weight += quadric.weight;
+		}
+
+		// Weighted mean of squared distances of the point to the planes
+		float evaluate(const glm::vec3& p) const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			double error = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+				+ 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+			return weight > 0.0 ? static_cast<float>(std::max(error, 0.0) / weight) : 0.0f;
+		}
+	};
+
+	// Edge collapse moving position from onto position to
+	struct Collapse
+	{
+		unsigned int from;
+		unsigned int to;
+		float cost;
+	};
+
+	// Replaces vertices at position from in the triangles around it. Each of them takes the vertex at position to it shares
+	// a triangle with, so vertices split by attributes keep their own side of the split. Fails without changes when
+	// a vertex has no such partner or a remaining triangle would flip
+	bool collapseEdge(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& positions,
+		const unsigned int* triangles, size_t triangleCount, unsigned int from, unsigned int to, std::vector<std::pair<unsigned int, unsigned int>>& wedges)
+	{
+		wedges.clear();
+		for (size_t i = 0; i < triangleCount; ++i)
+		{
+			const unsigned int* triangle = &indices[triangles[i] * 3];
+			unsigned int partner = NO_VERTEX;
+			for (int corner = 0; corner < 3; ++corner)
+			{
+				if (positions[triangle[corner]] == to)
+				{
+					partner = triangle[corner];
+				}
+			}
+			for (int corner = 0; corner < 3; ++corner)
+			{
+				if (positions[triangle[corner]] != from)
+				{
+					continue;
+				}
+				auto wedge = std::find_if(wedges.begin(), wedges.end(), [&](const std::pair<unsigned int, unsigned int>& w) { return w.first == triangle[corner]; });
+				if (wedge == wedges.end())
+				{
+					wedges.push_back({ triangle[corner], partner });
+				}
+				else if (wedge->second == NO_VERTEX)
+				{
+					wedge->second = partner;
+				}
+			}
+		}
+		for (const auto& wedge : wedges)
+		{
+			if (wedge.second == NO_VERTEX)
+			{
+				return false;
+			}
+		}
+
+		// Triangles containing both positions collapse, the rest must keep facing roughly the same way
+		const glm::vec3& target = vertices[to].Position;
+		for (size_t i = 0; i < triangleCount; ++i)
+		{
+			const unsigned int* triangle = &indices[triangles[i] * 3];
+			glm::vec3 corners[3];
+			glm::vec3 movedCorners[3];
+			bool collapsed = false;
+			for (int corner = 0; corner < 3; ++corner)
+			{
+				collapsed = collapsed || positions[triangle[corner]] == to;
+				corners[corner] = vertices[triangle[corner]].Position;
+				movedCorners[corner] = positions[triangle[corner]] == from ? target : corners[corner];
+			}
+			if (collapsed)
+			{
+				continue;
+			}
+			glm::vec3 normal = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+			glm::vec3 movedNormal = glm::cross(movedCorners[1] - movedCorners[0], movedCorners[2] - movedCorners[0]);
+			if (glm::dot(normal, movedNormal) <= MIN_COLLAPSE_COSINE * glm::length(normal) * glm::length(movedNormal))
+			{
+				return false;
+			}
+		}
+
+		for (size_t i = 0; i < triangleCount; ++i)
+		{
+			unsigned int* triangle = &indices[triangles[i] * 3];
+			for (int corner = 0; corner < 3; ++corner)
+			{
+				if (positions[triangle[corner]] == from)
+				{
+					for (const auto& wedge : wedges)
+					{
+						if (wedge.first == triangle[corner])
+						{
+							triangle[corner] = wedge.second;
+							break;
+						}
+					}
+				}
+			}
+		}
+		return true;
+	}
+}
+
+void MeshOptimizer::optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, Statistics* statistics)
+{
+	if (statistics)
+	{
+		statistics->triangles += indices.size() / 3;
+		statistics->sourceVertices += vertices.size();
+		statistics->sourceCacheMisses += countCacheMisses(indices, vertices.size());
+	}
+
+	weldVertices(vertices, indices);
+	optimizeVertexCache(indices, vertices.size());
+	optimizeOverdraw(indices, vertices);
+	optimizeVertexFetch(vertices, indices);
+
+	if (statistics)
+	{
+		statistics->vertices += vertices.size();
+		statistics->cacheMisses += countCacheMisses(indices, vertices.size());
+	}
+}
+
+void MeshOptimizer::weldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	// Maps every vertex to the first vertex with the same data
+	std::unordered_map<Vertex, unsigned int, VertexHasher, VertexEqual> uniqueVertices;
+	uniqueVertices.reserve(vertices.size());
+	std::vector<unsigned int> remap(vertices.size());
+	std::vector<Vertex> weldedVertices;
+	weldedVertices.reserve(vertices.size());
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		auto result = uniqueVertices.emplace(vertices[i], static_cast<unsigned int>(weldedVertices.size()));
+		if (result.second)
+		{
+			weldedVertices.push_back(vertices[i]);
+		}
+		remap[i] = result.first->second;
+	}
+
+	for (auto& index : indices)
+	{
+		index = remap[index];
+	}
+	vertices.swap(weldedVertices);
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// Triangles adjacent to each vertex, stored as one array with per-vertex offsets
+	std::vector<unsigned int> remainingTriangles(vertexCount, 0);
+	for (auto index : indices)
+	{
+		++remainingTriangles[index];
+	}
+	std::vector<size_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t i = 0; i < vertexCount; ++i)
+	{
+		adjacencyOffsets[i + 1] = adjacencyOffsets[i] + remainingTriangles[i];
+	}
+	std::vector<unsigned int> adjacency(indices.size());
+	std::vector<size_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t i = 0; i < indices.size(); ++i)
+	{
+		adjacency[adjacencyFill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+	}
+
+	std::vector<unsigned int> cachePositions(vertexCount, NO_CACHE_POSITION);
+	std::vector<float> vertexScores(vertexCount);
+	for (size_t i = 0; i < vertexCount; ++i)
+	{
+		vertexScores[i] = vertexScore(NO_CACHE_POSITION, remainingTriangles[i]);
+	}
+	std::vector<float> triangleScores(triangleCount);
+	for (size_t i = 0; i < triangleCount; ++i)
+	{
+		triangleScores[i] = vertexScores[indices[i * 3]] + vertexScores[indices[i * 3 + 1]] + vertexScores[indices[i * 3 + 2]];
+	}
+	std::vector<bool> emitted(triangleCount, false);
+
+	std::vector<unsigned int> result;
+	result.reserve(indices.size());
+	// Cache holds three extra entries while a triangle is pushed, those fall out at the end of the step
+	std::vector<unsigned int> cache;
+	std::vector<unsigned int> newCache;
+	cache.reserve(VERTEX_CACHE_SIZE + 3);
+	newCache.reserve(VERTEX_CACHE_SIZE + 3);
+
+	size_t bestTriangle = 0;
+	size_t inputCursor = 0;
+	while (result.size() < indices.size())
+	{
+		// Emit the best triangle and remove it from adjacency of its vertices
+		emitted[bestTriangle] = true;
+		newCache.clear();
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			unsigned int vertex = indices[bestTriangle * 3 + corner];
+			result.push_back(vertex);
+			newCache.push_back(vertex);
+
+			unsigned int* begin = &adjacency[adjacencyOffsets[vertex]];
+			unsigned int* end = begin + remainingTriangles[vertex];
+			*std::find(begin, end, static_cast<unsigned int>(bestTriangle)) = *(end - 1);
+			--remainingTriangles[vertex];
+		}
+		for (auto vertex : cache)
+		{
+			if (std::find(newCache.begin(), newCache.begin() + 3, vertex) == newCache.begin() + 3)
+			{
+				newCache.push_back(vertex);
+			}
+		}
+		cache.swap(newCache);
+
+		// Update scores of everything that moved in the cache, including vertices that were just evicted
+		for (size_t i = 0; i < cache.size(); ++i)
+		{
+			unsigned int vertex = cache[i];
+			cachePositions[vertex] = i < VERTEX_CACHE_SIZE ? static_cast<unsigned int>(i) : NO_CACHE_POSITION;
+			vertexScores[vertex] = vertexScore(cachePositions[vertex], remainingTriangles[vertex]);
+		}
+
+		// Next triangle is the best one touching the cache
+		float bestScore = -1.0f;
+		for (auto vertex : cache)
+		{
+			const unsigned int* begin = &adjacency[adjacencyOffsets[vertex]];
+			for (const unsigned int* triangle = begin; triangle != begin + remainingTriangles[vertex]; ++triangle)
+			{
+				float score = vertexScores[indices[*triangle * 3]] + vertexScores[indices[*triangle * 3 + 1]] + vertexScores[indices[*triangle * 3 + 2]];
+				triangleScores[*triangle] = score;
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestTriangle = *triangle;
+				}
+			}
+		}
+		if (cache.size() > VERTEX_CACHE_SIZE)
+		{
+			cache.resize(VERTEX_CACHE_SIZE);
+		}
+
+		// Cache neighborhood is exhausted, continue with the next triangle in input order. Scanning all triangles for the
+		// best score would make the pass quadratic on large meshes
+		if (bestScore < 0.0f)
+		{
+			while (inputCursor < triangleCount && emitted[inputCursor])
+			{
+				++inputCursor;
+			}
+			bestTriangle = inputCursor;
+		}
+	}
+
+	indices.swap(result);
+}
+
+void MeshOptimizer::optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// A triangle that misses the cache with all three vertices starts a cluster, the cache is cold there anyway
+	std::vector<Cluster> clusters;
+	std::vector<unsigned int> cacheTimes(vertices.size(), 0);
+	unsigned int time = VERTEX_CACHE_SIZE + 1;
+	for (size_t i = 0; i < triangleCount; ++i)
+	{
+		int misses = 0;
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			unsigned int vertex = indices[i * 3 + corner];
+			if (time - cacheTimes[vertex] > VERTEX_CACHE_SIZE)
+			{
+				cacheTimes[vertex] = time++;
+				++misses;
+			}
+		}
+		if (misses == 3 || clusters.empty())
+		{
+			clusters.push_back({ i, 0, 0.0f });
+		}
+		++clusters.back().triangleCount;
+	}
+	if (clusters.size() == 1)
+	{
+		return;
+	}
+
+	glm::vec3 meshCenter(0.0f);
+	for (auto index : indices)
+	{
+		meshCenter += vertices[index].Position;
+	}
+	meshCenter /= float(indices.size());
+
+	// Clusters facing away from the center are on the outside of the mesh and are likely to occlude the rest
+	for (auto& cluster : clusters)
+	{
+		glm::vec3 center(0.0f);
+		glm::vec3 normal(0.0f);
+		for (size_t i = cluster.firstTriangle; i < cluster.firstTriangle + cluster.triangleCount; ++i)
+		{
+			const glm::vec3& a = vertices[indices[i * 3]].Position;
+			const glm::vec3& b = vertices[indices[i * 3 + 1]].Position;
+			const glm::vec3& c = vertices[indices[i * 3 + 2]].Position;
+			center += a + b + c;
+			// Cross product length is twice the area, which weights the average normal by area
+			normal += glm::cross(b - a, c - a);
+		}
+		center /= float(cluster.triangleCount * 3);
+		float normalLength = glm::length(normal);
+		cluster.sortKey = normalLength > 0.0f ? glm::dot(center - meshCenter, normal / normalLength) : 0.0f;
+	}
+	std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+	std::vector<unsigned int> result;
+	result.reserve(indices.size());
+	for (const auto& cluster : clusters)
+	{
+		result.insert(result.end(), indices.begin() + cluster.firstTriangle * 3, indices.begin() + (cluster.firstTriangle + cluster.triangleCount) * 3);
+	}
+	indices.swap(result);
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	std::vector<unsigned int> remap(vertices.size(), NO_CACHE_POSITION);
+	std::vector<Vertex> orderedVertices;
+	orderedVertices.reserve(vertices.size());
+	for (auto& index : indices)
+	{
+		if (remap[index] == NO_CACHE_POSITION)
+		{
+			remap[index] = static_cast<unsigned int>(orderedVertices.size());
+			orderedVertices.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices.swap(orderedVertices);
+}
+
+bool MeshOptimizer::buildOccluder(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, size_t maxTriangles,
+	std::vector<glm::vec3>& occluderVertices, std::vector<unsigned int>& occluderIndices)
+{
+	occluderVertices.clear();
+	occluderIndices.clear();
+
+	// Vertices split by normals or texture coordinates are the same point for depth
+	std::unordered_map<glm::vec3, unsigned int, PositionHasher, PositionEqual> uniquePositions;
+	uniquePositions.reserve(vertices.size());
+	std::vector<unsigned int> remap(vertices.size());
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		auto result = uniquePositions.emplace(vertices[i].Position, static_cast<unsigned int>(occluderVertices.size()));
+		if (result.second)
+		{
+			occluderVertices.push_back(vertices[i].Position);
+		}
+		remap[i] = result.first->second;
+	}
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		unsigned int a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+		glm::vec3 normal = glm::cross(occluderVertices[b] - occluderVertices[a], occluderVertices[c] - occluderVertices[a]);
+		if (a == b || b == c || c == a || glm::dot(normal, normal) == 0.0f)
+		{
+			continue;
+		}
+		occluderIndices.push_back(a);
+		occluderIndices.push_back(b);
+		occluderIndices.push_back(c);
+	}
+
+	if (occluderIndices.empty() || occluderIndices.size() / 3 > maxTriangles)
+	{
+		occluderVertices.clear();
+		occluderIndices.clear();
+		return false;
+	}
+	return true;
+}
+
+float MeshOptimizer::simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, size_t targetIndexCount, float maxError,
+	std::vector<unsigned int>& result)
+{
+	result = indices;
+	size_t vertexCount = vertices.size();
+
+	// Every vertex maps to the first vertex with its position, that one stands for the position in quadrics and collapses
+	std::unordered_map<glm::vec3, unsigned int, PositionHasher, PositionEqual> uniquePositions;
+	uniquePositions.reserve(vertexCount);
+	std::vector<unsigned int> positions(vertexCount);
+	for (size_t i = 0; i < vertexCount; ++i)
+	{
+		positions[i] = uniquePositions.emplace(vertices[i].Position, static_cast<unsigned int>(i)).first->second;
+	}
+
+	// An edge whose reverse isn't used by any triangle is on an open border or on a seam between different attributes
+	std::unordered_set<uint64_t> edges;
+	edges.reserve(indices.size());
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			edges.insert(uint64_t(indices[i + corner]) << 32 | indices[i + (corner + 1) % 3]);
+		}
+	}
+
+	// Surface planes weighted by triangle area, borders and seams get planes through the edge perpendicular to the triangle
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		const glm::vec3& a = vertices[indices[i]].Position;
+		glm::vec3 normal = glm::cross(vertices[indices[i + 1]].Position - a, vertices[indices[i + 2]].Position - a);
+		float length = glm::length(normal);
+		if (length == 0.0f)
+		{
+			continue;
+		}
+		normal /= length;
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			quadrics[positions[indices[i + corner]]].addPlane(normal, -glm::dot(normal, a), length * 0.5f);
+		}
+
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			unsigned int start = indices[i + corner], end = indices[i + (corner + 1) % 3];
+			if (edges.count(uint64_t(end) << 32 | start) != 0)
+			{
+				continue;
+			}
+			glm::vec3 edge = vertices[end].Position - vertices[start].Position;
+			float edgeLength = glm::length(edge);
+			if (edgeLength == 0.0f)
+			{
+				continue;
+			}
+			glm::vec3 borderNormal = glm::cross(edge / edgeLength, normal);
+			float distance = -glm::dot(borderNormal, vertices[start].Position);
+			quadrics[positions[start]].addPlane(borderNormal, distance, edgeLength * edgeLength * BORDER_WEIGHT);
+			quadrics[positions[end]].addPlane(borderNormal, distance, edgeLength * edgeLength * BORDER_WEIGHT);
+		}
+	}
+
+	// Each pass sorts all edges by cost and applies the cheapest collapses that don't touch each other's triangles
+	float maxCost = maxError * maxError;
+	float resultCost = 0.0f;
+	std::vector<size_t> adjacencyOffsets;
+	std::vector<size_t> adjacencyFill;
+	std::vector<unsigned int> adjacency;
+	std::vector<Collapse> collapses;
+	std::vector<uint8_t> locked(vertexCount);
+	std::vector<std::pair<unsigned int, unsigned int>> wedges;
+	while (result.size() > targetIndexCount)
+	{
+		// Triangles around every position
+		adjacencyOffsets.assign(vertexCount + 1, 0);
+		for (auto index : result)
+		{
+			++adjacencyOffsets[positions[index] + 1];
+		}
+		for (size_t i = 0; i < vertexCount; ++i)
+		{
+			adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+		}
+		adjacency.resize(result.size());
+		adjacencyFill.assign(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < result.size(); ++i)
+		{
+			adjacency[adjacencyFill[positions[result[i]]]++] = static_cast<unsigned int>(i / 3);
+		}
+
+		// Merged quadric of both ends is evaluated at either end, the cheaper direction is kept
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (int corner = 0; corner < 3; ++corner)
+			{
+				unsigned int a = positions[result[i + corner]], b = positions[result[i + (corner + 1) % 3]];
+				Quadric quadric = quadrics[a];
+				quadric.add(quadrics[b]);
+				float costToB = quadric.evaluate(vertices[b].Position);
+				float costToA = quadric.evaluate(vertices[a].Position);
+				collapses.push_back(costToB <= costToA ? Collapse{ a, b, costToB } : Collapse{ b, a, costToA });
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+		// Collapse removes two triangles of a closed surface
+		size_t triangleCount = result.size() / 3;
+		size_t remainingCollapses = (triangleCount - targetIndexCount / 3 + 1) / 2;
+		std::fill(locked.begin(), locked.end(), 0);
+		size_t applied = 0;
+		for (const auto& collapse : collapses)
+		{
+			if (collapse.cost > maxCost || applied >= remainingCollapses)
+			{
+				break;
+			}
+			if (locked[collapse.from] || locked[collapse.to])
+			{
+				continue;
+			}
+
+			const unsigned int* triangles = &adjacency[adjacencyOffsets[collapse.from]];
+			size_t count = adjacencyOffsets[collapse.from + 1] - adjacencyOffsets[collapse.from];
+			if (!collapseEdge(result, vertices, positions, triangles, count, collapse.from, collapse.to, wedges))
+			{
+				continue;
+			}
+			quadrics[collapse.to].add(quadrics[collapse.from]);
+			resultCost = std::max(resultCost, collapse.cost);
+			++applied;
+
+			// Triangles around both ends changed, other collapses of this pass must not use them
+			for (auto position : { collapse.from, collapse.to })
+			{
+				for (size_t j = adjacencyOffsets[position]; j < adjacencyOffsets[position + 1]; ++j)
+				{
+					for (int corner = 0; corner < 3; ++corner)
+					{
+						locked[positions[result[adjacency[j] * 3 + corner]]] = 1;
+					}
+				}
+			}
+			locked[collapse.from] = 1;
+		}
+
+		// Drop triangles that lost their area
+		size_t resultSize = 0;
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			unsigned int a = positions[result[i]], b = positions[result[i + 1]], c = positions[result[i + 2]];
+			if (a != b && b != c && c != a)
+			{
+				result[resultSize++] = result[i];
+				result[resultSize++] = result[i + 1];
+				result[resultSize++] = result[i + 2];
+			}
+		}
+		result.resize(resultSize);
+
+		if (applied == 0)
+		{
+			break;
+		}
+	}
+	return std::sqrt(resultCost);
+}
+
+unsigned int MeshOptimizer::generateLods(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, float radius, const LodSettings& settings,
+	MeshLod* lods, Statistics* statistics)
+{
+	std::vector<unsigned int> fullIndices(indices);
+	unsigned int lodCount = 0;
+	lods[lodCount++] = { 0, static_cast<uint32_t>(fullIndices.size()), 0.0f };
+	if (radius <= 0.0f)
+	{
+		return lodCount;
+	}
+
+	// Every level is simplified from the full mesh, so its quadrics measure the error against the original surface
+	std::vector<unsigned int> levelIndices;
+	for (unsigned int i = 0; i < settings.levelCount && lodCount < Mesh::MAX_LODS; ++i)
+	{
+		size_t targetIndexCount = static_cast<size_t>(fullIndices.size() / 3 * settings.triangleRatios[i]) * 3;
+		float error = simplify(vertices, fullIndices, targetIndexCount, settings.maxErrors[i] * radius, levelIndices);
+		const MeshLod& previous = lods[lodCount - 1];
+		if (levelIndices.empty() || levelIndices.size() > previous.indexCount * MIN_LOD_REDUCTION)
+		{
+			continue;
+		}
+
+		optimizeVertexCache(levelIndices, vertices.size());
+		// Coarser levels never report a smaller error, selection relies on that order
+		lods[lodCount++] = { static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(levelIndices.size()), std::max(error / radius, previous.error) };
+		indices.insert(indices.end(), levelIndices.begin(), levelIndices.end());
+		if (statistics)
+		{
+			statistics->lodTriangles += levelIndices.size() / 3;
+		}
+	}
+	return lodCount;
+}
+
+uint64_t MeshOptimizer::countCacheMisses(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize)
+{
+	// Vertex is still in the FIFO if fewer than cacheSize other vertices were pushed since it was
+	std::vector<unsigned int> cacheTimes(vertexCount, 0);
+	unsigned int time = cacheSize + 1;
+	uint64_t misses = 0;
+	for (auto index : indices)
+	{
+		if (time - cacheTimes[index] > cacheSize)
+		{
+			cacheTimes[index] = time++;
+			++misses;
+		}
+	}
+	return misses;
+}
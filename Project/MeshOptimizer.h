@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Mesh.h"
+
+// Import time mesh optimization passes. Each pass works on a single mesh with indices relative to its vertex array
+class MeshOptimizer
+{
+public:
+	// Counters accumulated over all optimized meshes of a model. ACMR (average cache miss ratio) is the number of
+	// vertex shader invocations per triangle for a FIFO post-transform cache, 3 is the worst and ~0.5 the best possible
+	struct Statistics
+	{
+		uint64_t triangles = 0;
+		uint64_t sourceVertices = 0;
+		uint64_t vertices = 0;
+		uint64_t sourceCacheMisses = 0;
+		uint64_t cacheMisses = 0;
+		uint64_t lodTriangles = 0;   // Triangles of all generated levels of detail
+
+		float getSourceACMR() const { return triangles != 0 ? float(sourceCacheMisses) / triangles : 0.0f; }
+		float getACMR() const { return triangles != 0 ? float(cacheMisses) / triangles : 0.0f; }
+	};
+
+	// Levels of detail generated below the full mesh. Level i keeps at most triangleRatios[i] of the full mesh's
+	// triangles and stops simplifying earlier if the error relative to the bounding sphere radius would exceed maxErrors[i].
+	// Levels that don't remove enough triangles to be worth switching to are skipped
+	struct LodSettings
+	{
+		unsigned int levelCount = 3;
+		float triangleRatios[Mesh::MAX_LODS - 1] = { 0.5f, 0.25f, 0.1f };
+		float maxErrors[Mesh::MAX_LODS - 1] = { 0.01f, 0.03f, 0.08f };
+	};
+
+	// Runs all passes in order: weld, vertex cache order, overdraw order, vertex fetch order
+	static void optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, Statistics* statistics = nullptr);
+	// Merges bitwise identical vertices and remaps indices
+	static void weldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+	// Reorders triangles to reuse recently transformed vertices (Forsyth's linear-speed algorithm, tuned for a 32 entry LRU cache)
+	static void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount);
+	// Splits cache optimized triangle order into clusters at cache boundaries and sorts them so that outward facing
+	// clusters are drawn first and occlude the rest. Cache efficiency is kept because clusters start with a cold cache anyway
+	static void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices);
+	// Renumbers vertices in the order the index buffer first uses them so vertex fetch is sequential. Drops unused vertices
+	static void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+	// Builds occluder geometry of the mesh for the CPU depth buffer: positions only, welded by position and without
+	// triangles that collapsed to a line or point. Returns false when it's over the triangle limit, such mesh costs more
+	// to rasterize than it saves
+	static bool buildOccluder(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, size_t maxTriangles,
+		std::vector<glm::vec3>& occluderVertices, std::vector<unsigned int>& occluderIndices);
+	// Collapses edges in the order of the quadric error they introduce until the index count drops to the target or the
+	// cheapest collapse would exceed maxError. Vertices are neither moved nor created, so the result indexes the same
+	// vertex array. Vertices split by normals or texture coordinates move together and open borders and attribute seams
+	// are kept in place by constraint planes. Returns the error of the result as a distance in model units
+	static float simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, size_t targetIndexCount, float maxError,
+		std::vector<unsigned int>& result);
+	// Appends the levels of detail of an optimized mesh to its indices, each ordered for the vertex cache. Fills lods
+	// with the full mesh first and returns their count
+	static unsigned int generateLods(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, float radius, const LodSettings& settings,
+		MeshLod* lods, Statistics* statistics = nullptr);
+	// Counts vertex shader invocations for a FIFO cache of the given size
+	static uint64_t countCacheMisses(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize = 16);
+};
@@ -1,5 +1,6 @@
 #include "Model.h"
 
+#include <cstring>
 #include <iostream>
 
 #include <glad/glad.h>
@@ -7,54 +8,93 @@
 #include <assimp/postprocess.h>
 #include <stb_image/stb_image.h>
 
+#include "FileUtil.h"
+#include "ThreadPool.h"
+
 #define FOURCC_DXT1 0x31545844 // Equivalent to "DXT1" in ASCII
 #define FOURCC_DXT3 0x33545844 // Equivalent to "DXT3" in ASCII
 #define FOURCC_DXT5 0x35545844 // Equivalent to "DXT5" in ASCII
 
-unsigned int Model::loadTextureFromFile(const char *path)
+ImageData::~ImageData()
 {
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
+	stbi_image_free(pixels);
+}
 
-	int width, height, nrComponents;
-	unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-	if (data)
+ImageData::ImageData(ImageData && image) noexcept
+	: width(image.width), height(image.height), components(image.components), pixels(image.pixels),
+	compressedFormat(image.compressedFormat), mipLevels(image.mipLevels), compressedData(std::move(image.compressedData))
+{
+	image.pixels = nullptr;
+}
+
+ImageData & ImageData::operator=(ImageData && image) noexcept
+{
+	if (this == &image)
 	{
-		GLenum format;
-		if (nrComponents == 1)
-		{
-			format = GL_RED;
-		}
-		else if (nrComponents == 3)
-		{
-			format = GL_RGB;
-		}
-		else if (nrComponents == 4)
-		{
-			format = GL_RGBA;
-		}
+		return *this;
+	}
 
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
+	stbi_image_free(pixels);
+	width = image.width;
+	height = image.height;
+	components = image.components;
+	pixels = image.pixels;
+	compressedFormat = image.compressedFormat;
+	mipLevels = image.mipLevels;
+	compressedData = std::move(image.compressedData);
+	image.pixels = nullptr;
+
+	return *this;
+}
 
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+size_t ImageData::getCompressedLevelSize(unsigned int format, int width, int height)
+{
+	size_t blockSize = (format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT) ? 8 : 16;
+	return static_cast<size_t>((width + 3) / 4) * static_cast<size_t>((height + 3) / 4) * blockSize;
+}
 
-		stbi_image_free(data);
+size_t ImageData::getDataSize() const
+{
+	if (compressedFormat != 0)
+	{
+		return compressedData.size();
 	}
-	else
+	return pixels != nullptr ? static_cast<size_t>(width) * height * components : 0;
+}
+
+unsigned int Model::loadTextureFromFile(const char *path)
+{
+	ImageData image;
+	decodeImage(path, image);
+	return createTexture(image);
+}
+
+bool Model::decodeImage(const char * path, ImageData & image)
+{
+	// DDS files are already block compressed
+	size_t length = strlen(path);
+	if (length > 4 && (strcmp(path + length - 4, ".dds") == 0 || strcmp(path + length - 4, ".DDS") == 0))
 	{
-		std::cout << "Texture failed to load at path: " << path << std::endl;
-		stbi_image_free(data);
+		return decodeDDS(path, image);
 	}
 
-	return textureID;
+	// Prefer block compressed version with prebuilt mip chain, unless the source was edited after it was cooked
+	std::string cookedPath = getCookedTexturePath(path);
+	if (FileUtil::isUpToDate(path, cookedPath) && decodeDDS(cookedPath.c_str(), image))
+	{
+		return true;
+	}
+
+	image.pixels = stbi_load(path, &image.width, &image.height, &image.components, 0);
+	if (image.pixels == nullptr)
+	{
+		std::cout << "Texture failed to load at path: " << path << std::endl;
+		return false;
+	}
+	return true;
 }
 
-unsigned int Model::loadDDS(const char * path)
+bool Model::decodeDDS(const char * path, ImageData & image)
 {
 	unsigned char header[124];
 
@@ -63,38 +103,28 @@ unsigned int Model::loadDDS(const char * path)
 	/* try to open the file */
 	fopen_s(&fp, path, "rb");
 	if (fp == nullptr) {
-		printf("%s could not be opened. Are you in the right directory ?\n", path); getchar();
-		return 0;
+		printf("%s could not be opened. Are you in the right directory ?\n", path);
+		return false;
 	}
 
 	/* verify the type of file */
 	char filecode[4];
-	fread(filecode, 1, 4, fp);
-	if (strncmp(filecode, "DDS ", 4) != 0) {
+	if (fread(filecode, 1, 4, fp) != 4 || strncmp(filecode, "DDS ", 4) != 0) {
 		fclose(fp);
-		return 0;
+		return false;
 	}
 
 	/* get the surface desc */
-	fread(&header, 124, 1, fp);
+	if (fread(&header, 124, 1, fp) != 1) {
+		fclose(fp);
+		return false;
+	}
 
 	unsigned int height = *(unsigned int*)&(header[8]);
 	unsigned int width = *(unsigned int*)&(header[12]);
-	unsigned int linearSize = *(unsigned int*)&(header[16]);
 	unsigned int mipMapCount = *(unsigned int*)&(header[24]);
 	unsigned int fourCC = *(unsigned int*)&(header[80]);
 
-
-	unsigned char * buffer;
-	unsigned int bufsize;
-	/* how big is it going to be including all mipmaps? */
-	bufsize = mipMapCount > 1 ? linearSize * 2 : linearSize;
-	buffer = (unsigned char*)malloc(bufsize * sizeof(unsigned char));
-	fread(buffer, 1, bufsize, fp);
-	/* close the file pointer */
-	fclose(fp);
-
-	unsigned int components = (fourCC == FOURCC_DXT1) ? 3 : 4;
 	unsigned int format;
 	switch (fourCC)
 	{
@@ -108,69 +138,208 @@ unsigned int Model::loadDDS(const char * path)
 		format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
 		break;
 	default:
-		free(buffer);
-		return 0;
+		fclose(fp);
+		return false;
 	}
 
-	// Create one OpenGL texture
-	GLuint textureID;
-	glGenTextures(1, &textureID);
-
-	// "Bind" the newly created texture : all future texture functions will modify this texture
-	glBindTexture(GL_TEXTURE_2D, textureID);
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-	unsigned int blockSize = (format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT) ? 8 : 16;
-	unsigned int offset = 0;
+	/* size of the whole mip chain, mip count is 0 when the file has no mipmaps */
+	mipMapCount = mipMapCount == 0 ? 1 : mipMapCount;
+	size_t bufsize = 0;
+	unsigned int levelWidth = width;
+	unsigned int levelHeight = height;
+	for (unsigned int level = 0; level < mipMapCount; ++level)
+	{
+		bufsize += ImageData::getCompressedLevelSize(format, levelWidth, levelHeight);
+		levelWidth = levelWidth > 1 ? levelWidth / 2 : 1;
+		levelHeight = levelHeight > 1 ? levelHeight / 2 : 1;
+	}
 
-	/* load the mipmaps */
-	for (unsigned int level = 0; level < mipMapCount && (width || height); ++level)
+	image.compressedData.resize(bufsize);
+	size_t read = fread(image.compressedData.data(), 1, bufsize, fp);
+	/* close the file pointer */
+	fclose(fp);
+	if (read != bufsize)
 	{
-		unsigned int size = ((width + 3) / 4)*((height + 3) / 4)*blockSize;
-		glCompressedTexImage2D(GL_TEXTURE_2D, level, format, width, height,
-			0, size, buffer + offset);
+		std::cout << "DDS texture " << path << " is truncated" << std::endl;
+		image.compressedData.clear();
+		return false;
+	}
+
+	image.width = width;
+	image.height = height;
+	image.components = (fourCC == FOURCC_DXT1) ? 3 : 4;
+	image.compressedFormat = format;
+	image.mipLevels = mipMapCount;
+	return true;
+}
 
-		offset += size;
-		width /= 2;
-		height /= 2;
+std::string Model::getCookedTexturePath(const std::string & path)
+{
+	return path + ".dds";
+}
 
-		// Deal with Non-Power-Of-Two textures. This code is not included in the webpage to reduce clutter.
-		if (width < 1) width = 1;
-		if (height < 1) height = 1;
+unsigned int Model::createTexture(const ImageData & image)
+{
+	unsigned int textureID;
+	glGenTextures(1, &textureID);
 
+	if (image.isValid())
+	{
+		setTextureImage(textureID, image, image.getData());
 	}
 
-	free(buffer);
-
 	return textureID;
 }
 
-unsigned int Model::loadCubemapTexture(const std::vector<std::string>& faces)
+unsigned int Model::createPlaceholderTexture(unsigned int target)
 {
+	const unsigned char pixel[4] = { 128, 128, 128, 255 };
+
 	unsigned int textureID;
 	glGenTextures(1, &textureID);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-	int width, height, nrChannels;
-	for (unsigned int i = 0; i < faces.size(); i++)
+	glBindTexture(target, textureID);
+	if (target == GL_TEXTURE_CUBE_MAP)
 	{
-		unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-		if (data)
+		for (unsigned int i = 0; i < 6; ++i)
 		{
-			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-			stbi_image_free(data);
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
 		}
-		else
+	}
+	else
+	{
+		glTexImage2D(target, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+	}
+	// Single level, so sampling must not expect mipmaps
+	glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	return textureID;
+}
+
+void Model::setTextureImage(unsigned int textureID, const ImageData & image, const unsigned char * data)
+{
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	uploadImage(GL_TEXTURE_2D, image, data);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+void Model::setCubemapImages(unsigned int textureID, const std::vector<ImageData>& images, const std::vector<const unsigned char*>& data)
+{
+	glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+
+	// Cooked faces come with mip chains, use them only if every face has one
+	bool mipmapped = !images.empty();
+	for (unsigned int i = 0; i < images.size(); i++)
+	{
+		if (images[i].isValid())
 		{
-			std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-			stbi_image_free(data);
+			uploadImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, images[i], data[i]);
 		}
+		mipmapped = mipmapped && images[i].compressedFormat != 0 && images[i].mipLevels == images[0].mipLevels;
+	}
+	if (mipmapped)
+	{
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, images[0].mipLevels - 1);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	}
+	else
+	{
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	}
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+}
+
+void Model::uploadImage(unsigned int target, const ImageData & image, const unsigned char * data)
+{
+	// Rows are tightly packed in both decoded and compressed images
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	if (image.compressedFormat != 0)
+	{
+		int width = image.width;
+		int height = image.height;
+		size_t offset = 0;
+		for (unsigned int level = 0; level < image.mipLevels; ++level)
+		{
+			GLsizei size = static_cast<GLsizei>(ImageData::getCompressedLevelSize(image.compressedFormat, width, height));
+			glCompressedTexImage2D(target, level, image.compressedFormat, width, height, 0, size, data + offset);
+
+			offset += size;
+			width = width > 1 ? width / 2 : 1;
+			height = height > 1 ? height / 2 : 1;
+		}
+
+		// Cooked files contain the full chain, files with a partial chain must not sample missing levels
+		if (target == GL_TEXTURE_2D)
+		{
+			glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, image.mipLevels - 1);
+		}
+		return;
+	}
+
+	GLenum format;
+	if (image.components == 1)
+	{
+		format = GL_RED;
+	}
+	else if (image.components == 3)
+	{
+		format = GL_RGB;
+	}
+	else
+	{
+		format = GL_RGBA;
+	}
+
+	glTexImage2D(target, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, data);
+	if (target == GL_TEXTURE_2D)
+	{
+		// Texture may have been a compressed image or a placeholder before, so restore the full level range
+		glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, 1000);
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
+}
+
+unsigned int Model::loadDDS(const char * path)
+{
+	ImageData image;
+	if (!decodeDDS(path, image))
+	{
+		return 0;
+	}
+	return createTexture(image);
+}
+
+unsigned int Model::loadCubemapTexture(const std::vector<std::string>& faces)
+{
+	// Decode all faces in parallel, only the upload has to happen on the GL thread
+	std::vector<ImageData> images(faces.size());
+	ThreadPool::shared().parallelFor(faces.size(), [&faces, &images](size_t i)
+	{
+		decodeImage(faces[i].c_str(), images[i]);
+	});
+
+	std::vector<const unsigned char*> data;
+	for (unsigned int i = 0; i < faces.size(); i++)
+	{
+		if (!images[i].isValid())
+		{
+			std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
+		}
+		data.push_back(images[i].getData());
+	}
+
+	unsigned int textureID;
+	glGenTextures(1, &textureID);
+	setCubemapImages(textureID, images, data);
 
 	return textureID;
 }
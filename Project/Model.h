@@ -5,6 +5,33 @@
 
 class Shader;
 
+// Image decoded on the CPU, ready to be uploaded to a texture. Owns its pixel data
+struct ImageData
+{
+	int width = 0;
+	int height = 0;
+	int components = 0;
+	unsigned char* pixels = nullptr;
+	// Block compressed images (DDS) keep their whole mip chain in one buffer instead of pixels
+	unsigned int compressedFormat = 0;
+	unsigned int mipLevels = 0;
+	std::vector<unsigned char> compressedData;
+
+	bool isValid() const { return pixels != nullptr || !compressedData.empty(); }
+	// Pixel data of all stored levels and its size in bytes
+	const unsigned char* getData() const { return compressedFormat != 0 ? compressedData.data() : pixels; }
+	size_t getDataSize() const;
+	// Size in bytes of a block compressed mip level
+	static size_t getCompressedLevelSize(unsigned int format, int width, int height);
+
+	ImageData() = default;
+	~ImageData();
+	ImageData(const ImageData& image) = delete;
+	ImageData(ImageData&& image) noexcept;
+	ImageData& operator=(const ImageData& image) = delete;
+	ImageData& operator=(ImageData&& image) noexcept;
+};
+
 // Abstract model class that serves as a base class for all specialized model classes
 class Model
 {
@@ -14,8 +41,27 @@ public:
 	virtual void render(const Shader& shader) const = 0;
 	// Loads texture
 	static unsigned int loadTextureFromFile(const char* texturePath);
+	// Decodes image file, doesn't touch GL so it's safe to call from worker threads.
+	// Cooked DDS version of the image produced by TextureCooker is preferred when it is at least as new as the image
+	static bool decodeImage(const char* path, ImageData& image);
+	// Reads block compressed DXT1/3/5 texture with its whole mip chain
+	static bool decodeDDS(const char* path, ImageData& image);
+	// Returns path of the cooked DDS file for a source image
+	static std::string getCookedTexturePath(const std::string& path);
+	// Creates mipmapped texture from decoded image, must be called on the GL thread
+	static unsigned int createTexture(const ImageData& image);
+	// Creates 1x1 grey 2D texture or cubemap that stands in for a texture until its image is streamed in
+	static unsigned int createPlaceholderTexture(unsigned int target);
+	// Replaces contents of an existing 2D texture. Data points to image pixels in client memory,
+	// or is an offset into the bound pixel unpack buffer
+	static void setTextureImage(unsigned int textureID, const ImageData& image, const unsigned char* data);
+	// Replaces all faces of an existing cubemap, data holds pointer (or unpack buffer offset) for each face
+	static void setCubemapImages(unsigned int textureID, const std::vector<ImageData>& images, const std::vector<const unsigned char*>& data);
 	// Load texture in DDS format
 	static unsigned int loadDDS(const char* path);
 	// Creates cubemap texture from 6 separate textures
 	static unsigned int loadCubemapTexture(const std::vector<std::string>& faces);
+protected:
+	// Uploads all levels of the image to the currently bound texture target (2D texture or a cubemap face)
+	static void uploadImage(unsigned int target, const ImageData& image, const unsigned char* data);
 };
\ No newline at end of file
@@ -1,8 +1,15 @@
 #include "Model3D.h"
 
+#include <algorithm>
+#include <array>
+#include <cfloat>
 #include <fstream>
+#include <iterator>
+#include <map>
 #include <sstream>
 #include <iostream>
+#include <memory>
+#include <unordered_set>
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
@@ -11,34 +18,191 @@
 #include <assimp/postprocess.h>
 #include <stb_image/stb_image.h>
 
-Model3D::Model3D(const std::string& path)
+#include "AssetLoader.h"
+#include "FileUtil.h"
+#include "GeometryBuffer.h"
+#include "ShaderVariants.h"
+#include "TextureCache.h"
+#include "ThreadPool.h"
+
+MeshOptimizer::LodSettings Model3D::lodSettings;
+Model3D::BatchSettings Model3D::batchSettings;
+
+Model3D::Model3D(const std::string& path, bool streamed, VertexFormat vertexFormat, bool alphaTest)
+	: streamed(streamed), vertexFormat(vertexFormat), alphaTest(alphaTest)
 {
 	loadModel(path);
 }
 
 Model3D::~Model3D()
 {
+	// Model may be destroyed before it finished streaming
+	if (streamed)
+	{
+		AssetLoader::shared().cancel(this);
+	}
+
 	for (auto mesh : meshes)
 	{
 		delete mesh;
 	}
 
-	// Delete all loaded textures. Must be done here instead of Mesh otherwise may attempt to delete the same texture several times
-	for (auto& texture : loadedTextures)
+	for (auto material : materials)
+	{
+		delete material;
+	}
+
+	// Release all used textures. Must be done here instead of Mesh otherwise may attempt to release the same texture several times
+	for (auto texture : textures)
 	{	
-		glDeleteTextures(1, &texture.id);
+		TextureCache::release(texture);
+	}
+}
+
+void Model3D::render(const Shader&) const
+{
+	// Models are drawn through submit, which queues their mesh instances in a RenderQueue
+}
+
+void Model3D::submit(RenderQueue & queue, RenderPass pass, ShaderVariants & shaders, unsigned int transform, bool inside) const
+{
+	if (instances == nullptr)
+	{
+		return;
+	}
+
+	// Copies placed away from the model origin get their own transform, only the visible ones are added to the queue
+	meshLods.resize(instances->size(), 0);
+	auto submitInstance = [&](size_t index, bool inside)
+	{
+		const MeshInstance& instance = (*instances)[index];
+		const Mesh& mesh = *meshes[instance.meshIndex];
+		unsigned int instanceTransform = transform;
+		if (instance.transform != glm::mat4())
+		{
+			instanceTransform = queue.addTransform(queue.getTransform(transform) * instance.transform);
+		}
+		meshLods[index] = static_cast<uint8_t>(queue.selectLod(mesh, instanceTransform, meshLods[index]));
+		queue.submit(pass, shaders.get(mesh.getMaterial()->getShaderFeatures()), mesh, instanceTransform, inside, meshLods[index]);
+	};
+
+	if (!loaded)
+	{
+		for (size_t i = 0; i < instances->size(); ++i)
+		{
+			if ((*instances)[i].meshIndex < meshes.size())
+			{
+				submitInstance(i, false);
+			}
+		}
+		return;
+	}
+	if (inside)
+	{
+		for (size_t i = 0; i < instances->size(); ++i)
+		{
+			submitInstance(i, true);
+		}
+		return;
 	}
+
+	// Hierarchy is in model space, so the frustum is brought there instead of transforming every node
+	Frustum frustum = queue.getFrustum().transformed(queue.getTransform(transform));
+	unsigned int visibleInstances = 0;
+	hierarchy.cull(frustum, [&](uint32_t instance, bool inside)
+	{
+		submitInstance(instance, inside);
+		++visibleInstances;
+	});
+	queue.addCulledItems(static_cast<unsigned int>(instances->size()) - visibleInstances);
 }
 
-void Model3D::render(const Shader& shader) const
+void Model3D::setShaderVariants(ShaderVariants * variants)
 {
-	for (unsigned int i = 0; i < meshes.size(); i++)
+	shaderVariants = variants;
+	// Materials created before are issued right away
+	for (const auto material : materials)
 	{
-		meshes[i]->render(shader);
+		shaderVariants->get(material->getShaderFeatures());
+	}
+}
+
+void Model3D::addOccluders(OcclusionCuller & culler, const Frustum & frustum, const glm::mat4 & transform, bool inside) const
+{
+	if (!loaded)
+	{
+		return;
+	}
+
+	// Occluders outside of the view can't hide anything that's drawn
+	Frustum localFrustum = frustum.transformed(transform);
+	float scale = std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+	for (const auto& instance : *instances)
+	{
+		// Copies share the occluder geometry of their mesh
+		for (uint32_t i = meshOccluderOffsets[instance.meshIndex]; i < meshOccluderOffsets[instance.meshIndex + 1]; ++i)
+		{
+			const OccluderRange& occluder = (*occluders)[meshOccluders[i]];
+			Bounds bounds = Mesh::transformBounds(occluderBounds[meshOccluders[i]], instance.transform);
+			if (!inside && !localFrustum.intersects(bounds.sphereCenter, (bounds.max - bounds.min) * 0.5f, bounds.sphereRadius))
+			{
+				continue;
+			}
+			glm::vec3 center = glm::vec3(transform * glm::vec4(bounds.sphereCenter, 1.0f));
+			culler.addOccluder(occluderVertices + occluder.firstVertex, occluderIndices + occluder.firstIndex, occluder.indexCount,
+				transform * instance.transform, center, bounds.sphereRadius * scale);
+		}
 	}
 }
 
 void Model3D::loadModel(std::string const &path)
+{
+	// retrieve the directory path of the filepath
+	directory = path.substr(0, path.find_last_of('/'));
+
+	source = std::make_shared<ModelSource>();
+	if (streamed)
+	{
+		auto modelSource = source;
+		AssetLoader::shared().submit(this, [path, modelSource]() { readModel(path, *modelSource); }, [this, modelSource]() { return createMeshes(*modelSource); });
+		return;
+	}
+
+	readModel(path, *source);
+	createMeshes(*source);
+}
+
+void Model3D::readModel(const std::string & path, ModelSource & source)
+{
+	// Use cooked mesh file if it was built from the current version of the source files
+	std::string cachePath = MeshCache::getCachePath(path);
+	uint64_t sourceHash = MeshCache::hashSource(path);
+	// Levels of detail and batches are part of the cooked file, other settings need a new one
+	if (sourceHash != 0)
+	{
+		sourceHash = FileUtil::hash(&lodSettings, sizeof(lodSettings), sourceHash);
+		sourceHash = std::max<uint64_t>(FileUtil::hash(&batchSettings, sizeof(batchSettings), sourceHash), 1);
+	}
+	if (source.cache.open(cachePath, sourceHash))
+	{
+		source.cached = true;
+		source.loaded = true;
+		return;
+	}
+
+	// Otherwise import the source file and cook it for the next launch
+	if (!importModel(path, source.data))
+	{
+		return;
+	}
+	if (!MeshCache::save(cachePath, sourceHash, source.data))
+	{
+		std::cout << "Unable to write mesh cache " << cachePath << std::endl;
+	}
+	source.loaded = true;
+}
+
+bool Model3D::importModel(const std::string& path, ModelData& data)
 {
 	// read file via ASSIMP
 	Assimp::Importer importer;
@@ -47,16 +211,52 @@ void Model3D::loadModel(std::string const &path)
 	if (!scenes || scenes->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scenes->mRootNode) // if is Not Zero
 	{
 		std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
-		return;
+		return false;
+	}
+
+	// Whole material table is stored, meshes reference it by index
+	for (unsigned int i = 0; i < scenes->mNumMaterials; ++i)
+	{
+		data.materials.push_back(processMaterial(scenes->mMaterials[i]));
 	}
-	// retrieve the directory path of the filepath
-	directory = path.substr(0, path.find_last_of('/'));
 
 	// process ASSIMP's root node recursively
-	processNode(scenes->mRootNode, scenes);
+	ImportState state;
+	processNode(scenes->mRootNode, scenes, state);
+	size_t sourceDraws = state.instances.size();
+	batchMeshes(state);
+
+	for (auto& mesh : state.sourceMeshes)
+	{
+		appendMesh(mesh, data, state.statistics);
+		mesh = SourceMesh();
+	}
+	for (const auto& instance : state.instances)
+	{
+		addInstance(data, instance.meshIndex, instance.transform);
+	}
+
+	// Hierarchy over instance bounds is stored with the model, so it's built only once
+	std::vector<Bounds> instanceBounds;
+	instanceBounds.reserve(data.instances.size());
+	for (const auto& instance : data.instances)
+	{
+		instanceBounds.push_back(instance.bounds);
+	}
+	Bvh hierarchy;
+	hierarchy.build(instanceBounds.data(), instanceBounds.size());
+	data.bvhNodes.assign(hierarchy.getNodes(), hierarchy.getNodes() + hierarchy.getNodeCount());
+	data.bvhPrimitives.assign(hierarchy.getPrimitives(), hierarchy.getPrimitives() + hierarchy.getPrimitiveCount());
+	const MeshOptimizer::Statistics& statistics = state.statistics;
+	std::cout << "Optimized " << path << ": " << statistics.triangles << " triangles, " << statistics.sourceVertices << " -> " << statistics.vertices
+		<< " vertices, ACMR " << statistics.getSourceACMR() << " -> " << statistics.getACMR() << ", " << statistics.lodTriangles << " LOD triangles, "
+		<< data.meshes.size() << " meshes in " << data.instances.size() << " instances" << std::endl;
+	std::cout << "Static batching of " << path << " with cell size " << batchSettings.cellSize << ": " << sourceDraws << " -> " << data.instances.size()
+		<< " draws" << std::endl;
+	return true;
 }
 
-void Model3D::processNode(aiNode *node, const aiScene *scenes)
+void Model3D::processNode(aiNode *node, const aiScene *scenes, ImportState& state)
 {
 	// process each mesh located at the current node
 	for (unsigned int i = 0; i < node->mNumMeshes; ++i)
@@ -64,45 +264,53 @@ void Model3D::processNode(aiNode *node, const aiScene *scenes)
 		// the node object only contains indices to index the actual objects in the scene. 
 		// the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
 		aiMesh* mesh = scenes->mMeshes[node->mMeshes[i]];
-		meshes.push_back(processMesh(mesh, scenes));
+		processMesh(mesh, state);
 	}
 	// after we've processed all of the meshes (if any) we then recursively process each of the children nodes
 	for (unsigned int i = 0; i < node->mNumChildren; ++i)
 	{
-		processNode(node->mChildren[i], scenes);
+		processNode(node->mChildren[i], scenes, state);
 	}
 
 }
 
-Mesh* Model3D::processMesh(aiMesh *mesh, const aiScene *scenes)
+void Model3D::processMesh(aiMesh *mesh, ImportState& state)
 {
-	std::vector<Vertex> vertices;
-	std::vector<unsigned int> indices;
+	// Scenes exported with transforms applied repeat the same prop many times, its copies only add a placement
+	uint64_t shapeHash = hashMeshShape(*mesh);
+	auto candidates = state.meshes.equal_range(shapeHash);
+	for (auto candidate = candidates.first; candidate != candidates.second; ++candidate)
+	{
+		glm::mat4 transform;
+		if (findRigidTransform(*candidate->second.first, *mesh, transform))
+		{
+			state.instances.push_back({ transform, candidate->second.second, Bounds() });
+			return;
+		}
+	}
+	uint32_t meshIndex = static_cast<uint32_t>(state.sourceMeshes.size());
+	state.meshes.emplace(shapeHash, std::make_pair(mesh, meshIndex));
+	state.instances.push_back({ glm::mat4(), meshIndex, Bounds() });
+	state.sourceMeshes.push_back(SourceMesh());
+	SourceMesh& sourceMesh = state.sourceMeshes.back();
+	std::vector<Vertex>& vertices = sourceMesh.vertices;
+	std::vector<unsigned int>& indices = sourceMesh.indices;
 
 	// Walk through each of the mesh's vertices
+	vertices.reserve(mesh->mNumVertices);
 	for (unsigned int i = 0; i < mesh->mNumVertices; ++i)
 	{
 		Vertex vertex;
-		glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
 		// Positions
-		vector.x = mesh->mVertices[i].x;
-		vector.y = mesh->mVertices[i].y;
-		vector.z = mesh->mVertices[i].z;
-		vertex.Position = vector;
+		vertex.Position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
 		// Normals
-		vector.x = mesh->mNormals[i].x;
-		vector.y = mesh->mNormals[i].y;
-		vector.z = mesh->mNormals[i].z;
-		vertex.Normal = vector;
+		vertex.Normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
 		// Texture coordinates
 		if (mesh->mTextureCoords[0]) // Does the mesh contain texture coordinates?
 		{
-			glm::vec2 vec;
 			// a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't 
 			// use models where a vertex can have multiple texture coordinates so we always take the first set (0).
-			vec.x = mesh->mTextureCoords[0][i].x;
-			vec.y = mesh->mTextureCoords[0][i].y;
-			vertex.TexCoords = vec;
+			vertex.TexCoords = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
 		}
 		else
 		{
@@ -115,7 +323,12 @@ Mesh* Model3D::processMesh(aiMesh *mesh, const aiScene *scenes)
 	// now walk through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
 	for (unsigned int i = 0; i < mesh->mNumFaces; ++i)
 	{
-		aiFace face = mesh->mFaces[i];
+		const aiFace& face = mesh->mFaces[i];
+		// Triangulation leaves points and lines of the source as they are, those can't be drawn as triangles
+		if (face.mNumIndices != 3)
+		{
+			continue;
+		}
 		// retrieve all indices of the face and store them in the indices vector
 		for (unsigned int j = 0; j < face.mNumIndices; ++j)
 		{
@@ -123,28 +336,445 @@ Mesh* Model3D::processMesh(aiMesh *mesh, const aiScene *scenes)
 		}
 	}
 
-	// Process materials
-	aiMaterial* material = scenes->mMaterials[mesh->mMaterialIndex];
-	Material mat = loadMaterial(material);	
-	// Return a mesh object created from the extracted mesh data
-	return new Mesh(vertices, indices, mat);
+	sourceMesh.materialIndex = mesh->mMaterialIndex;
+	sourceMesh.bounds = Mesh::computeBounds(vertices.data(), static_cast<unsigned int>(vertices.size()));
+	// Occluders are built before batching, a batch of small occluders would be over the triangle limit together
+	SourceOccluder occluder;
+	if (sourceMesh.bounds.sphereRadius >= MIN_OCCLUDER_RADIUS
+		&& MeshOptimizer::buildOccluder(vertices, indices, MAX_OCCLUDER_TRIANGLES, occluder.vertices, occluder.indices))
+	{
+		sourceMesh.occluders.push_back(std::move(occluder));
+	}
 }
 
-Material Model3D::loadMaterial(aiMaterial * mat)
+void Model3D::batchMeshes(ImportState & state)
 {
+	if (batchSettings.cellSize <= 0.0f)
+	{
+		return;
+	}
+
+	// Meshes with copies are drawn instanced, batching would duplicate their geometry
+	std::vector<unsigned int> instanceCounts(state.sourceMeshes.size(), 0);
+	for (const auto& instance : state.instances)
+	{
+		++instanceCounts[instance.meshIndex];
+	}
+
+	// Cells are ordered by material and position, so the same source always gives the same batches
+	std::map<std::array<int, 4>, std::vector<uint32_t>> cells;
+	for (uint32_t i = 0; i < state.sourceMeshes.size(); ++i)
+	{
+		const SourceMesh& mesh = state.sourceMeshes[i];
+		if (instanceCounts[i] != 1 || mesh.vertices.size() > batchSettings.maxVertices || glm::length(mesh.bounds.max - mesh.bounds.min) > batchSettings.cellSize)
+		{
+			continue;
+		}
+		glm::ivec3 cell = glm::ivec3(glm::floor(mesh.bounds.sphereCenter / batchSettings.cellSize));
+		cells[{ { static_cast<int>(mesh.materialIndex), cell.x, cell.y, cell.z } }].push_back(i);
+	}
+
+	// Meshes that stay on their own keep their order, batches follow them
+	const uint32_t notBatched = ~0u;
+	std::vector<uint32_t> batchOf(state.sourceMeshes.size(), notBatched);
+	std::vector<SourceMesh> batches;
+	for (const auto& cell : cells)
+	{
+		if (cell.second.size() < 2)
+		{
+			continue;
+		}
+		size_t firstBatch = batches.size();
+		for (uint32_t meshIndex : cell.second)
+		{
+			SourceMesh& mesh = state.sourceMeshes[meshIndex];
+			if (batches.size() == firstBatch || batches.back().vertices.size() + mesh.vertices.size() > batchSettings.maxVertices)
+			{
+				batches.push_back(SourceMesh());
+				batches.back().materialIndex = mesh.materialIndex;
+			}
+			SourceMesh& batch = batches.back();
+			unsigned int baseVertex = static_cast<unsigned int>(batch.vertices.size());
+			batch.vertices.insert(batch.vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+			for (unsigned int index : mesh.indices)
+			{
+				batch.indices.push_back(baseVertex + index);
+			}
+			std::move(mesh.occluders.begin(), mesh.occluders.end(), std::back_inserter(batch.occluders));
+			batchOf[meshIndex] = static_cast<uint32_t>(batches.size() - 1);
+		}
+	}
+	if (batches.empty())
+	{
+		return;
+	}
+
+	std::vector<SourceMesh> meshes;
+	std::vector<uint32_t> remap(state.sourceMeshes.size());
+	for (uint32_t i = 0; i < state.sourceMeshes.size(); ++i)
+	{
+		if (batchOf[i] == notBatched)
+		{
+			remap[i] = static_cast<uint32_t>(meshes.size());
+			meshes.push_back(std::move(state.sourceMeshes[i]));
+		}
+	}
+	std::vector<MeshInstance> instances;
+	for (const auto& instance : state.instances)
+	{
+		if (batchOf[instance.meshIndex] == notBatched)
+		{
+			instances.push_back({ instance.transform, remap[instance.meshIndex], Bounds() });
+		}
+	}
+	// Batched meshes were placed once at the origin, so their geometry is already in model space
+	for (auto& batch : batches)
+	{
+		instances.push_back({ glm::mat4(), static_cast<uint32_t>(meshes.size()), Bounds() });
+		batch.bounds = Mesh::computeBounds(batch.vertices.data(), static_cast<unsigned int>(batch.vertices.size()));
+		meshes.push_back(std::move(batch));
+	}
+	state.sourceMeshes.swap(meshes);
+	state.instances.swap(instances);
+}
+
+void Model3D::appendMesh(SourceMesh & mesh, ModelData & data, MeshOptimizer::Statistics & statistics)
+{
+	std::vector<Vertex>& vertices = mesh.vertices;
+	std::vector<unsigned int>& indices = mesh.indices;
+	MeshOptimizer::optimize(vertices, indices, &statistics);
+
+	Bounds bounds = Mesh::computeBounds(vertices.data(), static_cast<unsigned int>(vertices.size()));
+	uint32_t meshIndex = static_cast<uint32_t>(data.meshes.size());
+	for (const auto& sourceOccluder : mesh.occluders)
+	{
+		OccluderRange occluder;
+		occluder.firstVertex = static_cast<uint32_t>(data.occluderVertices.size());
+		occluder.vertexCount = static_cast<uint32_t>(sourceOccluder.vertices.size());
+		occluder.firstIndex = static_cast<uint32_t>(data.occluderIndices.size());
+		occluder.indexCount = static_cast<uint32_t>(sourceOccluder.indices.size());
+		occluder.meshIndex = meshIndex;
+		data.occluderVertices.insert(data.occluderVertices.end(), sourceOccluder.vertices.begin(), sourceOccluder.vertices.end());
+		data.occluderIndices.insert(data.occluderIndices.end(), sourceOccluder.indices.begin(), sourceOccluder.indices.end());
+		data.occluders.push_back(occluder);
+	}
+
+	// Levels of detail are appended to the indices, occluders are built from the full mesh before
+	MeshRange range = {};
+	range.lodCount = MeshOptimizer::generateLods(vertices, indices, bounds.sphereRadius, lodSettings, range.lods, &statistics);
+	range.firstVertex = static_cast<uint32_t>(data.vertices.size());
+	range.vertexCount = static_cast<uint32_t>(vertices.size());
+	range.firstIndex = static_cast<uint32_t>(data.indices.size());
+	range.indexCount = static_cast<uint32_t>(indices.size());
+	range.materialIndex = mesh.materialIndex;
+	range.bounds = bounds;
+	data.vertices.insert(data.vertices.end(), vertices.begin(), vertices.end());
+	data.indices.insert(data.indices.end(), indices.begin(), indices.end());
+	data.meshes.push_back(range);
+}
+
+uint64_t Model3D::hashMeshShape(const aiMesh & mesh)
+{
+	uint64_t hash = FileUtil::hash(&mesh.mMaterialIndex, sizeof(mesh.mMaterialIndex));
+	hash = FileUtil::hash(&mesh.mNumVertices, sizeof(mesh.mNumVertices), hash);
+	for (unsigned int i = 0; i < mesh.mNumFaces; ++i)
+	{
+		const aiFace& face = mesh.mFaces[i];
+		hash = FileUtil::hash(face.mIndices, face.mNumIndices * sizeof(unsigned int), hash);
+	}
+	if (mesh.mTextureCoords[0])
+	{
+		hash = FileUtil::hash(mesh.mTextureCoords[0], mesh.mNumVertices * sizeof(aiVector3D), hash);
+	}
+	return hash;
+}
+
+bool Model3D::findRigidTransform(const aiMesh & source, const aiMesh & copy, glm::mat4 & transform)
+{
+	if (source.mMaterialIndex != copy.mMaterialIndex || source.mNumVertices != copy.mNumVertices || source.mNumFaces != copy.mNumFaces
+		|| (source.mTextureCoords[0] == nullptr) != (copy.mTextureCoords[0] == nullptr) || source.mNumVertices == 0)
+	{
+		return false;
+	}
+	for (unsigned int i = 0; i < source.mNumFaces; ++i)
+	{
+		const aiFace& a = source.mFaces[i];
+		const aiFace& b = copy.mFaces[i];
+		if (a.mNumIndices != b.mNumIndices || !std::equal(a.mIndices, a.mIndices + a.mNumIndices, b.mIndices))
+		{
+			return false;
+		}
+	}
+	if (source.mTextureCoords[0] && !std::equal(source.mTextureCoords[0], source.mTextureCoords[0] + source.mNumVertices, copy.mTextureCoords[0]))
+	{
+		return false;
+	}
+
+	auto position = [](const aiMesh& mesh, unsigned int i) { return glm::vec3(mesh.mVertices[i].x, mesh.mVertices[i].y, mesh.mVertices[i].z); };
+	glm::vec3 sourceCenter(0.0f), copyCenter(0.0f);
+	for (unsigned int i = 0; i < source.mNumVertices; ++i)
+	{
+		sourceCenter += position(source, i);
+		copyCenter += position(copy, i);
+	}
+	sourceCenter /= static_cast<float>(source.mNumVertices);
+	copyCenter /= static_cast<float>(source.mNumVertices);
+
+	// Two vertices far from the center and from each other's direction span a frame that is stable to rounding, the same
+	// frame on the copy gives the rotation
+	unsigned int first = 0;
+	float firstDistance = 0.0f;
+	for (unsigned int i = 0; i < source.mNumVertices; ++i)
+	{
+		float distance = glm::length(position(source, i) - sourceCenter);
+		if (distance > firstDistance)
+		{
+			first = i;
+			firstDistance = distance;
+		}
+	}
+	glm::vec3 firstAxis = position(source, first) - sourceCenter;
+	unsigned int second = 0;
+	float secondArea = 0.0f;
+	for (unsigned int i = 0; i < source.mNumVertices; ++i)
+	{
+		float area = glm::length(glm::cross(firstAxis, position(source, i) - sourceCenter));
+		if (area > secondArea)
+		{
+			second = i;
+			secondArea = area;
+		}
+	}
+	float tolerance = INSTANCE_TOLERANCE * firstDistance;
+	// Flat or tiny meshes have no stable frame, they aren't worth sharing anyway
+	if (firstDistance <= 0.0f || secondArea <= tolerance * firstDistance)
+	{
+		return false;
+	}
+
+	auto frame = [](const glm::vec3& u, const glm::vec3& v)
+	{
+		glm::vec3 x = glm::normalize(u);
+		glm::vec3 z = glm::normalize(glm::cross(u, v));
+		return glm::mat3(x, glm::cross(z, x), z);
+	};
+	glm::mat3 sourceFrame = frame(firstAxis, position(source, second) - sourceCenter);
+	glm::mat3 copyFrame = frame(position(copy, first) - copyCenter, position(copy, second) - copyCenter);
+	glm::mat3 rotation = copyFrame * glm::transpose(sourceFrame);
+	glm::vec3 translation = copyCenter - rotation * sourceCenter;
+
+	// Frame only fits two vertices, every vertex and normal must follow it
+	for (unsigned int i = 0; i < source.mNumVertices; ++i)
+	{
+		if (glm::length(rotation * position(source, i) + translation - position(copy, i)) > tolerance)
+		{
+			return false;
+		}
+		if (source.mNormals && copy.mNormals)
+		{
+			glm::vec3 sourceNormal(source.mNormals[i].x, source.mNormals[i].y, source.mNormals[i].z);
+			glm::vec3 copyNormal(copy.mNormals[i].x, copy.mNormals[i].y, copy.mNormals[i].z);
+			if (glm::length(rotation * sourceNormal - copyNormal) > INSTANCE_NORMAL_TOLERANCE)
+			{
+				return false;
+			}
+		}
+	}
+
+	transform = glm::mat4(rotation);
+	transform[3] = glm::vec4(translation, 1.0f);
+	return true;
+}
+
+void Model3D::addInstance(ModelData & data, uint32_t meshIndex, const glm::mat4 & transform)
+{
+	MeshInstance instance;
+	instance.transform = transform;
+	instance.meshIndex = meshIndex;
+	instance.bounds = Mesh::transformBounds(data.meshes[meshIndex].bounds, transform);
+	data.instances.push_back(instance);
+}
+
+MaterialData Model3D::processMaterial(aiMaterial * mat)
+{
+	MaterialData data;
 	// Extract shininess
 	float shininess = 0;
 	aiGetMaterialFloat(mat, AI_MATKEY_SHININESS, &shininess);
-	shininess = (shininess < 1.0f) ? 1.0f : shininess;
+	data.shininess = (shininess < 1.0f) ? 1.0f : shininess;
 	// Extract ambient color
 	aiColor3D ambientColor(0.f, 0.f, 0.f);
 	mat->Get(AI_MATKEY_COLOR_AMBIENT, ambientColor);
+	data.ambient = vec3(ambientColor.r, ambientColor.g, ambientColor.b);
 	// Extract diffuse color
 	aiColor3D diffColor(0.f, 0.f, 0.f);
 	mat->Get(AI_MATKEY_COLOR_DIFFUSE, diffColor);
+	data.diffuse = vec3(diffColor.r, diffColor.g, diffColor.b);
 	// Extract specular color
 	aiColor3D specColor(0.f, 0.f, 0.f);
 	mat->Get(AI_MATKEY_COLOR_SPECULAR, specColor);
+	data.specular = vec3(specColor.r, specColor.g, specColor.b);
+	// Extract texture paths
+	for (unsigned int i = 0; i < mat->GetTextureCount(aiTextureType_DIFFUSE); i++)
+	{
+		aiString str;
+		mat->GetTexture(aiTextureType_DIFFUSE, i, &str);
+		data.diffuseTextures.push_back(str.C_Str());
+	}
+	for (unsigned int i = 0; i < mat->GetTextureCount(aiTextureType_SPECULAR); i++)
+	{
+		aiString str;
+		mat->GetTexture(aiTextureType_SPECULAR, i, &str);
+		data.specularTextures.push_back(str.C_Str());
+	}
+	return data;
+}
+
+bool Model3D::createMeshes(ModelSource & source)
+{
+	if (!source.loaded)
+	{
+		return true;
+	}
+	instances = source.cached ? &source.cache.getInstances() : &source.data.instances;
+	if (source.cached)
+	{
+		if (!createMeshes(source.cache.getVertices(), source.cache.getIndices(), source.cache.getMeshes(), source.cache.getMaterials()))
+		{
+			return false;
+		}
+		hierarchy.attach(source.cache.getBvhNodes(), source.cache.getBvhNodeCount(), source.cache.getBvhPrimitives(), source.cache.getBvhPrimitiveCount());
+		occluderVertices = source.cache.getOccluderVertices();
+		occluderIndices = source.cache.getOccluderIndices();
+		occluders = &source.cache.getOccluders();
+	}
+	else
+	{
+		if (!createMeshes(source.data.vertices.data(), source.data.indices.data(), source.data.meshes, source.data.materials))
+		{
+			return false;
+		}
+		hierarchy.attach(source.data.bvhNodes.data(), static_cast<uint32_t>(source.data.bvhNodes.size()), source.data.bvhPrimitives.data(),
+			static_cast<uint32_t>(source.data.bvhPrimitives.size()));
+		occluderVertices = source.data.occluderVertices.data();
+		occluderIndices = source.data.occluderIndices.data();
+		occluders = &source.data.occluders;
+		std::vector<Vertex>().swap(source.data.vertices);
+		std::vector<unsigned int>().swap(source.data.indices);
+	}
+	// Group occluders by their mesh and measure each of them
+	meshOccluderOffsets.assign(meshes.size() + 1, 0);
+	for (const auto& occluder : *occluders)
+	{
+		++meshOccluderOffsets[occluder.meshIndex + 1];
+	}
+	for (size_t i = 1; i < meshOccluderOffsets.size(); ++i)
+	{
+		meshOccluderOffsets[i] += meshOccluderOffsets[i - 1];
+	}
+	std::vector<uint32_t> nextOccluder(meshOccluderOffsets.begin(), meshOccluderOffsets.end() - 1);
+	meshOccluders.resize(occluders->size());
+	occluderBounds.resize(occluders->size());
+	for (uint32_t i = 0; i < occluders->size(); ++i)
+	{
+		const OccluderRange& occluder = (*occluders)[i];
+		meshOccluders[nextOccluder[occluder.meshIndex]++] = i;
+		Bounds& bounds = occluderBounds[i];
+		bounds.min = glm::vec3(FLT_MAX);
+		bounds.max = glm::vec3(-FLT_MAX);
+		for (uint32_t j = 0; j < occluder.vertexCount; ++j)
+		{
+			bounds.min = glm::min(bounds.min, occluderVertices[occluder.firstVertex + j]);
+			bounds.max = glm::max(bounds.max, occluderVertices[occluder.firstVertex + j]);
+		}
+		bounds.sphereCenter = (bounds.min + bounds.max) * 0.5f;
+		bounds.sphereRadius = 0.0f;
+		for (uint32_t j = 0; j < occluder.vertexCount; ++j)
+		{
+			bounds.sphereRadius = std::max(bounds.sphereRadius, glm::length(occluderVertices[occluder.firstVertex + j] - bounds.sphereCenter));
+		}
+	}
+	loaded = !meshes.empty();
+	return true;
+}
+
+bool Model3D::createMeshes(const Vertex* vertices, const unsigned int* indices, const std::vector<MeshRange>& ranges, const std::vector<MaterialData>& materialTable)
+{
+	if (materials.empty())
+	{
+		loadTextures(materialTable);
+		for (const auto& materialData : materialTable)
+		{
+			materials.push_back(loadMaterial(materialData));
+			if (shaderVariants != nullptr)
+			{
+				shaderVariants->get(materials.back()->getShaderFeatures());
+			}
+		}
+		meshes.reserve(ranges.size());
+	}
+
+	// Continue from the first mesh not created yet
+	while (meshes.size() < ranges.size())
+	{
+		const MeshRange& range = ranges[meshes.size()];
+		meshes.push_back(new Mesh(vertices + range.firstVertex, range.vertexCount, indices + range.firstIndex, range.indexCount, materials[range.materialIndex], range.bounds,
+			vertexFormat, range.lods, range.lodCount));
+		if (streamed && meshes.size() < ranges.size() && AssetLoader::shared().isOverBudget())
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void Model3D::loadTextures(const std::vector<MaterialData>& materialTable)
+{
+	// Gather unique paths of all textures, acquire the ones already loaded by any model and collect the rest
+	std::unordered_set<std::string> uniquePaths;
+	std::vector<std::string> paths;
+	auto addPath = [this, &uniquePaths, &paths](const std::string& path)
+	{
+		std::string filePath = TextureCache::canonicalPath(directory + "/" + path);
+		if (!uniquePaths.insert(filePath).second)
+		{
+			return;
+		}
+
+		unsigned int texture = streamed ? AssetLoader::shared().requestTexture(filePath) : TextureCache::acquire(filePath);
+		if (texture != 0)
+		{
+			textures.push_back(texture);
+		}
+		else
+		{
+			paths.push_back(filePath);
+		}
+	};
+	for (const auto& material : materialTable)
+	{
+		std::for_each(material.diffuseTextures.begin(), material.diffuseTextures.end(), addPath);
+		std::for_each(material.specularTextures.begin(), material.specularTextures.end(), addPath);
+	}
+
+	// Decode on all cores
+	std::vector<ImageData> images(paths.size());
+	ThreadPool::shared().parallelFor(paths.size(), [&paths, &images](size_t i)
+	{
+		decodeImage(paths[i].c_str(), images[i]);
+	});
+
+	// Upload on the GL thread
+	for (size_t i = 0; i < paths.size(); ++i)
+	{
+		unsigned int texture = createTexture(images[i]);
+		TextureCache::insert(paths[i], texture);
+		textures.push_back(texture);
+	}
+}
+
+Material* Model3D::loadMaterial(const MaterialData& data)
+{
 	// Extract textures
 	std::vector<Texture> textures;
 	// Assume a convention for sampler names in the shaders. Each diffuse texture should be named
@@ -153,45 +783,26 @@ Material Model3D::loadMaterial(aiMaterial * mat)
 	// diffuse: texture_diffuseN
 	// specular: texture_specularN
 	// Diffuse maps
-	std::vector<Texture> diffuseMaps = loadMaterialTextures(mat, aiTextureType_DIFFUSE, "texture_diffuse");
+	std::vector<Texture> diffuseMaps = loadMaterialTextures(data.diffuseTextures, "texture_diffuse");
 	textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
 	// Specular maps
-	std::vector<Texture> specularMaps = loadMaterialTextures(mat, aiTextureType_SPECULAR, "texture_specular");
+	std::vector<Texture> specularMaps = loadMaterialTextures(data.specularTextures, "texture_specular");
 	textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
 	// Return material object created from extracted data
-	return Material(textures, vec3(ambientColor.r, ambientColor.g, ambientColor.b), vec3(diffColor.r, diffColor.g, diffColor.b),
-		vec3(specColor.r, specColor.g, specColor.b), shininess);
+	return new Material(textures, data.ambient, data.diffuse, data.specular, data.shininess, alphaTest);
 }
 
-std::vector<Texture> Model3D::loadMaterialTextures(aiMaterial *mat, aiTextureType type, std::string typeName)
+std::vector<Texture> Model3D::loadMaterialTextures(const std::vector<std::string>& paths, std::string typeName)
 {
-	std::vector<Texture> textures;
-	for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+	std::vector<Texture> materialTextures;
+	for (const auto& path : paths)
 	{
-		aiString str;
-		mat->GetTexture(type, i, &str);
-		// check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-		bool skip = false;
-		for (unsigned int j = 0; j < loadedTextures.size(); j++)
-		{
-			if (std::strcmp(loadedTextures[j].path.data(), str.C_Str()) == 0)
-			{
-				textures.push_back(loadedTextures[j]);
-				skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-				break;
-			}
-		}
-		// If texture hasn't been loaded already, load it
-		if (!skip)
-		{   
-			Texture texture;
-			std::string filePath = directory + "/" + str.C_Str();
-			texture.id = loadTextureFromFile(filePath.c_str());
-			texture.type = typeName;
-			texture.path = str.C_Str();
-			textures.push_back(texture);
-			loadedTextures.push_back(texture);  // Store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures
-		}
+		// All textures were loaded up front by loadTextures
+		Texture texture;
+		texture.id = TextureCache::find(directory + "/" + path);
+		texture.type = typeName;
+		texture.path = path;
+		materialTextures.push_back(texture);
 	}
-	return textures;
-}
\ No newline at end of file
+	return materialTextures;
+}
@@ -1,35 +1,171 @@
 #pragma once
 
+#include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include <assimp/scene.h>
 
+#include "Bvh.h"
 #include "Model.h"
 #include "Mesh.h"
 #include "Material.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "OcclusionCuller.h"
+#include "RenderQueue.h"
 
 class Shader;
+class ShaderVariants;
 
 class Model3D : public Model
 {
 public:
-	Model3D(const std::string& path);
+	// Static batching merges meshes that share a material and whose centers fall into the same cell of a grid in model
+	// space into one mesh, so they take one draw. Meshes larger than a cell or with instances elsewhere in the model
+	// stay on their own. Batches are split to keep 16 bit indices. Zero cell size disables batching
+	struct BatchSettings
+	{
+		float cellSize = 32.0f;
+		uint32_t maxVertices = 0xFFFF;
+	};
+
+	// Streamed model returns right away and is read on a worker thread; its meshes appear as AssetLoader creates them
+	// and its textures show placeholders until they are uploaded. Vertex format applies to all meshes of the model. Alpha
+	// tested models discard fragments where their diffuse maps are almost transparent, e.g. cutout leaves
+	Model3D(const std::string& path, bool streamed = false, VertexFormat vertexFormat = VertexFormat::Standard, bool alphaTest = false);
 	~Model3D();
-	// Draws the model and all its meshes
+	// Does nothing, models are drawn through submit
 	void render(const Shader& shader) const override;
+	// Queues mesh instances of the model inside of the queue's frustum to be drawn with the transform. Once the model
+	// is loaded they are found through its instance hierarchy, until then every instance is tested on its own. Level of
+	// detail of every instance is selected by its size on screen, the last selection is kept for hysteresis, so the model
+	// should be submitted with one transform per frame. Every mesh is drawn with the shader variant of its material.
+	// Inside tells the loaded model is known to be within the frustum, so its instances are queued without tests
+	void submit(RenderQueue& queue, RenderPass pass, ShaderVariants& shaders, unsigned int transform, bool inside = false) const;
+	// Variants the meshes will be drawn with. Every material issues the compile of its variant as soon as it's created,
+	// so the variant links while the model streams in instead of blocking its first draw
+	void setShaderVariants(ShaderVariants* variants);
+	// True once all meshes are created and the mesh hierarchy is available
+	bool isLoaded() const { return loaded; }
+	// Bounds of all mesh instances in model space, valid once the model is loaded
+	Bounds getBounds() const { return hierarchy.getBounds(); }
+	// Mesh instances a submit of the whole model queues
+	size_t getInstanceCount() const { return instances != nullptr ? instances->size() : 0; }
+	// Adds occluders of mesh instances inside of the frustum as candidates of the culler, nothing until the model is loaded.
+	// Inside tells the model is known to be within the frustum, so its occluders aren't tested
+	void addOccluders(OcclusionCuller& culler, const Frustum& frustum, const glm::mat4& transform, bool inside = false) const;
+	// Levels of detail generated for models imported afterwards. Cooked files built with other settings are rebuilt
+	static void setLodSettings(const MeshOptimizer::LodSettings& settings) { lodSettings = settings; }
+	// Static batching of models imported afterwards. Cooked files built with other settings are rebuilt
+	static void setBatchSettings(const BatchSettings& settings) { batchSettings = settings; }
 protected:
+	// Model data either mapped from the cooked mesh file or imported from the source model
+	struct ModelSource
+	{
+		MeshCache cache;
+		ModelData data;
+		bool cached = false;
+		bool loaded = false;
+	};
+
+	// Occluder geometry of one source mesh, batches keep the occluders of all their meshes
+	struct SourceOccluder
+	{
+		std::vector<glm::vec3> vertices;
+		std::vector<unsigned int> indices;
+	};
+
+	// Unique mesh of the source before optimization
+	struct SourceMesh
+	{
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+		unsigned int materialIndex;
+		Bounds bounds;
+		std::vector<SourceOccluder> occluders;
+	};
+
+	// Meshes already imported by a hash of what a rigid transform doesn't change, copies of them become instances.
+	// Instances index the unique meshes until they are batched and appended to the model data
+	struct ImportState
+	{
+		MeshOptimizer::Statistics statistics;
+		std::unordered_multimap<uint64_t, std::pair<const aiMesh*, uint32_t>> meshes;
+		std::vector<SourceMesh> sourceMeshes;
+		std::vector<MeshInstance> instances;
+	};
+
 	std::vector<Mesh*> meshes;
+	std::vector<Material*> materials;     // Material table shared by all meshes of the model
+	ShaderVariants* shaderVariants = nullptr;
+	// Placements of the meshes in the source, set when the model starts loading
+	const std::vector<MeshInstance>* instances = nullptr;
 	std::string directory;
-	std::vector<Texture> loadedTextures;  // Stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once
+	std::vector<unsigned int> textures;   // References to shared textures used by the model, released on destruction
+	bool streamed;
+	VertexFormat vertexFormat;
+	bool alphaTest;
+	// Kept after loading because the mesh hierarchy is used straight from the mapped cooked file
+	std::shared_ptr<ModelSource> source;
+	Bvh hierarchy;
+	// Occluder geometry in the source, set once the model is loaded
+	const glm::vec3* occluderVertices = nullptr;
+	const uint32_t* occluderIndices = nullptr;
+	const std::vector<OccluderRange>* occluders = nullptr;
+	// Occluders of mesh i are meshOccluders[meshOccluderOffsets[i]] up to the offset of the next mesh, batches have several
+	std::vector<uint32_t> meshOccluderOffsets;
+	std::vector<uint32_t> meshOccluders;
+	std::vector<Bounds> occluderBounds;   // In mesh space, ranks occluders of a batch on their own
+	bool loaded = false;
 
-	// Processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-	void processNode(aiNode *node, const aiScene *scenes);
-	Mesh* processMesh(aiMesh *mesh, const aiScene *scenes);
-	// Loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+	// Meshes smaller than this hide little behind them and aren't worth rasterizing as occluders
+	static constexpr float MIN_OCCLUDER_RADIUS = 2.0f;
+	static const size_t MAX_OCCLUDER_TRIANGLES = 1024;
+	// Largest distance of a vertex of a copy from the transformed vertex of the imported mesh, relative to its size
+	static constexpr float INSTANCE_TOLERANCE = 1e-3f;
+	static constexpr float INSTANCE_NORMAL_TOLERANCE = 1e-2f;
+	// Level of detail each instance was drawn with last
+	mutable std::vector<uint8_t> meshLods;
+	static MeshOptimizer::LodSettings lodSettings;
+	static BatchSettings batchSettings;
+
+	// Loads model from its cooked mesh file. The cooked file is rebuilt from the source model with ASSIMP if it's missing or outdated
 	void loadModel(std::string const &path);
-	// Loads mesh material including textures and returns it as material class
-	Material loadMaterial(aiMaterial *mat);
-	// Checks all material textures of a given type and loads the textures if they're not loaded yet.
-	// The required info is returned as a Texture struct.
-	std::vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, std::string typeName);
-};
\ No newline at end of file
+	// Reads model data without touching GL, safe to call from worker threads
+	static void readModel(const std::string& path, ModelSource& source);
+	// Imports a model with supported ASSIMP extensions, batches and optimizes its meshes, flattens them into shared
+	// arrays and builds the hierarchy over bounds of their instances
+	static bool importModel(const std::string& path, ModelData& data);
+	// Processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
+	static void processNode(aiNode *node, const aiScene *scenes, ImportState& state);
+	// Adds an instance of an already imported mesh if the mesh is a rigidly transformed copy of it. Otherwise collects
+	// its geometry as a new unique mesh, large meshes with few triangles also get occluder geometry
+	static void processMesh(aiMesh *mesh, ImportState& state);
+	// Merges unique meshes placed once by the batch settings and replaces their instances with one per batch
+	static void batchMeshes(ImportState& state);
+	// Welds and reorders mesh geometry for the vertex cache and generates its levels of detail before appending it and
+	// its occluders to the shared arrays
+	static void appendMesh(SourceMesh& mesh, ModelData& data, MeshOptimizer::Statistics& statistics);
+	// Hashes material, topology and texture coordinates of the mesh, copies under a rigid transform have the same hash
+	static uint64_t hashMeshShape(const aiMesh& mesh);
+	// Finds rotation and translation mapping every vertex of the source onto the same vertex of the copy. Returns false
+	// if the copy differs in anything else or its vertices don't fit the transform within the tolerance
+	static bool findRigidTransform(const aiMesh& source, const aiMesh& copy, glm::mat4& transform);
+	static void addInstance(ModelData& data, uint32_t meshIndex, const glm::mat4& transform);
+	// Extracts material properties and texture paths
+	static MaterialData processMaterial(aiMaterial *mat);
+	// Creates materials and GPU meshes from flattened model data. Streamed model stops when the loader's frame budget
+	// is used up and returns false, the next call continues with the remaining meshes
+	bool createMeshes(const Vertex* vertices, const unsigned int* indices, const std::vector<MeshRange>& ranges, const std::vector<MaterialData>& materialTable);
+	// Attaches the mesh hierarchy once all meshes exist and drops the imported geometry, which is on the GPU by then
+	bool createMeshes(ModelSource& source);
+	// Acquires every texture referenced by the material table from the texture cache. Textures that aren't loaded yet are
+	// decoded in parallel on the shared thread pool and only the texture upload happens on the calling (GL) thread.
+	// Streamed model requests them from AssetLoader instead, so nothing is decoded here
+	void loadTextures(const std::vector<MaterialData>& materialTable);
+	// Loads material textures and returns it as material class
+	Material* loadMaterial(const MaterialData& data);
+	// Looks up already loaded textures of a given type. The required info is returned as a Texture struct.
+	std::vector<Texture> loadMaterialTextures(const std::vector<std::string>& paths, std::string typeName);
+};
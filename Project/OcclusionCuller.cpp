@@ -0,0 +1,304 @@
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+#include <xmmintrin.h>
+
+#include "ThreadPool.h"
+
+OcclusionCuller::OcclusionCuller()
+	: viewProjection(1.0f), cameraPosition(0.0f), depth(WIDTH * HEIGHT, FLT_MAX), tileTriangles(TILES_X * TILES_Y)
+{
+}
+
+void OcclusionCuller::begin(const glm::mat4 & matrix, const glm::vec3 & position)
+{
+	viewProjection = matrix;
+	cameraPosition = position;
+	// Empty pixels are farther than anything, so boxes over them are always visible
+	std::fill(depth.begin(), depth.end(), FLT_MAX);
+	candidates.clear();
+	occluderCount = 0;
+	occluderTriangles = 0;
+	testedItems = 0;
+	culledItems = 0;
+}
+
+void OcclusionCuller::addOccluder(const glm::vec3 * vertices, const uint32_t * indices, uint32_t indexCount, const glm::mat4 & transform,
+	const glm::vec3 & center, float radius)
+{
+	// Projected area grows with the squared ratio of radius and distance, the camera inside the sphere ranks highest
+	float distance = glm::length(center - cameraPosition);
+	float importance = distance > radius ? (radius * radius) / (distance * distance) : FLT_MAX;
+	candidates.push_back({ vertices, indices, indexCount, transform, importance });
+}
+
+void OcclusionCuller::rasterize()
+{
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.importance > b.importance; });
+
+	triangles.clear();
+	for (auto& tile : tileTriangles)
+	{
+		tile.clear();
+	}
+	for (const auto& candidate : candidates)
+	{
+		if (occluderTriangles + candidate.indexCount / 3 > MAX_OCCLUDER_TRIANGLES)
+		{
+			continue;
+		}
+		setupTriangles(candidate);
+		occluderTriangles += candidate.indexCount / 3;
+		++occluderCount;
+	}
+
+	// Tiles don't share pixels, so they are written without synchronization
+	ThreadPool::shared().parallelFor(tileTriangles.size(), [this](size_t tile)
+	{
+		rasterizeTile(static_cast<unsigned int>(tile));
+	});
+}
+
+bool OcclusionCuller::isVisible(const glm::vec3 & boxMin, const glm::vec3 & boxMax) const
+{
+	// Screen rectangle and nearest depth of the projected corners
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX, minZ = FLT_MAX;
+	for (int i = 0; i < 8; ++i)
+	{
+		glm::vec3 corner((i & 1) ? boxMax.x : boxMin.x, (i & 2) ? boxMax.y : boxMin.y, (i & 4) ? boxMax.z : boxMin.z);
+		glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+		if (clip.w <= MIN_CLIP_W)
+		{
+			return true;
+		}
+		float inverseW = 1.0f / clip.w;
+		float x = (clip.x * inverseW * 0.5f + 0.5f) * WIDTH;
+		float y = (clip.y * inverseW * 0.5f + 0.5f) * HEIGHT;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		minZ = std::min(minZ, clip.z * inverseW);
+	}
+
+	// Every pixel the box touches, leaving the screen is left to frustum culling
+	if (maxX < 0.0f || maxY < 0.0f || minX >= WIDTH || minY >= HEIGHT)
+	{
+		return true;
+	}
+	int x0 = std::max(0, static_cast<int>(std::floor(minX)));
+	int x1 = std::min(static_cast<int>(WIDTH) - 1, static_cast<int>(std::floor(maxX)));
+	int y0 = std::max(0, static_cast<int>(std::floor(minY)));
+	int y1 = std::min(static_cast<int>(HEIGHT) - 1, static_cast<int>(std::floor(maxY)));
+
+	// Visible if any pixel has no occluder in front of the box's nearest point
+	const __m128 boxDepth = _mm_set1_ps(minZ);
+	const __m128 laneOffsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+	const __m128 first = _mm_set1_ps(float(x0));
+	const __m128 last = _mm_set1_ps(float(x1));
+	for (int y = y0; y <= y1; ++y)
+	{
+		const float* row = &depth[y * WIDTH];
+		for (int x = x0 & ~3; x <= x1; x += 4)
+		{
+			__m128 lanes = _mm_add_ps(_mm_set1_ps(float(x)), laneOffsets);
+			__m128 inside = _mm_and_ps(_mm_cmpge_ps(lanes, first), _mm_cmple_ps(lanes, last));
+			__m128 behind = _mm_cmpge_ps(_mm_loadu_ps(row + x), boxDepth);
+			if (_mm_movemask_ps(_mm_and_ps(inside, behind)) != 0)
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void OcclusionCuller::test(const std::vector<glm::vec3>& boxMin, const std::vector<glm::vec3>& boxMax, std::vector<uint8_t>& visible)
+{
+	size_t count = boxMin.size();
+	visible.assign(count, 1);
+	if (occluderTriangles == 0)
+	{
+		return;
+	}
+
+	size_t batches = (count + TEST_BATCH_SIZE - 1) / TEST_BATCH_SIZE;
+	ThreadPool::shared().parallelFor(batches, [&](size_t batch)
+	{
+		size_t end = std::min(count, (batch + 1) * TEST_BATCH_SIZE);
+		for (size_t i = batch * TEST_BATCH_SIZE; i < end; ++i)
+		{
+			visible[i] = isVisible(boxMin[i], boxMax[i]) ? 1 : 0;
+		}
+	});
+
+	testedItems += static_cast<unsigned int>(count);
+	culledItems += static_cast<unsigned int>(std::count(visible.begin(), visible.end(), 0));
+}
+
+bool OcclusionCuller::saveDepthBuffer(const std::string & path) const
+{
+	// Stretch the occupied depth range over the gray levels, nearer is brighter
+	float nearest = FLT_MAX, farthest = -FLT_MAX;
+	for (auto value : depth)
+	{
+		if (value != FLT_MAX)
+		{
+			nearest = std::min(nearest, value);
+			farthest = std::max(farthest, value);
+		}
+	}
+	float range = farthest > nearest ? farthest - nearest : 1.0f;
+
+	std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		std::cout << "Failed to open " << path << " for writing" << std::endl;
+		return false;
+	}
+	file << "P5\n" << WIDTH << " " << HEIGHT << "\n255\n";
+	std::vector<unsigned char> row(WIDTH);
+	// Image rows go from the top, depth buffer rows from the bottom
+	for (unsigned int y = HEIGHT; y > 0; --y)
+	{
+		const float* values = &depth[(y - 1) * WIDTH];
+		for (unsigned int x = 0; x < WIDTH; ++x)
+		{
+			row[x] = values[x] == FLT_MAX ? 0 : static_cast<unsigned char>(255.0f - 200.0f * (values[x] - nearest) / range);
+		}
+		file.write(reinterpret_cast<const char*>(row.data()), row.size());
+	}
+	return file.good();
+}
+
+void OcclusionCuller::setupTriangles(const Candidate & candidate)
+{
+	if (candidate.indexCount == 0)
+	{
+		return;
+	}
+
+	// Only the vertices the triangles reference are transformed
+	uint32_t vertexCount = *std::max_element(candidate.indices, candidate.indices + candidate.indexCount) + 1;
+	clipVertices.resize(vertexCount);
+	glm::mat4 transform = viewProjection * candidate.transform;
+	for (uint32_t i = 0; i < vertexCount; ++i)
+	{
+		clipVertices[i] = transform * glm::vec4(candidate.vertices[i], 1.0f);
+	}
+
+	for (uint32_t i = 0; i + 2 < candidate.indexCount; i += 3)
+	{
+		const glm::vec4* clip[3] = { &clipVertices[candidate.indices[i]], &clipVertices[candidate.indices[i + 1]], &clipVertices[candidate.indices[i + 2]] };
+		// Triangles crossing the eye plane would need clipping, skipping them only makes the culling less aggressive
+		if (clip[0]->w <= MIN_CLIP_W || clip[1]->w <= MIN_CLIP_W || clip[2]->w <= MIN_CLIP_W)
+		{
+			continue;
+		}
+
+		float x[3], y[3], z[3];
+		for (int v = 0; v < 3; ++v)
+		{
+			float inverseW = 1.0f / clip[v]->w;
+			x[v] = (clip[v]->x * inverseW * 0.5f + 0.5f) * WIDTH;
+			y[v] = (clip[v]->y * inverseW * 0.5f + 0.5f) * HEIGHT;
+			z[v] = clip[v]->z * inverseW;
+		}
+
+		// Pixels whose centers may be covered
+		ScreenTriangle triangle;
+		triangle.minX = std::max(0, static_cast<int>(std::ceil(std::min(x[0], std::min(x[1], x[2])) - 0.5f)));
+		triangle.maxX = std::min(static_cast<int>(WIDTH) - 1, static_cast<int>(std::floor(std::max(x[0], std::max(x[1], x[2])) - 0.5f)));
+		triangle.minY = std::max(0, static_cast<int>(std::ceil(std::min(y[0], std::min(y[1], y[2])) - 0.5f)));
+		triangle.maxY = std::min(static_cast<int>(HEIGHT) - 1, static_cast<int>(std::floor(std::max(y[0], std::max(y[1], y[2])) - 0.5f)));
+		float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+		if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY || area == 0.0f)
+		{
+			continue;
+		}
+
+		// Both windings are drawn, occluders don't have to be closed
+		float sign = area > 0.0f ? 1.0f : -1.0f;
+		for (int e = 0; e < 3; ++e)
+		{
+			int next = (e + 1) % 3;
+			triangle.edgeA[e] = sign * (y[e] - y[next]);
+			triangle.edgeB[e] = sign * (x[next] - x[e]);
+			triangle.edgeC[e] = sign * (x[e] * y[next] - x[next] * y[e]);
+		}
+		triangle.depthA = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+		triangle.depthB = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+		triangle.depthC = z[0] - triangle.depthA * x[0] - triangle.depthB * y[0];
+
+		uint32_t index = static_cast<uint32_t>(triangles.size());
+		triangles.push_back(triangle);
+		for (int tileY = triangle.minY / TILE_HEIGHT; tileY <= triangle.maxY / static_cast<int>(TILE_HEIGHT); ++tileY)
+		{
+			for (int tileX = triangle.minX / TILE_WIDTH; tileX <= triangle.maxX / static_cast<int>(TILE_WIDTH); ++tileX)
+			{
+				tileTriangles[tileY * TILES_X + tileX].push_back(index);
+			}
+		}
+	}
+}
+
+void OcclusionCuller::rasterizeTile(unsigned int tile)
+{
+	int tileMinX = (tile % TILES_X) * TILE_WIDTH;
+	int tileMinY = (tile / TILES_X) * TILE_HEIGHT;
+	int tileMaxX = tileMinX + TILE_WIDTH - 1;
+	int tileMaxY = tileMinY + TILE_HEIGHT - 1;
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+
+	for (auto index : tileTriangles[tile])
+	{
+		const ScreenTriangle& triangle = triangles[index];
+		int minX = std::max(triangle.minX, tileMinX) & ~3;
+		int maxX = std::min(triangle.maxX, tileMaxX);
+		int minY = std::max(triangle.minY, tileMinY);
+		int maxY = std::min(triangle.maxY, tileMaxY);
+
+		__m128 edgeA[3];
+		for (int e = 0; e < 3; ++e)
+		{
+			edgeA[e] = _mm_set1_ps(triangle.edgeA[e]);
+		}
+		__m128 depthA = _mm_set1_ps(triangle.depthA);
+
+		for (int y = minY; y <= maxY; ++y)
+		{
+			// Edge functions and depth at the row's pixel centers are affine in x
+			float centerY = y + 0.5f;
+			__m128 edgeRow[3];
+			for (int e = 0; e < 3; ++e)
+			{
+				edgeRow[e] = _mm_set1_ps(triangle.edgeB[e] * centerY + triangle.edgeC[e]);
+			}
+			__m128 depthRow = _mm_set1_ps(triangle.depthB * centerY + triangle.depthC);
+
+			float* row = &depth[y * WIDTH];
+			for (int x = minX; x <= maxX; x += 4)
+			{
+				__m128 centerX = _mm_add_ps(_mm_set1_ps(float(x)), laneOffsets);
+				__m128 covered = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[0], centerX), edgeRow[0]), zero);
+				covered = _mm_and_ps(covered, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[1], centerX), edgeRow[1]), zero));
+				covered = _mm_and_ps(covered, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[2], centerX), edgeRow[2]), zero));
+				if (_mm_movemask_ps(covered) == 0)
+				{
+					continue;
+				}
+
+				__m128 triangleDepth = _mm_add_ps(_mm_mul_ps(depthA, centerX), depthRow);
+				__m128 current = _mm_loadu_ps(row + x);
+				__m128 nearest = _mm_min_ps(current, triangleDepth);
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(covered, nearest), _mm_andnot_ps(covered, current)));
+			}
+		}
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Software occlusion culling. The largest occluders of the frame are rasterized into a low resolution depth buffer on
+// the CPU, four pixels at a time with SSE and in tiles spread across the shared thread pool, then bounding boxes of draws
+// are tested against it. Depth is NDC z, smaller is nearer. Uses no GL, so it can run and be checked without a context
+class OcclusionCuller
+{
+public:
+	static const unsigned int WIDTH = 256;
+	static const unsigned int HEIGHT = 128;
+
+	OcclusionCuller();
+	// Starts a new frame: clears the depth buffer, candidates and counters
+	void begin(const glm::mat4& viewProjection, const glm::vec3& cameraPosition);
+	// Adds a candidate occluder given as indexed triangles in model space. Geometry must stay valid until rasterize.
+	// The world space bounding sphere ranks candidates by their projected size
+	void addOccluder(const glm::vec3* vertices, const uint32_t* indices, uint32_t indexCount, const glm::mat4& transform,
+		const glm::vec3& center, float radius);
+	// Rasterizes the largest candidates that fit into the triangle budget
+	void rasterize();
+	// Returns false when the world space box is hidden behind occluders. Boxes crossing the near plane are always visible
+	bool isVisible(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+	// Tests every box on the shared thread pool and clears visible[i] of the hidden ones, counts them in the statistics
+	void test(const std::vector<glm::vec3>& boxMin, const std::vector<glm::vec3>& boxMax, std::vector<uint8_t>& visible);
+	// Writes depth buffer as a binary PGM image, occluders are bright and empty pixels black
+	bool saveDepthBuffer(const std::string& path) const;
+
+	// Occluders and their triangles rasterized this frame, boxes tested and how many of them were hidden
+	unsigned int getOccluderCount() const { return occluderCount; }
+	unsigned int getOccluderTriangles() const { return occluderTriangles; }
+	unsigned int getTestedItems() const { return testedItems; }
+	unsigned int getCulledItems() const { return culledItems; }
+private:
+	struct Candidate
+	{
+		const glm::vec3* vertices;
+		const uint32_t* indices;
+		uint32_t indexCount;
+		glm::mat4 transform;
+		float importance;
+	};
+
+	// Triangle in pixel coordinates with edge functions positive inside and depth as a plane over the screen
+	struct ScreenTriangle
+	{
+		float edgeA[3], edgeB[3], edgeC[3];
+		float depthA, depthB, depthC;
+		int minX, minY, maxX, maxY;
+	};
+
+	// Tiles are a multiple of 4 pixels wide so a row of a tile is whole SSE registers
+	static const unsigned int TILE_WIDTH = 64;
+	static const unsigned int TILE_HEIGHT = 32;
+	static const unsigned int TILES_X = WIDTH / TILE_WIDTH;
+	static const unsigned int TILES_Y = HEIGHT / TILE_HEIGHT;
+	static const unsigned int MAX_OCCLUDER_TRIANGLES = 8192;
+	// Boxes tested by one task of the thread pool
+	static const size_t TEST_BATCH_SIZE = 64;
+	// Vertices closer to the eye plane than this aren't projected, triangles using them are skipped
+	static constexpr float MIN_CLIP_W = 1e-3f;
+
+	glm::mat4 viewProjection;
+	glm::vec3 cameraPosition;
+	std::vector<float> depth;
+	std::vector<Candidate> candidates;
+	std::vector<ScreenTriangle> triangles;
+	std::vector<std::vector<uint32_t>> tileTriangles;
+	std::vector<glm::vec4> clipVertices;
+	unsigned int occluderCount = 0;
+	unsigned int occluderTriangles = 0;
+	unsigned int testedItems = 0;
+	unsigned int culledItems = 0;
+
+	// Transforms candidate triangles, sets up the ones in front of the camera and bins them to tiles
+	void setupTriangles(const Candidate& candidate);
+	void rasterizeTile(unsigned int tile);
+};
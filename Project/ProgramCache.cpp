@@ -0,0 +1,195 @@
+#include "ProgramCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "FileUtil.h"
+
+namespace
+{
+	const char BINARY_MAGIC[4] = { 'H', 'O', 'P', 'B' };
+	const uint32_t BINARY_VERSION = 1;
+
+	struct BinaryHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t sourceHash;
+		uint64_t driverHash;
+		uint32_t format;
+		uint32_t size;
+	};
+}
+
+const char* const ProgramCache::CACHE_DIRECTORY = "ShaderCache";
+
+unsigned int ProgramCache::acquire(uint64_t sourceHash)
+{
+	auto found = getEntries().find(sourceHash);
+	if (found == getEntries().end())
+	{
+		return 0;
+	}
+
+	++found->second.referenceCount;
+	return found->second.program;
+}
+
+void ProgramCache::insert(uint64_t sourceHash, unsigned int program)
+{
+	static unsigned int programCount = 0;
+	getEntries()[sourceHash] = Entry{ program, 1, programCount++ };
+	getHashes()[program] = sourceHash;
+}
+
+void ProgramCache::release(unsigned int program)
+{
+	auto hash = getHashes().find(program);
+	if (hash == getHashes().end())
+	{
+		return;
+	}
+
+	auto entry = getEntries().find(hash->second);
+	if (--entry->second.referenceCount == 0)
+	{
+		glDeleteProgram(program);
+		getEntries().erase(entry);
+		getHashes().erase(hash);
+	}
+}
+
+unsigned int ProgramCache::getSortId(unsigned int program)
+{
+	auto hash = getHashes().find(program);
+	return hash != getHashes().end() ? getEntries()[hash->second].sortId : 0;
+}
+
+unsigned int ProgramCache::loadBinary(uint64_t sourceHash)
+{
+	if (!isBinarySupported())
+	{
+		return 0;
+	}
+
+	std::string content;
+	if (!FileUtil::loadBinaryFile(getBinaryPath(sourceHash), content) || content.size() < sizeof(BinaryHeader))
+	{
+		return 0;
+	}
+	BinaryHeader header;
+	memcpy(&header, content.data(), sizeof(header));
+	if (memcmp(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC)) != 0 || header.version != BINARY_VERSION || header.sourceHash != sourceHash
+		|| header.driverHash != getDriverHash() || content.size() != sizeof(BinaryHeader) + header.size)
+	{
+		return 0;
+	}
+
+	// Drivers may reject binaries of their own older versions, the program is then compiled from source
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, header.format, content.data() + sizeof(BinaryHeader), static_cast<GLsizei>(header.size));
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (linked != GL_TRUE)
+	{
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
+
+void ProgramCache::saveBinary(uint64_t sourceHash, unsigned int program)
+{
+	if (!isBinarySupported())
+	{
+		return;
+	}
+	GLint linked = GL_FALSE;
+	GLint size = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+	if (linked != GL_TRUE || size <= 0)
+	{
+		return;
+	}
+
+	BinaryHeader header = {};
+	memcpy(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+	header.version = BINARY_VERSION;
+	header.sourceHash = sourceHash;
+	header.driverHash = getDriverHash();
+	std::vector<char> binary(static_cast<size_t>(size));
+	GLsizei length = 0;
+	GLenum format = 0;
+	glGetProgramBinary(program, size, &length, &format, binary.data());
+	header.format = format;
+	header.size = static_cast<uint32_t>(length);
+
+	FileUtil::createDirectory(CACHE_DIRECTORY);
+	std::string path = getBinaryPath(sourceHash);
+	std::ofstream stream(path, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!stream.is_open())
+	{
+		std::cout << "Unable to write program binary " << path << std::endl;
+		return;
+	}
+	stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	stream.write(binary.data(), length);
+}
+
+bool ProgramCache::isBinarySupported()
+{
+	static const bool supported = [] {
+		if (glGetProgramBinary == nullptr || glProgramBinary == nullptr || glProgramParameteri == nullptr)
+		{
+			return false;
+		}
+		GLint formatCount = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+		return formatCount > 0;
+	}();
+	return supported;
+}
+
+std::unordered_map<uint64_t, ProgramCache::Entry>& ProgramCache::getEntries()
+{
+	static std::unordered_map<uint64_t, Entry> entries;
+	return entries;
+}
+
+std::unordered_map<unsigned int, uint64_t>& ProgramCache::getHashes()
+{
+	static std::unordered_map<unsigned int, uint64_t> hashes;
+	return hashes;
+}
+
+uint64_t ProgramCache::getDriverHash()
+{
+	static const uint64_t driverHash = [] {
+		uint64_t hash = FileUtil::hash(nullptr, 0);
+		for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+		{
+			const char* value = reinterpret_cast<const char*>(glGetString(name));
+			if (value != nullptr)
+			{
+				hash = FileUtil::hash(value, strlen(value), hash);
+			}
+		}
+		return hash;
+	}();
+	return driverHash;
+}
+
+std::string ProgramCache::getBinaryPath(uint64_t sourceHash)
+{
+	// Binaries of other drivers, e.g. after an update, get their own files instead of replacing each other
+	uint64_t key = FileUtil::hash(&sourceHash, sizeof(sourceHash), getDriverHash());
+	char name[17];
+	snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+	return std::string(CACHE_DIRECTORY) + "/" + name + ".bin";
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// Process-wide registry of linked shader programs keyed by hash of their sources after defines are inserted, so every
+// Shader compiled from the same files shares one reference counted program. Linked programs are also saved as driver
+// binaries and loaded on later launches instead of compiling. A binary only works with the driver that produced it, so
+// the driver's strings are part of its key, and binaries the driver rejects anyway are compiled again. Must only be
+// used on the GL thread
+class ProgramCache
+{
+public:
+	// Returns program registered for the sources and increments its reference count, 0 if it isn't registered
+	static unsigned int acquire(uint64_t sourceHash);
+	// Registers program created by the caller with reference count of one and gives it the next sort id
+	static void insert(uint64_t sourceHash, unsigned int program);
+	// Decrements reference count and deletes the program once nobody uses it
+	static void release(unsigned int program);
+	// Number identifying the program in draw sort keys, shaders sharing a program share it too
+	static unsigned int getSortId(unsigned int program);
+
+	// Creates program from the binary saved for the sources by this driver, 0 if there is none or it doesn't link
+	static unsigned int loadBinary(uint64_t sourceHash);
+	// Saves binary of the linked program for the sources. Does nothing when the driver can't return binaries
+	static void saveBinary(uint64_t sourceHash, unsigned int program);
+	// True if the driver supports program binaries, programs should then be linked with the retrievable hint
+	static bool isBinarySupported();
+private:
+	struct Entry
+	{
+		unsigned int program;
+		unsigned int referenceCount;
+		unsigned int sortId;
+	};
+
+	static const char* const CACHE_DIRECTORY;
+
+	static std::unordered_map<uint64_t, Entry>& getEntries();
+	static std::unordered_map<unsigned int, uint64_t>& getHashes();
+	// Hash of vendor, renderer and version strings of the context
+	static uint64_t getDriverHash();
+	static std::string getBinaryPath(uint64_t sourceHash);
+};
@@ -0,0 +1,99 @@
+#include "QuadBuffer.h"
+
+#include <algorithm>
+
+#include <glad/glad.h>
+
+QuadBuffer::QuadBuffer()
+{
+	glGenVertexArrays(1, &vao);
+	// Initialize VBO
+	glGenBuffers(1, &vertexBufferID);
+
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
+	// 1rst attribute : vertices
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+	// 2nd attribute : UVs
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, uv));
+	// Unbind VAO so no one can change it
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+QuadBuffer::~QuadBuffer()
+{
+	glDeleteVertexArrays(1, &vao);
+	// Delete buffers
+	glDeleteBuffers(1, &vertexBufferID);
+}
+
+void QuadBuffer::upload(const std::vector<Vertex>& vertices, size_t reservedVertices)
+{
+	vertexCount = vertices.size();
+	if (vertexCount == 0)
+	{
+		return;
+	}
+
+	// HUD strings change length every few frames, the doubled storage leaves them room to grow without a new size.
+	// Fresh storage for each upload means the HUD draw of the last frame is never waited for
+	size_t size = vertexCount * sizeof(Vertex);
+	size_t required = std::max(vertexCount, reservedVertices) * sizeof(Vertex);
+	if (required > bufferCapacity)
+	{
+		bufferCapacity = required * 2;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
+	glBufferData(GL_ARRAY_BUFFER, bufferCapacity, nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, size, vertices.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void QuadBuffer::draw(unsigned int texture) const
+{
+	if (vertexCount == 0)
+	{
+		return;
+	}
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	glBindVertexArray(vao);
+
+	// Bind texture
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, texture);
+
+	// Draw call for all quads
+	glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(vertexCount));
+
+	glBindVertexArray(0);
+
+	glDisable(GL_BLEND);
+}
+
+void QuadBuffer::addQuad(std::vector<Vertex>& vertices, const glm::vec2 & position, const glm::vec2 & size, const glm::vec2 & uvMin, const glm::vec2 & uvMax)
+{
+	glm::vec2 vertex_up_left = position + glm::vec2(0.0f, size.y);
+	glm::vec2 vertex_up_right = position + size;
+	glm::vec2 vertex_down_right = position + glm::vec2(size.x, 0.0f);
+	glm::vec2 vertex_down_left = position;
+
+	glm::vec2 uv_up_left = uvMin;
+	glm::vec2 uv_up_right = glm::vec2(uvMax.x, uvMin.y);
+	glm::vec2 uv_down_right = uvMax;
+	glm::vec2 uv_down_left = glm::vec2(uvMin.x, uvMax.y);
+
+	// A square is transformed into two triangles
+	vertices.push_back(Vertex{ vertex_up_left, uv_up_left });
+	vertices.push_back(Vertex{ vertex_down_left, uv_down_left });
+	vertices.push_back(Vertex{ vertex_up_right, uv_up_right });
+
+	vertices.push_back(Vertex{ vertex_down_right, uv_down_right });
+	vertices.push_back(Vertex{ vertex_up_right, uv_up_right });
+	vertices.push_back(Vertex{ vertex_down_left, uv_down_left });
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Streaming vertex buffer of screen space quads with interleaved positions and UVs, shared by the HUD batches. All
+// vertices are uploaded at once and drawn with alpha blending in a single call. Must only be used on the GL thread
+class QuadBuffer
+{
+public:
+	struct Vertex
+	{
+		glm::vec2 position;
+		glm::vec2 uv;
+	};
+
+	QuadBuffer();
+	~QuadBuffer();
+	// Replaces the vertices in the buffer, orphaning its old storage. Storage is sized for at least the reserved vertices,
+	// so batches that know their largest size never grow it
+	void upload(const std::vector<Vertex>& vertices, size_t reservedVertices = 0);
+	// Draws the uploaded vertices with the texture bound to the first unit, nothing if there are none
+	void draw(unsigned int texture) const;
+	size_t getVertexCount() const { return vertexCount; }
+	// Appends two triangles covering the rectangle with left bottom corner at position. UV min is at the top left corner,
+	// as the top row of images is at the lower v
+	static void addQuad(std::vector<Vertex>& vertices, const glm::vec2& position, const glm::vec2& size, const glm::vec2& uvMin, const glm::vec2& uvMax);
+
+	QuadBuffer(const QuadBuffer& buffer) = delete;
+	QuadBuffer& operator=(const QuadBuffer& buffer) = delete;
+private:
+	unsigned int vao;
+	unsigned int vertexBufferID;
+	size_t vertexCount = 0;
+	size_t bufferCapacity = 0;
+};
\ No newline at end of file
@@ -0,0 +1,518 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+
+#include <glad/glad.h>
+
+#include "GeometryBuffer.h"
+#include "Material.h"
+#include "Mesh.h"
+
+RenderQueue::RenderQueue() : instanceBuffer(GL_RGBA32F)
+{
+}
+
+void RenderQueue::begin(const glm::mat4 & viewProjection, const glm::vec3 & position, float far, float scale)
+{
+	frustum.update(viewProjection);
+	cameraPosition = position;
+	farPlane = far;
+	projectionScale = scale;
+	transforms.clear();
+	inverseTransforms.clear();
+	items.clear();
+	bounds.clear();
+	testedItems.clear();
+	drawCalls = 0;
+	depthDrawCalls = 0;
+	drawnTriangles = 0;
+	instancedItems = 0;
+	submittedItems = 0;
+	culledItems = 0;
+	skippedAtBegin = state.getSkippedCalls();
+}
+
+unsigned int RenderQueue::addTransform(const glm::mat4 & model)
+{
+	transforms.push_back(model);
+	inverseTransforms.push_back(glm::transpose(glm::inverse(model)));
+	return static_cast<unsigned int>(transforms.size() - 1);
+}
+
+void RenderQueue::submit(RenderPass pass, const Shader & shader, const Mesh & mesh, unsigned int transform, bool inside, unsigned int lod)
+{
+	const Bounds& meshBounds = mesh.getBounds();
+	const glm::mat4& model = transforms[transform];
+	glm::vec3 center, extents;
+	transformBounds(meshBounds, model, center, extents);
+	if (!inside)
+	{
+		bounds.add(center, extents, meshBounds.sphereRadius * getMaxScale(model));
+		testedItems.push_back(static_cast<uint32_t>(items.size()));
+	}
+
+	float depth = glm::clamp(glm::length(center - cameraPosition) / farPlane, 0.0f, 1.0f);
+	uint32_t quantizedDepth = static_cast<uint32_t>(depth * float((1u << DEPTH_BITS) - 1));
+
+	uint64_t key = makeKey(pass, shader.getSortId(), mesh.getMaterial()->getSortId(), quantizedDepth);
+	items.push_back({ key, &shader, &mesh, transform, std::min(lod, mesh.getLodCount() - 1), 0, 0 });
+	++submittedItems;
+}
+
+unsigned int RenderQueue::selectLod(const Mesh & mesh, unsigned int transform, unsigned int currentLod) const
+{
+	if (mesh.getLodCount() == 1)
+	{
+		return 0;
+	}
+
+	const Bounds& meshBounds = mesh.getBounds();
+	const glm::mat4& model = transforms[transform];
+	glm::vec3 center = glm::vec3(model * glm::vec4(meshBounds.sphereCenter, 1.0f));
+	float radius = meshBounds.sphereRadius * getMaxScale(model);
+	float distance = glm::length(center - cameraPosition);
+	// Camera within the bounding sphere is too close for any simplification
+	if (distance <= radius)
+	{
+		return 0;
+	}
+
+	// Level errors are relative to the radius, so the projected radius turns them into pixels
+	float screenRadius = radius * projectionScale / distance;
+	for (unsigned int lod = mesh.getLodCount() - 1; lod > 0; --lod)
+	{
+		float pixelError = lod > currentLod ? lodPixelError * (1.0f - LOD_HYSTERESIS) : lodPixelError;
+		if (mesh.getLodError(lod) * screenRadius <= pixelError)
+		{
+			return lod;
+		}
+	}
+	return 0;
+}
+
+void RenderQueue::addCulledItems(unsigned int count)
+{
+	submittedItems += count;
+	culledItems += count;
+}
+
+void RenderQueue::sort()
+{
+	cull();
+	radixSort();
+	groupInstances();
+}
+
+void RenderQueue::flush(RenderPass pass)
+{
+	// Items of a pass are contiguous after sorting
+	uint64_t passBits = uint64_t(pass) << (64 - PASS_BITS);
+	auto first = std::partition_point(items.begin(), items.end(), [passBits](const DrawItem& item) { return item.key < passBits; });
+	auto last = std::partition_point(first, items.end(), [passBits](const DrawItem& item) { return (item.key >> (64 - PASS_BITS)) == (passBits >> (64 - PASS_BITS)); });
+	if (first == last)
+	{
+		return;
+	}
+
+	// Anything may have been changed directly through GL since the last flush
+	state.invalidate();
+	if (pass == RenderPass::Transparent)
+	{
+		state.setBlend(true, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	}
+	else
+	{
+		state.setBlend(false, GL_ONE, GL_ZERO);
+	}
+	if (pass == RenderPass::Opaque && depthShader != nullptr)
+	{
+		flushDepth(first, last);
+		// Depth is final, shading only passes for the nearest surface. Alpha tested materials set their own depth test
+		state.setDepth(GL_EQUAL, false);
+	}
+	else
+	{
+		state.setDepth(GL_LESS, true);
+	}
+
+	const Shader* boundShader = nullptr;
+	const Bindings* bindings = nullptr;
+	const Material* boundMaterial = nullptr;
+	unsigned int boundTransform = ~0u;
+	// Standard meshes share one value of the vertex format uniforms, so it's set only when it changes
+	bool formatBound = false;
+	for (auto it = first; it != last;)
+	{
+		const DrawItem& item = *it;
+		const Mesh& mesh = *item.mesh;
+		if (item.shader != boundShader)
+		{
+			boundShader = item.shader;
+			state.useProgram(boundShader->getProgram());
+			bindings = &boundShader->getBindings<Bindings>();
+			boundMaterial = nullptr;
+			boundTransform = ~0u;
+			formatBound = false;
+			for (const auto& frameTexture : frameTextures)
+			{
+				int unit = boundShader->getTextureUnit(frameTexture.name.c_str());
+				if (unit >= 0)
+				{
+					state.bindTexture(unit, frameTexture.target, frameTexture.texture);
+				}
+			}
+		}
+		state.bindVertexArray(GeometryBuffer::get(mesh.getVertexFormat()).getVertexArray());
+		if (mesh.getMaterial() != boundMaterial)
+		{
+			boundMaterial = mesh.getMaterial();
+			boundMaterial->bind(*boundShader, state);
+			// Alpha tested items aren't in the pre-pass depth, they're tested against it and write their own
+			if (pass == RenderPass::Opaque && depthShader != nullptr)
+			{
+				bool alphaTested = boundMaterial->isAlphaTested();
+				state.setDepth(alphaTested ? GL_LEQUAL : GL_EQUAL, alphaTested);
+			}
+		}
+
+		// Instanced runs read their transforms from the instance buffer, the uniforms are only needed for single draws
+		if (item.instanceCount > 0)
+		{
+			if (mesh.getVertexFormat() == VertexFormat::Compact || !formatBound)
+			{
+				mesh.bindVertexFormat(*boundShader);
+				formatBound = mesh.getVertexFormat() == VertexFormat::Standard;
+			}
+			state.bindTexture(bindings->instanceUnit, GL_TEXTURE_BUFFER, instanceBuffer.getTexture());
+			boundShader->bindUniform(bindings->instanced, 1);
+			boundShader->bindUniform(bindings->firstInstance, static_cast<int>(item.firstInstance));
+			mesh.drawInstanced(item.lod, item.instanceCount);
+			boundShader->bindUniform(bindings->instanced, 0);
+			drawnTriangles += mesh.getIndexCount(item.lod) / 3 * item.instanceCount;
+			instancedItems += item.instanceCount;
+			++drawCalls;
+			it += item.instanceCount;
+			continue;
+		}
+		if (item.transform != boundTransform)
+		{
+			boundTransform = item.transform;
+			boundShader->bindUniform(bindings->model, transforms[boundTransform]);
+			boundShader->bindUniform(bindings->inverseModel, inverseTransforms[boundTransform]);
+		}
+
+		// Compact meshes have their own dequantization uniforms and are drawn one by one
+		if (mesh.getVertexFormat() == VertexFormat::Compact)
+		{
+			mesh.bindVertexFormat(*boundShader);
+			mesh.draw(item.lod);
+			drawnTriangles += mesh.getIndexCount(item.lod) / 3;
+			formatBound = false;
+			++drawCalls;
+			++it;
+			continue;
+		}
+		if (!formatBound)
+		{
+			mesh.bindVertexFormat(*boundShader);
+			formatBound = true;
+		}
+
+		// Following items that need no state change are drawn with the same call
+		drawCounts.clear();
+		drawOffsets.clear();
+		drawBaseVertices.clear();
+		while (it != last && it->shader == boundShader && it->mesh->getMaterial() == boundMaterial && it->transform == boundTransform
+			&& it->instanceCount == 0 && it->mesh->getVertexFormat() == VertexFormat::Standard && it->mesh->getIndexType() == mesh.getIndexType())
+		{
+			drawCounts.push_back(it->mesh->getIndexCount(it->lod));
+			drawOffsets.push_back(reinterpret_cast<const void*>(it->mesh->getIndexOffset(it->lod)));
+			drawBaseVertices.push_back(it->mesh->getBaseVertex());
+			drawnTriangles += it->mesh->getIndexCount(it->lod) / 3;
+			++it;
+		}
+		glMultiDrawElementsBaseVertex(GL_TRIANGLES, drawCounts.data(), mesh.getIndexType(), drawOffsets.data(), static_cast<GLsizei>(drawCounts.size()),
+			drawBaseVertices.data());
+		++drawCalls;
+	}
+
+	// Code drawing directly through GL expects no vertex array, the first texture unit and default depth state
+	state.bindVertexArray(0);
+	state.resetActiveTexture();
+	state.setDepth(GL_LESS, true);
+}
+
+void RenderQueue::flushDepth(std::vector<DrawItem>::const_iterator first, std::vector<DrawItem>::const_iterator last)
+{
+	state.setColorWrite(false);
+	state.setDepth(GL_LESS, true);
+	state.useProgram(depthShader->getProgram());
+	const Bindings& bindings = depthShader->getBindings<Bindings>();
+	unsigned int boundTransform = ~0u;
+	bool formatBound = false;
+	for (auto it = first; it != last;)
+	{
+		const DrawItem& item = *it;
+		const Mesh& mesh = *item.mesh;
+		// Discarded fragments of alpha tested items would occlude what's behind them, they're left to the shading pass
+		if (mesh.getMaterial()->isAlphaTested())
+		{
+			it += std::max(item.instanceCount, 1u);
+			continue;
+		}
+		state.bindVertexArray(GeometryBuffer::get(mesh.getVertexFormat()).getDepthVertexArray());
+		if (mesh.getVertexFormat() == VertexFormat::Compact || !formatBound)
+		{
+			mesh.bindVertexFormat(*depthShader);
+			formatBound = mesh.getVertexFormat() == VertexFormat::Standard;
+		}
+
+		// Without the instance buffer sampler the items of an instanced run are drawn one by one
+		if (item.instanceCount > 0 && bindings.instanceUnit >= 0)
+		{
+			state.bindTexture(bindings.instanceUnit, GL_TEXTURE_BUFFER, instanceBuffer.getTexture());
+			depthShader->bindUniform(bindings.instanced, 1);
+			depthShader->bindUniform(bindings.firstInstance, static_cast<int>(item.firstInstance));
+			mesh.drawInstanced(item.lod, item.instanceCount);
+			depthShader->bindUniform(bindings.instanced, 0);
+			++depthDrawCalls;
+			it += item.instanceCount;
+			continue;
+		}
+		if (item.transform != boundTransform)
+		{
+			boundTransform = item.transform;
+			depthShader->bindUniform(bindings.model, transforms[boundTransform]);
+		}
+		if (mesh.getVertexFormat() == VertexFormat::Compact)
+		{
+			mesh.draw(item.lod);
+			++depthDrawCalls;
+			++it;
+			continue;
+		}
+
+		drawCounts.clear();
+		drawOffsets.clear();
+		drawBaseVertices.clear();
+		while (it != last && it->transform == boundTransform && (it->instanceCount == 0 || bindings.instanceUnit < 0)
+			&& !it->mesh->getMaterial()->isAlphaTested() && it->mesh->getVertexFormat() == VertexFormat::Standard && it->mesh->getIndexType() == mesh.getIndexType())
+		{
+			drawCounts.push_back(it->mesh->getIndexCount(it->lod));
+			drawOffsets.push_back(reinterpret_cast<const void*>(it->mesh->getIndexOffset(it->lod)));
+			drawBaseVertices.push_back(it->mesh->getBaseVertex());
+			++it;
+		}
+		glMultiDrawElementsBaseVertex(GL_TRIANGLES, drawCounts.data(), mesh.getIndexType(), drawOffsets.data(), static_cast<GLsizei>(drawCounts.size()),
+			drawBaseVertices.data());
+		++depthDrawCalls;
+	}
+	state.setColorWrite(true);
+}
+
+void RenderQueue::setFrameTexture(const std::string & name, unsigned int target, unsigned int texture)
+{
+	for (auto& frameTexture : frameTextures)
+	{
+		if (frameTexture.name == name)
+		{
+			frameTexture.target = target;
+			frameTexture.texture = texture;
+			return;
+		}
+	}
+	frameTextures.push_back({ name, target, texture });
+}
+
+void RenderQueue::cull()
+{
+	frustum.intersects(bounds, visible);
+	itemVisible.assign(items.size(), 1);
+	for (size_t i = 0; i < testedItems.size(); ++i)
+	{
+		itemVisible[testedItems[i]] = visible[i];
+	}
+	removeCulled(itemVisible);
+
+	// Only items in the view are tested against the depth buffer
+	if (occlusionCuller != nullptr)
+	{
+		boxMin.resize(items.size());
+		boxMax.resize(items.size());
+		for (size_t i = 0; i < items.size(); ++i)
+		{
+			glm::vec3 center, extents;
+			transformBounds(items[i].mesh->getBounds(), transforms[items[i].transform], center, extents);
+			boxMin[i] = center - extents;
+			boxMax[i] = center + extents;
+		}
+		occlusionCuller->test(boxMin, boxMax, itemVisible);
+		removeCulled(itemVisible);
+	}
+}
+
+void RenderQueue::removeCulled(const std::vector<uint8_t>& visibility)
+{
+	size_t visibleCount = 0;
+	for (size_t i = 0; i < items.size(); ++i)
+	{
+		if (visibility[i])
+		{
+			items[visibleCount++] = items[i];
+		}
+	}
+	culledItems += static_cast<unsigned int>(items.size() - visibleCount);
+	items.resize(visibleCount);
+}
+
+void RenderQueue::transformBounds(const Bounds & meshBounds, const glm::mat4 & model, glm::vec3 & center, glm::vec3 & extents)
+{
+	// Box extents of the transformed mesh are the model space extents projected onto the absolute basis vectors
+	center = glm::vec3(model * glm::vec4(meshBounds.sphereCenter, 1.0f));
+	glm::mat3 basis(model);
+	glm::mat3 absoluteBasis(glm::abs(basis[0]), glm::abs(basis[1]), glm::abs(basis[2]));
+	extents = absoluteBasis * ((meshBounds.max - meshBounds.min) * 0.5f);
+}
+
+float RenderQueue::getMaxScale(const glm::mat4 & model)
+{
+	return std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+}
+
+uint64_t RenderQueue::makeKey(RenderPass pass, unsigned int program, unsigned int material, uint32_t depth)
+{
+	const uint64_t programMask = (1ull << PROGRAM_BITS) - 1;
+	const uint64_t materialMask = (1ull << MATERIAL_BITS) - 1;
+	const uint64_t depthMask = (1ull << DEPTH_BITS) - 1;
+
+	uint64_t key = uint64_t(pass) << (64 - PASS_BITS);
+	if (pass == RenderPass::Transparent)
+	{
+		unsigned int shift = 64 - PASS_BITS - DEPTH_BITS;
+		key |= ((depthMask - depth) & depthMask) << shift;
+		shift -= PROGRAM_BITS;
+		key |= (program & programMask) << shift;
+		shift -= MATERIAL_BITS;
+		key |= (material & materialMask) << shift;
+	}
+	else
+	{
+		unsigned int shift = 64 - PASS_BITS - PROGRAM_BITS;
+		key |= (program & programMask) << shift;
+		shift -= MATERIAL_BITS;
+		key |= (material & materialMask) << shift;
+		shift -= DEPTH_BITS;
+		key |= (depth & depthMask) << shift;
+	}
+	return key;
+}
+
+void RenderQueue::radixSort()
+{
+	sortBuffer.resize(items.size());
+	for (unsigned int shift = 0; shift < 64; shift += 8)
+	{
+		size_t counts[256] = {};
+		for (const auto& item : items)
+		{
+			++counts[(item.key >> shift) & 0xFF];
+		}
+		// Digit is the same for all keys, order wouldn't change
+		if (items.empty() || counts[(items.front().key >> shift) & 0xFF] == items.size())
+		{
+			continue;
+		}
+
+		size_t offset = 0;
+		for (auto& count : counts)
+		{
+			size_t bucketSize = count;
+			count = offset;
+			offset += bucketSize;
+		}
+		for (const auto& item : items)
+		{
+			sortBuffer[counts[(item.key >> shift) & 0xFF]++] = item;
+		}
+		items.swap(sortBuffer);
+	}
+}
+
+void RenderQueue::groupInstances()
+{
+	instanceMatrices.clear();
+	// Opaque items come first after sorting, their key has the program and material above the depth
+	const uint64_t stateMask = ~((1ull << (64 - PASS_BITS - PROGRAM_BITS - MATERIAL_BITS)) - 1);
+	size_t first = 0;
+	while (first < items.size() && (items[first].key >> (64 - PASS_BITS)) == uint64_t(RenderPass::Opaque))
+	{
+		size_t last = first + 1;
+		while (last < items.size() && (items[last].key & stateMask) == (items[first].key & stateMask))
+		{
+			++last;
+		}
+
+		// Counting sort of the run by group, groups numbered by their nearest item keep the run roughly front to back
+		meshGroups.clear();
+		itemGroups.resize(last - first);
+		groupOffsets.clear();
+		for (size_t i = first; i < last; ++i)
+		{
+			uint64_t mesh = (uint64_t(reinterpret_cast<uintptr_t>(items[i].mesh)) << 2) | items[i].lod;
+			auto group = meshGroups.emplace(mesh, static_cast<uint32_t>(groupOffsets.size()));
+			if (group.second)
+			{
+				groupOffsets.push_back(0);
+			}
+			itemGroups[i - first] = group.first->second;
+			++groupOffsets[group.first->second];
+		}
+		if (groupOffsets.size() < last - first)
+		{
+			uint32_t offset = static_cast<uint32_t>(first);
+			for (auto& groupOffset : groupOffsets)
+			{
+				uint32_t groupSize = groupOffset;
+				groupOffset = offset;
+				offset += groupSize;
+			}
+			sortBuffer.resize(items.size());
+			for (size_t i = first; i < last; ++i)
+			{
+				sortBuffer[groupOffsets[itemGroups[i - first]]++] = items[i];
+			}
+			std::copy(sortBuffer.begin() + first, sortBuffer.begin() + last, items.begin() + first);
+		}
+
+		// Runs of one mesh drawn by a shader that reads the instance buffer become one draw
+		for (size_t i = first; i < last;)
+		{
+			size_t runEnd = i + 1;
+			while (runEnd < last && items[runEnd].mesh == items[i].mesh && items[runEnd].lod == items[i].lod && items[runEnd].shader == items[i].shader)
+			{
+				++runEnd;
+			}
+			unsigned int count = static_cast<unsigned int>(runEnd - i);
+			if (count >= MIN_INSTANCES && items[i].shader->getBindings<Bindings>().instanceUnit >= 0)
+			{
+				items[i].firstInstance = static_cast<unsigned int>(instanceMatrices.size() / MATRICES_PER_INSTANCE);
+				items[i].instanceCount = count;
+				for (size_t j = i; j < runEnd; ++j)
+				{
+					instanceMatrices.push_back(transforms[items[j].transform]);
+					instanceMatrices.push_back(inverseTransforms[items[j].transform]);
+				}
+			}
+			i = runEnd;
+		}
+		first = last;
+	}
+	instanceBuffer.update(instanceMatrices.data(), instanceMatrices.size() * sizeof(glm::mat4));
+}
+
+RenderQueue::Bindings::Bindings(const Shader & shader)
+	: model(shader.getUniform<glm::mat4>("model")), inverseModel(shader.getUniform<glm::mat4>("inverseModel")),
+	instanced(shader.getUniform<int>("instanced")), firstInstance(shader.getUniform<int>("firstInstance")),
+	instanceUnit(shader.getTextureUnit("instanceMatrices"))
+{
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Frustum.h"
+#include "OcclusionCuller.h"
+#include "Shader.h"
+#include "StateTracker.h"
+#include "TextureBuffer.h"
+
+class Mesh;
+struct Bounds;
+
+// Passes are drawn in this order, each with its own blend state
+enum class RenderPass
+{
+	Opaque = 0,
+	Transparent = 1
+};
+
+// Collects the frame's mesh draws, drops the ones outside of the view frustum or hidden behind occluders, sorts the rest
+// by a 64-bit key and submits them through a state tracker so consecutive draws sharing program, vertex array, material or transform don't repeat the
+// bindings. Opaque draws of the same mesh with different transforms are drawn with one instanced call. Opaque items can
+// be drawn twice, first depth only and then shaded where their depth is equal. Must only be used on the GL thread
+class RenderQueue
+{
+public:
+	RenderQueue();
+	// Starts a new frame. Items are culled against the frustum of the matrix, their depth is the distance from the camera
+	// normalized by the far plane. Projection scale is the size in pixels of a unit length at unit distance from the
+	// camera, it measures meshes on screen to select their levels of detail
+	void begin(const glm::mat4& viewProjection, const glm::vec3& cameraPosition, float farPlane, float projectionScale);
+	// Adds model matrix for the items submitted with the returned index
+	unsigned int addTransform(const glm::mat4& model);
+	// Queues level of detail of the mesh to be drawn in the pass with the shader and transform. Unless it's known to be
+	// inside of the frustum, its bounds are tested when sorting
+	void submit(RenderPass pass, const Shader& shader, const Mesh& mesh, unsigned int transform, bool inside = false, unsigned int lod = 0);
+	// Returns the coarsest level of detail of the mesh whose error stays within the pixel error on screen. Levels coarser
+	// than the current one must be within a smaller error, so meshes near a switching distance don't alternate each frame
+	unsigned int selectLod(const Mesh& mesh, unsigned int transform, unsigned int currentLod) const;
+	// Largest error in pixels a level of detail may have on screen
+	void setLodPixelError(float pixelError) { lodPixelError = pixelError; }
+	// Counts items that were rejected before being submitted, e.g. by a bounding volume hierarchy
+	void addCulledItems(unsigned int count);
+	const Frustum& getFrustum() const { return frustum; }
+	const glm::mat4& getTransform(unsigned int transform) const { return transforms[transform]; }
+	// Removes items outside of the frustum and hidden ones, sorts the rest and uploads matrices of instanced draws. Must
+	// be called after the last submit and before flushing
+	void sort();
+	// Culler whose depth buffer hides items when sorting, it must be rasterized for the frame before. Null disables the test
+	void setOcclusionCuller(OcclusionCuller* culler) { occlusionCuller = culler; }
+	// Shader drawing opaque items into the depth buffer before they are shaded with an equal depth test, so every visible
+	// pixel is shaded once. It must compute positions exactly like the shaders of the items. Alpha tested items are left
+	// out, they're shaded with a less or equal test and write depth. Null disables the pre-pass
+	void setDepthPrePass(const Shader* shader) { depthShader = shader; }
+	bool hasDepthPrePass() const { return depthShader != nullptr; }
+	// Draws items of the pass in sorted order, opaque items after the depth pre-pass if there is one
+	void flush(RenderPass pass);
+	// Binds the texture to the sampler of that name in every shader drawing items, e.g. light clusters of the frame.
+	// Shaders without the sampler ignore it
+	void setFrameTexture(const std::string& name, unsigned int target, unsigned int texture);
+
+	// Draw calls issued and state changes skipped by the tracker during the frame
+	unsigned int getDrawCalls() const { return drawCalls; }
+	// Draw calls of the depth pre-pass, not included in the draw calls
+	unsigned int getDepthDrawCalls() const { return depthDrawCalls; }
+	unsigned int getSkippedStateChanges() const { return state.getSkippedCalls() - skippedAtBegin; }
+	// Triangles of all drawn levels of detail
+	unsigned int getDrawnTriangles() const { return drawnTriangles; }
+	// Items drawn by instanced draw calls
+	unsigned int getInstancedItems() const { return instancedItems; }
+	// Items submitted during the frame and how many of them were outside of the frustum or hidden
+	unsigned int getSubmittedItems() const { return submittedItems; }
+	unsigned int getCulledItems() const { return culledItems; }
+private:
+	struct DrawItem
+	{
+		uint64_t key;
+		const Shader* shader;
+		const Mesh* mesh;
+		unsigned int transform;
+		unsigned int lod;
+		// First item of an instanced run: its instances in the instance buffer. Zero count for items drawn on their own
+		unsigned int firstInstance;
+		unsigned int instanceCount;
+	};
+
+	// Model matrix uniforms of a shader, resolved once per program. Shaders without the instance buffer sampler draw
+	// every item on its own
+	struct Bindings
+	{
+		Uniform<glm::mat4> model;
+		Uniform<glm::mat4> inverseModel;
+		Uniform<int> instanced;
+		Uniform<int> firstInstance;
+		int instanceUnit;
+
+		explicit Bindings(const Shader& shader);
+	};
+
+	// Key layout from the most significant bit. Opaque items are grouped by state and drawn front to back within
+	// a material for early depth rejection, transparent items are drawn back to front for correct blending:
+	// opaque:      pass(2) | program(8) | material(16) | depth(24) | unused(14)
+	// transparent: pass(2) | inverted depth(24) | program(8) | material(16) | unused(14)
+	static const unsigned int PASS_BITS = 2;
+	static const unsigned int PROGRAM_BITS = 8;
+	static const unsigned int MATERIAL_BITS = 16;
+	static const unsigned int DEPTH_BITS = 24;
+	// Fraction of the pixel error a coarser level must stay below before switching to it
+	static constexpr float LOD_HYSTERESIS = 0.25f;
+	// Fewer draws of a mesh are cheaper with the uniforms than through the instance buffer
+	static const unsigned int MIN_INSTANCES = 2;
+	// Matrices of one instance in the instance buffer: model matrix followed by the inverse transposed model matrix
+	static const unsigned int MATRICES_PER_INSTANCE = 2;
+
+	struct FrameTexture
+	{
+		std::string name;
+		unsigned int target;
+		unsigned int texture;
+	};
+
+	Frustum frustum;
+	glm::vec3 cameraPosition;
+	float farPlane = 1.0f;
+	float projectionScale = 1.0f;
+	float lodPixelError = 1.0f;
+	std::vector<glm::mat4> transforms;
+	std::vector<glm::mat4> inverseTransforms;
+	std::vector<DrawItem> items;
+	std::vector<DrawItem> sortBuffer;
+	// World space bounds of the items that need the frustum test, their indices in items and the test results
+	BoundsArrays bounds;
+	std::vector<uint32_t> testedItems;
+	std::vector<uint8_t> visible;
+	std::vector<uint8_t> itemVisible;
+	OcclusionCuller* occlusionCuller = nullptr;
+	std::vector<glm::vec3> boxMin;
+	std::vector<glm::vec3> boxMax;
+	StateTracker state;
+	// Matrices of instanced draws read by gl_InstanceID plus the draw's first instance, as GL 3.3 has no base instance
+	TextureBuffer instanceBuffer;
+	std::vector<glm::mat4> instanceMatrices;
+	// Group of every (mesh, level of detail) within a run of items sharing program and material, reused between runs
+	std::unordered_map<uint64_t, uint32_t> meshGroups;
+	std::vector<uint32_t> itemGroups;
+	std::vector<uint32_t> groupOffsets;
+	std::vector<FrameTexture> frameTextures;
+	const Shader* depthShader = nullptr;
+	unsigned int drawCalls = 0;
+	unsigned int depthDrawCalls = 0;
+	unsigned int drawnTriangles = 0;
+	unsigned int instancedItems = 0;
+	unsigned int skippedAtBegin = 0;
+	unsigned int submittedItems = 0;
+	unsigned int culledItems = 0;
+	// Multi-draw parameters reused between frames
+	std::vector<int> drawCounts;
+	std::vector<const void*> drawOffsets;
+	std::vector<int> drawBaseVertices;
+
+	// Draws the items with the depth shader and color writes disabled, except alpha tested ones. Other materials don't
+	// matter, so consecutive items differing only in material are drawn with one call
+	void flushDepth(std::vector<DrawItem>::const_iterator first, std::vector<DrawItem>::const_iterator last);
+	// Removes items whose bounds are outside of the frustum or hidden behind occluders, keeping the order of the rest
+	void cull();
+	// Removes items whose visible flag is 0 and counts them as culled
+	void removeCulled(const std::vector<uint8_t>& visibility);
+	// World space box of the transformed mesh bounds as center and half extents
+	static void transformBounds(const Bounds& bounds, const glm::mat4& model, glm::vec3& center, glm::vec3& extents);
+	// Largest scale of the model matrix along any axis, bounding spheres grow with it
+	static float getMaxScale(const glm::mat4& model);
+	static uint64_t makeKey(RenderPass pass, unsigned int program, unsigned int material, uint32_t depth);
+	// LSD radix sort of items by key, 8 bits per pass. Passes where all keys have the same digit are skipped
+	void radixSort();
+	// Makes opaque items of the same mesh and level of detail adjacent within their program and material, in order of
+	// the nearest one, and gathers the matrices of runs long enough to be instanced
+	void groupInstances();
+};
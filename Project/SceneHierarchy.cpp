@@ -0,0 +1,177 @@
+#include "SceneHierarchy.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "HiddenObject.h"
+#include "Model3D.h"
+
+void SceneHierarchy::addModel(const Model3D * model, RenderPass pass)
+{
+	entries.push_back({ model, nullptr, pass });
+}
+
+void SceneHierarchy::addObject(HiddenObject * object)
+{
+	entries.push_back({ &object->getModel(), object, RenderPass::Opaque });
+}
+
+void SceneHierarchy::update()
+{
+	// Finished models bring a new leaf, which needs a rebuild. A few moved objects only need the boxes refitted
+	size_t loaded = countLoadedModels(entries);
+	if (loaded != loadedModels || leafEntries.empty())
+	{
+		loadedModels = loaded;
+		rebuild();
+		return;
+	}
+
+	bool moved = false;
+	for (size_t i = 0; i < leafEntries.size(); ++i)
+	{
+		const Entry& entry = entries[leafEntries[i]];
+		if (entry.object == nullptr)
+		{
+			continue;
+		}
+		Bounds bounds = getWorldBounds(entry);
+		if (bounds.min != leafBounds[i].min || bounds.max != leafBounds[i].max)
+		{
+			leafBounds[i] = bounds;
+			moved = true;
+		}
+	}
+	if (moved)
+	{
+		hierarchy.refit(leafBounds.data());
+	}
+}
+
+void SceneHierarchy::submit(RenderQueue & queue, ShaderVariants & shaders) const
+{
+	unsigned int sceneTransform = queue.addTransform(glm::mat4());
+
+	leafVisible.assign(leafEntries.size(), 0);
+	hierarchy.cull(queue.getFrustum(), [&](uint32_t leaf, bool inside)
+	{
+		leafVisible[leaf] = 1;
+		submitEntry(queue, shaders, entries[leafEntries[leaf]], sceneTransform, inside);
+	});
+	for (size_t i = 0; i < leafEntries.size(); ++i)
+	{
+		if (!leafVisible[i])
+		{
+			queue.addCulledItems(static_cast<unsigned int>(entries[leafEntries[i]].model->getInstanceCount()));
+		}
+	}
+
+	// Streaming models show the meshes created so far
+	for (const auto& entry : entries)
+	{
+		if (entry.object == nullptr && !entry.model->isLoaded())
+		{
+			submitEntry(queue, shaders, entry, sceneTransform, false);
+		}
+	}
+}
+
+void SceneHierarchy::addOccluders(OcclusionCuller & culler, const Frustum & frustum) const
+{
+	// Transparent models let the background through and hidden objects are too small to hide anything
+	hierarchy.cull(frustum, [&](uint32_t leaf, bool inside)
+	{
+		const Entry& entry = entries[leafEntries[leaf]];
+		if (entry.object == nullptr && entry.pass == RenderPass::Opaque)
+		{
+			entry.model->addOccluders(culler, frustum, glm::mat4(), inside);
+		}
+	});
+}
+
+void SceneHierarchy::findObjects(const glm::vec3 & center, float radius, std::vector<HiddenObject*>& objects) const
+{
+	hierarchy.query(center, radius, [&](uint32_t leaf)
+	{
+		// Nodes are tested as a whole, so leaves may still be too far
+		const Entry& entry = entries[leafEntries[leaf]];
+		glm::vec3 offset = center - glm::clamp(center, leafBounds[leaf].min, leafBounds[leaf].max);
+		if (entry.object != nullptr && glm::dot(offset, offset) <= radius * radius)
+		{
+			objects.push_back(entry.object);
+		}
+	});
+}
+
+float SceneHierarchy::raycast(const glm::vec3 & origin, const glm::vec3 & direction, float maxDistance) const
+{
+	// Leaf boxes are the hits
+	glm::vec3 inverseDirection = 1.0f / direction;
+	return hierarchy.raycast(origin, direction, maxDistance, [&](uint32_t leaf, float distance)
+	{
+		float entry = Bvh::intersectRay(leafBounds[leaf].min, leafBounds[leaf].max, origin, inverseDirection, distance);
+		return entry != FLT_MAX ? entry : -1.0f;
+	});
+}
+
+Bounds SceneHierarchy::getWorldBounds(const Entry & entry)
+{
+	if (entry.object == nullptr)
+	{
+		return entry.model->getBounds();
+	}
+
+	Bounds bounds;
+	glm::vec3 position = entry.object->getPosition();
+	bounds.min = position;
+	bounds.max = position;
+	if (entry.model->isLoaded())
+	{
+		Bounds modelBounds = entry.model->getBounds();
+		bounds.min = glm::min(bounds.min, modelBounds.min + position);
+		bounds.max = glm::max(bounds.max, modelBounds.max + position);
+	}
+	bounds.sphereCenter = (bounds.min + bounds.max) * 0.5f;
+	bounds.sphereRadius = glm::length(bounds.max - bounds.min) * 0.5f;
+	return bounds;
+}
+
+size_t SceneHierarchy::countLoadedModels(const std::vector<Entry>& entries)
+{
+	size_t count = 0;
+	for (const auto& entry : entries)
+	{
+		if (entry.model->isLoaded())
+		{
+			++count;
+		}
+	}
+	return count;
+}
+
+void SceneHierarchy::rebuild()
+{
+	// Objects are always leaves so they can be found while loading, models once they have their own hierarchy
+	leafEntries.clear();
+	leafBounds.clear();
+	for (unsigned int i = 0; i < entries.size(); ++i)
+	{
+		if (entries[i].object != nullptr || entries[i].model->isLoaded())
+		{
+			leafEntries.push_back(i);
+			leafBounds.push_back(getWorldBounds(entries[i]));
+		}
+	}
+	hierarchy.build(leafBounds.data(), leafBounds.size());
+}
+
+void SceneHierarchy::submitEntry(RenderQueue & queue, ShaderVariants & shaders, const Entry & entry, unsigned int sceneTransform, bool inside) const
+{
+	if (entry.object != nullptr)
+	{
+		entry.object->submit(queue, shaders, queue.addTransform(glm::translate(glm::mat4(), entry.object->getPosition())), inside);
+	}
+	else
+	{
+		entry.model->submit(queue, entry.pass, shaders, sceneTransform, inside);
+	}
+}
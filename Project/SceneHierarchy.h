@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Bvh.h"
+#include "OcclusionCuller.h"
+#include "RenderQueue.h"
+
+class Model3D;
+class HiddenObject;
+class ShaderVariants;
+
+// Top level of the scene's spatial index with one leaf per loaded model and per hidden object, below it every model has
+// its own baked hierarchy over its meshes. Static models are placed at their file coordinates, hidden objects at their
+// positions. Models that are still streaming aren't in the hierarchy yet and are tested mesh by mesh
+class SceneHierarchy
+{
+public:
+	// Adds a static model drawn in the pass
+	void addModel(const Model3D* model, RenderPass pass);
+	void addObject(HiddenObject* object);
+	// Rebuilds the hierarchy when models finished loading and refits it when objects moved. Called once per frame
+	void update();
+	// Queues meshes of models and objects inside of the queue's frustum, each with the shader variant of its material
+	void submit(RenderQueue& queue, ShaderVariants& shaders) const;
+	// Adds occluders of opaque static models inside of the frustum to the culler
+	void addOccluders(OcclusionCuller& culler, const Frustum& frustum) const;
+	// Collects hidden objects whose bounds or position are within the radius
+	void findObjects(const glm::vec3& center, float radius, std::vector<HiddenObject*>& objects) const;
+	// Returns distance to the nearest model or object box hit by the ray, or a negative value if nothing is hit
+	float raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const;
+private:
+	struct Entry
+	{
+		const Model3D* model;
+		HiddenObject* object;   // Null for static models
+		RenderPass pass;
+	};
+
+	std::vector<Entry> entries;
+	Bvh hierarchy;
+	std::vector<unsigned int> leafEntries;   // Entry of every primitive of the hierarchy
+	std::vector<Bounds> leafBounds;
+	size_t loadedModels = 0;
+	// Leaves reached during the last cull, the rest count as culled
+	mutable std::vector<uint8_t> leafVisible;
+
+	// Bounds of the entry in world space. Object bounds include its position, so it can be found before its model is loaded
+	static Bounds getWorldBounds(const Entry& entry);
+	static size_t countLoadedModels(const std::vector<Entry>& entries);
+	void rebuild();
+	// Inside skips the frustum tests of the entry's meshes, for leaves completely within the frustum
+	void submitEntry(RenderQueue& queue, ShaderVariants& shaders, const Entry& entry, unsigned int sceneTransform, bool inside) const;
+};
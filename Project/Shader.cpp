@@ -1,30 +1,217 @@
 #include "Shader.h"
 #include "FileUtil.h"
+#include "ProgramCache.h"
+#include "UniformBuffer.h"
 #include <glad/glad.h>
+#include <algorithm>
+#include <cstring>
 #include <string>
 #include <iostream>
+#include <vector>
+
+// Token of GL_KHR_parallel_shader_compile, the loader is generated without the extension
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
 
 Shader::Shader()
-	: m_compiled(false), m_program(0)
+	: m_compiled(false), m_program(0), m_sortId(0), m_pending(false), m_stageShaders(), m_sourceHash(0)
 {
 }
 
 Shader::~Shader()
 {
+	cancelCompile();
 	if (m_compiled)
 	{
-		glDeleteProgram(m_program);
+		ProgramCache::release(m_program);
 	}
 }
 
 void Shader::compile(const char * vsPath, const char * fsPath, const char* gsPath, const char* tcsPath, const char* tesPath)
 {
+	const char* paths[STAGE_COUNT] = { vsPath, fsPath, gsPath, tcsPath, tesPath };
+	compileProgram(paths, std::string());
+}
+
+void Shader::compile(const char * vsPath, const char * fsPath, const std::vector<std::string>& defines)
+{
+	std::string defineLines;
+	for (const auto& define : defines)
+	{
+		defineLines += "#define " + define + "\n";
+	}
+	const char* paths[STAGE_COUNT] = { vsPath, fsPath, nullptr, nullptr, nullptr };
+	compileProgram(paths, defineLines);
+}
+
+void Shader::compileProgram(const char* const paths[STAGE_COUNT], const std::string& defines)
+{
+	std::string sources[STAGE_COUNT];
+	uint64_t sourceHash = FileUtil::hash(nullptr, 0);
+	for (unsigned int stage = 0; stage < STAGE_COUNT; ++stage)
+	{
+		if (paths[stage] != nullptr)
+		{
+			sources[stage] = loadSource(paths[stage], defines);
+		}
+		// Stage index is hashed too, so the same source in another stage makes a different program
+		sourceHash = FileUtil::hash(&stage, sizeof(stage), sourceHash);
+		sourceHash = FileUtil::hash(sources[stage].data(), sources[stage].size(), sourceHash);
+	}
+
+	// Programs already linked in this process are shared, otherwise binary of an earlier launch saves compiling
+	// Program shared with a shader still compiling it is pending here too, but only that shader checks its logs
+	unsigned int stageShaders[STAGE_COUNT] = {};
+	unsigned int program = ProgramCache::acquire(sourceHash);
+	if (program == 0)
+	{
+		program = ProgramCache::loadBinary(sourceHash);
+		if (program == 0)
+		{
+			program = compileShader(sources, stageShaders);
+		}
+		ProgramCache::insert(sourceHash, program);
+	}
+	// Previous program is released only now, so recompiling the same sources doesn't delete it in between
+	cancelCompile();
+	if (m_compiled)
+	{
+		ProgramCache::release(m_program);
+	}
+	m_program = program;
 	m_compiled = true;
-	m_program = compileShader(vsPath, fsPath, gsPath, tcsPath, tesPath);
+	m_sortId = ProgramCache::getSortId(m_program);
+	m_sourceHash = sourceHash;
+	std::copy(stageShaders, stageShaders + STAGE_COUNT, m_stageShaders);
+	m_pending = true;
+	getPendingShaders().push_back(this);
+}
+
+bool Shader::isReady() const
+{
+	if (!m_pending)
+	{
+		return true;
+	}
+	if (!isParallelCompileSupported())
+	{
+		return false;
+	}
+	GLint completed = GL_FALSE;
+	glGetProgramiv(m_program, GL_COMPLETION_STATUS_KHR, &completed);
+	return completed == GL_TRUE;
+}
+
+void Shader::finishCompile() const
+{
+	if (!m_pending)
+	{
+		return;
+	}
+	completeCompile();
+	auto& pending = getPendingShaders();
+	pending.erase(std::find(pending.begin(), pending.end(), this));
+}
+
+void Shader::finishReadyShaders()
+{
+	auto& pending = getPendingShaders();
+	for (size_t i = 0; i < pending.size();)
+	{
+		if (pending[i]->isReady())
+		{
+			pending[i]->completeCompile();
+			pending[i] = pending.back();
+			pending.pop_back();
+		}
+		else
+		{
+			++i;
+		}
+	}
+}
+
+bool Shader::isParallelCompileSupported()
+{
+	static const bool supported = [] {
+		GLint extensionCount = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+		for (GLint i = 0; i < extensionCount; ++i)
+		{
+			const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+			if (name != nullptr && (strcmp(name, "GL_KHR_parallel_shader_compile") == 0 || strcmp(name, "GL_ARB_parallel_shader_compile") == 0))
+			{
+				return true;
+			}
+		}
+		return false;
+	}();
+	return supported;
+}
+
+void Shader::completeCompile() const
+{
+	static const char* const stageNames[STAGE_COUNT] = { "VERTEX", "FRAGMENT", "GEOMETRY", "TESSELATION CONTROL", "TESSELATION EVALUATION" };
+	static const char* const stageMessages[STAGE_COUNT] = { "Vertex Shader Compiled Successfully", "Fragment Shader Compiled Successfully",
+		"Geometry Shader Compiled Successfully", "Tesselation Control Shader Compiled Successfully", "Tesselation Evaluation Shader Compiled Successfully" };
+
+	bool compiledHere = false;
+	for (unsigned int stage = 0; stage < STAGE_COUNT; ++stage)
+	{
+		if (m_stageShaders[stage] == 0)
+		{
+			continue;
+		}
+		//Check compile errors
+		if (!checkCompileErrors(m_stageShaders[stage], stageNames[stage]))
+		{
+			std::cout << stageMessages[stage] << std::endl;
+		}
+		//Opengl has linked program so we can delete the shaders
+		glDeleteShader(m_stageShaders[stage]);
+		m_stageShaders[stage] = 0;
+		compiledHere = true;
+	}
+	if (compiledHere)
+	{
+		checkCompileErrors(m_program, "PROGRAM");
+		ProgramCache::saveBinary(m_sourceHash, m_program);
+	}
+	m_pending = false;
+
+	reflectUniforms();
+	bindUniformBlocks();
+}
+
+void Shader::cancelCompile()
+{
+	if (!m_pending)
+	{
+		return;
+	}
+	for (unsigned int& stageShader : m_stageShaders)
+	{
+		if (stageShader != 0)
+		{
+			glDeleteShader(stageShader);
+			stageShader = 0;
+		}
+	}
+	m_pending = false;
+	auto& pending = getPendingShaders();
+	pending.erase(std::find(pending.begin(), pending.end(), this));
+}
+
+std::vector<const Shader*>& Shader::getPendingShaders()
+{
+	static std::vector<const Shader*> pending;
+	return pending;
 }
 
 void Shader::bind() const
 {
+	finishCompile();
 	if (m_compiled)
 	{
 		glUseProgram(m_program);
@@ -36,45 +223,70 @@ void Shader::unbind()
 	glUseProgram(0);
 }
 
+void Shader::bindUniform(Uniform<glm::mat4> uniform, const glm::mat4 & mat) const
+{
+	glUniformMatrix4fv(uniform.location, 1, GL_FALSE, glm::value_ptr(mat));
+}
+
+void Shader::bindUniform(Uniform<glm::vec3> uniform, const glm::vec3 & vec) const
+{
+	glUniform3fv(uniform.location, 1, glm::value_ptr(vec));
+}
+
+void Shader::bindUniform(Uniform<glm::vec2> uniform, const glm::vec2 & vec) const
+{
+	glUniform2fv(uniform.location, 1, glm::value_ptr(vec));
+}
+
+void Shader::bindUniform(Uniform<int> uniform, int value) const
+{
+	glUniform1i(uniform.location, value);
+}
+
+void Shader::bindUniform(Uniform<unsigned int> uniform, unsigned int value) const
+{
+	glUniform1ui(uniform.location, value);
+}
+
+void Shader::bindUniform(Uniform<float> uniform, float value) const
+{
+	glUniform1f(uniform.location, value);
+}
+
 void Shader::bindUniform(const char * name, const glm::mat4 & mat) const
 {
-	GLint id = glGetUniformLocation(m_program, name);
-	glUniformMatrix4fv(id, 1, GL_FALSE, glm::value_ptr(mat));
+	bindUniform(getUniform<glm::mat4>(name), mat);
 }
 
 void Shader::bindUniform(const char * name, const glm::vec3 & vec) const
 {
-	GLint id = glGetUniformLocation(m_program, name);
-	glUniform3fv(id, 1, glm::value_ptr(vec));
+	bindUniform(getUniform<glm::vec3>(name), vec);
 }
 
 void Shader::bindUniform(const char * name, const glm::vec2 & vec) const
 {
-	GLint id = glGetUniformLocation(m_program, name);
-	glUniform2fv(id, 1, glm::value_ptr(vec));
+	bindUniform(getUniform<glm::vec2>(name), vec);
 }
 
 void Shader::bindUniform(const char * name, int value) const
 {
-	GLint id = glGetUniformLocation(m_program, name);
-	glUniform1i(id, value);
+	bindUniform(getUniform<int>(name), value);
 }
 
 void Shader::bindUniform(const char * name, unsigned int value) const
 {
-	GLint id = glGetUniformLocation(m_program, name);
-	glUniform1ui(id, value);
+	bindUniform(getUniform<unsigned int>(name), value);
 }
 
 void Shader::bindUniform(const char * name, float value) const
 {
-	GLint id = glGetUniformLocation(m_program, name);
-	glUniform1f(id, value);
+	bindUniform(getUniform<float>(name), value);
 }
 
 Shader::Shader(Shader && shader) noexcept
-	: m_compiled(shader.m_compiled), m_program(shader.m_program)
+	: Shader()
 {
+	*this = std::move(shader);
 }
 
 Shader & Shader::operator=(Shader&& shader) noexcept
@@ -84,113 +296,196 @@ Shader & Shader::operator=(Shader&& shader) noexcept
 		return *this;
 	}
 
+	// Pending list refers to shaders by address, so the moved shader is finished first
+	shader.finishCompile();
+	cancelCompile();
+	if (m_compiled)
+	{
+		ProgramCache::release(m_program);
+	}
 	m_compiled = shader.m_compiled;
 	m_program = shader.m_program;
+	m_sortId = shader.m_sortId;
+	m_sourceHash = shader.m_sourceHash;
+	m_uniformLocations = std::move(shader.m_uniformLocations);
+	m_textureUnits = std::move(shader.m_textureUnits);
+	m_bindings = std::move(shader.m_bindings);
+	shader.m_compiled = false;
 
 	return *this;
 }
 
-unsigned int Shader::compileShader(const char * vsPath, const char * fsPath, const char* gsPath, const char* tcsPath, const char* tesPath)
+void Shader::reflectUniforms() const
 {
-	//Read vertex shader
-	std::string vsSource = FileUtil::loadFile(vsPath);
-	const char* ccVs = vsSource.c_str();
-	//Compile vertex shader
-	GLuint vsShaderId = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vsShaderId, 1, &ccVs, nullptr);
-	glCompileShader(vsShaderId);
-	//Check compile errors
-	if (!checkCompileErrors(vsShaderId, "VERTEX"))
+	m_uniformLocations.clear();
+	m_textureUnits.clear();
+	// Handles resolved for a previous program are no longer valid
+	m_bindings.clear();
+
+	GLint uniformCount = 0;
+	GLint maxNameLength = 0;
+	glGetProgramiv(m_program, GL_ACTIVE_UNIFORMS, &uniformCount);
+	glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+	std::vector<char> nameBuffer(static_cast<size_t>(maxNameLength) + 1);
+	std::vector<std::pair<GLint, int>> samplerUnits;
+	for (GLint i = 0; i < uniformCount; ++i)
 	{
-		std::cout << "Vertex Shader Compiled Successfully" << std::endl;
+		GLsizei nameLength = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(m_program, static_cast<GLuint>(i), static_cast<GLsizei>(nameBuffer.size()), &nameLength, &size, &type, nameBuffer.data());
+		std::string name(nameBuffer.data(), static_cast<size_t>(nameLength));
+
+		// Uniforms in blocks have no location
+		GLint location = glGetUniformLocation(m_program, name.c_str());
+		if (location == -1)
+		{
+			continue;
+		}
+
+		// Arrays are reported once as "name[0]", elements may not have consecutive locations so each one is queried
+		size_t bracket = name.rfind("[0]");
+		if (size > 1 || (bracket != std::string::npos && bracket + 3 == name.size()))
+		{
+			std::string baseName = name.substr(0, bracket);
+			m_uniformLocations[baseName] = location;
+			for (GLint element = 0; element < size; ++element)
+			{
+				std::string elementName = baseName + "[" + std::to_string(element) + "]";
+				m_uniformLocations[elementName] = glGetUniformLocation(m_program, elementName.c_str());
+			}
+		}
+		else
+		{
+			m_uniformLocations[name] = location;
+		}
+
+		if (isSamplerType(type))
+		{
+			// Samplers never change their unit, so materials only bind textures and set no sampler uniforms
+			int unit = static_cast<int>(m_textureUnits.size());
+			m_textureUnits[name] = unit;
+			samplerUnits.emplace_back(location, unit);
+		}
 	}
 
-	//Read fragment shader
-	std::string fsSource = FileUtil::loadFile(fsPath);
-	const char* ccFs = fsSource.c_str();
-	//Compile fragment shader
-	GLuint fsShaderId = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fsShaderId, 1, &ccFs, nullptr);
-	glCompileShader(fsShaderId);
-	//Check compile errors
-	if (!checkCompileErrors(fsShaderId, "FRAGMENT"))
+	// Setting uniforms needs the program in use
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glUseProgram(m_program);
+	for (const auto& sampler : samplerUnits)
 	{
-		std::cout << "Fragment Shader Compiled Successfully" << std::endl;
+		glUniform1i(sampler.first, sampler.second);
 	}
+	glUseProgram(static_cast<GLuint>(previousProgram));
+}
+
+void Shader::bindUniformBlocks() const
+{
+	GLint blockCount = 0;
+	GLint maxNameLength = 0;
+	glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+	glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxNameLength);
 
-	GLuint gsShaderId;
-	if (gsPath != nullptr)
+	std::vector<char> nameBuffer(static_cast<size_t>(maxNameLength) + 1);
+	for (GLint i = 0; i < blockCount; ++i)
 	{
-		//Read geometry shader
-		std::string gsSource = FileUtil::loadFile(gsPath);
-		const char* ccGs = gsSource.c_str();
-		//Compile geometry shader
-		gsShaderId = glCreateShader(GL_GEOMETRY_SHADER);
-		glShaderSource(gsShaderId, 1, &ccGs, nullptr);
-		glCompileShader(gsShaderId);
-		//Check compile errors
-		if (!checkCompileErrors(gsShaderId, "GEOMETRY"))
+		GLsizei nameLength = 0;
+		glGetActiveUniformBlockName(m_program, static_cast<GLuint>(i), static_cast<GLsizei>(nameBuffer.size()), &nameLength, nameBuffer.data());
+		std::string name(nameBuffer.data(), static_cast<size_t>(nameLength));
+
+		unsigned int bindingPoint = UniformBuffer::getBindingPoint(name);
+		if (bindingPoint == UniformBuffer::NO_BINDING_POINT)
 		{
-			std::cout << "Geometry Shader Compiled Successfully" << std::endl;
+			std::cout << "Uniform block " << name << " has no binding point" << std::endl;
+			continue;
 		}
+		glUniformBlockBinding(m_program, static_cast<GLuint>(i), bindingPoint);
 	}
+}
 
-	GLuint tcsShaderId;
-	if (tcsPath != nullptr)
+bool Shader::isSamplerType(unsigned int type)
+{
+	switch (type)
 	{
-		//Read tesselation control shader
-		std::string tcsSource = FileUtil::loadFile(tcsPath);
-		const char* ccTcs = tcsSource.c_str();
-		//Compile tesselation control shader
-		tcsShaderId = glCreateShader(GL_TESS_CONTROL_SHADER);
-		glShaderSource(tcsShaderId, 1, &ccTcs, nullptr);
-		glCompileShader(tcsShaderId);
-		//Check compile errors
-		if (!checkCompileErrors(tcsShaderId, "TESSELATION CONTROL"))
-		{
-			std::cout << "Tesselation Control Shader Compiled Successfully" << std::endl;
-		}
+	case GL_SAMPLER_1D:
+	case GL_SAMPLER_2D:
+	case GL_SAMPLER_3D:
+	case GL_SAMPLER_CUBE:
+	case GL_SAMPLER_2D_SHADOW:
+	case GL_SAMPLER_2D_ARRAY:
+	case GL_SAMPLER_2D_MULTISAMPLE:
+	case GL_SAMPLER_BUFFER:
+	case GL_INT_SAMPLER_BUFFER:
+	case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+		return true;
+	default:
+		return false;
 	}
+}
+
+int Shader::getTextureUnit(const char * name) const
+{
+	finishCompile();
+	auto found = m_textureUnits.find(name);
+	return found != m_textureUnits.end() ? found->second : -1;
+}
 
-	GLuint tesShaderId;
-	if (tesPath != nullptr)
+int Shader::getUniformLocation(const char * name) const
+{
+	finishCompile();
+	auto found = m_uniformLocations.find(name);
+	return found != m_uniformLocations.end() ? found->second : -1;
+}
+
+size_t Shader::allocateBindingSlot()
+{
+	static size_t slotCount = 0;
+	return slotCount++;
+}
+
+std::string Shader::loadSource(const char * path, const std::string & defines)
+{
+	std::string source = FileUtil::loadFile(path);
+	if (defines.empty())
 	{
-		//Read tesselation evaluation shader
-		std::string tesSource = FileUtil::loadFile(tesPath);
-		const char* ccTes = tesSource.c_str();
-		//Compile tesselation evaluation shader
-		tesShaderId = glCreateShader(GL_TESS_EVALUATION_SHADER);
-		glShaderSource(tesShaderId, 1, &ccTes, nullptr);
-		glCompileShader(tesShaderId);
-		//Check compile errors
-		if (!checkCompileErrors(tesShaderId, "TESSELATION EVALUATION"))
-		{
-			std::cout << "Tesselation Evaluation Shader Compiled Successfully" << std::endl;
-		}
+		return source;
+	}
+	size_t version = source.find("#version");
+	size_t lineEnd = version != std::string::npos ? source.find('\n', version) : std::string::npos;
+	if (lineEnd == std::string::npos)
+	{
+		return defines + source;
 	}
+	return source.insert(lineEnd + 1, defines);
+}
 
-	//Create and link shader program
+unsigned int Shader::compileShader(const std::string sources[STAGE_COUNT], unsigned int stageShaders[STAGE_COUNT])
+{
+	static const GLenum stageTypes[STAGE_COUNT] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER, GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER };
+
+	//Create and link shader program from the stages that have source. Nothing is queried here, any query would wait for
+	//the driver to finish, so compiles of all shaders issued in a row run in parallel
 	GLuint program = glCreateProgram();
-	glAttachShader(program, vsShaderId);
-	glAttachShader(program, fsShaderId);
-	if (gsPath != nullptr)
-		glAttachShader(program, gsShaderId);
-	if (tcsPath != nullptr)
-		glAttachShader(program, tcsShaderId);
-	if (tesPath != nullptr)
-		glAttachShader(program, tesShaderId);
+	for (unsigned int stage = 0; stage < STAGE_COUNT; ++stage)
+	{
+		if (sources[stage].empty())
+		{
+			continue;
+		}
+		const char* source = sources[stage].c_str();
+		stageShaders[stage] = glCreateShader(stageTypes[stage]);
+		glShaderSource(stageShaders[stage], 1, &source, nullptr);
+		glCompileShader(stageShaders[stage]);
+		glAttachShader(program, stageShaders[stage]);
+	}
+	// Drivers may only keep what glGetProgramBinary needs when asked before linking
+	if (ProgramCache::isBinarySupported())
+	{
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
 	glLinkProgram(program);
-	checkCompileErrors(program, "PROGRAM");
-
-	//Opengl has linked program so we can delete the copy
-	glDeleteProgram(vsShaderId);
-	glDeleteProgram(fsShaderId);
-	if (gsPath != nullptr)
-		glDeleteProgram(gsShaderId);
-	if (tcsPath != nullptr)
-		glDeleteProgram(tcsShaderId);
-	if (tesPath != nullptr)
-		glDeleteProgram(tesShaderId);
 
 	return program;
 }
@@ -1,20 +1,69 @@
 #pragma once
 
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+// Location of a uniform resolved when the program was linked. Type of the handle selects the glUniform call,
+// location -1 means the program doesn't use the uniform and binding it does nothing
+template <typename T>
+struct Uniform
+{
+	int location = -1;
+
+	bool isActive() const { return location != -1; }
+};
+
 class Shader
 {
 public:
 	Shader();
 	~Shader();
-	// Link and compile shaders, only vertex and fragment shaders are mandatory
+	// Link and compile shaders, only vertex and fragment shaders are mandatory. Active uniforms are reflected after linking,
+	// uniform blocks are attached to their UniformBuffer binding points and every sampler gets its own texture unit.
+	// Shaders with the same sources share one program through ProgramCache, which also loads it from a saved binary.
+	// Compiling and linking is only issued here, the driver finishes it in the background and the shader waits for it
+	// on first use, so every shader of a scene should be compiled up front
 	void compile(const char* vs_path, const char* fs_path, const char* gs_path = nullptr, const char* tcs_path = nullptr, const char* tes_path = nullptr);
+	// Same with every name of the list defined in all stages, right after their #version line
+	void compile(const char* vs_path, const char* fs_path, const std::vector<std::string>& defines);
+	// True once the driver has linked the program, querying it then doesn't stall. Without parallel compile support
+	// this can't be asked without waiting, so it stays false until the shader is used
+	bool isReady() const;
+	// Waits for the program and reflects it, every use of the shader does this first
+	void finishCompile() const;
+	// Finishes shaders whose programs the driver has linked meanwhile, called once per frame during loading
+	static void finishReadyShaders();
+	// True if the driver compiles in background threads and reports progress through GL_COMPLETION_STATUS_KHR
+	static bool isParallelCompileSupported();
 	// Use this shader program for rendering
 	void bind() const;
 	// Set current in-use shader program to default (none) for rendering
 	static void unbind();
-	// Overloaded functions to bind different types of uniforms
+	unsigned int getProgram() const { finishCompile(); return m_program; }
+	// Small number identifying the program in draw sort keys, programs compiled earlier get lower numbers
+	unsigned int getSortId() const { return m_sortId; }
+	// Returns handle of an active uniform, inactive handle if the program doesn't have it. Struct members and array
+	// elements are named as in GLSL, e.g. "dirLight.direction" or "lights[2]"
+	template <typename T> Uniform<T> getUniform(const char* name) const { return Uniform<T>{ getUniformLocation(name) }; }
+	// Returns texture unit assigned to a sampler uniform, -1 if the program has no such sampler
+	int getTextureUnit(const char* name) const;
+	// Returns set of uniform handles resolved for this program. Bindings is a struct constructible from const Shader&,
+	// it is created on the first request and cached, so draw code resolves names only once per program
+	template <typename Bindings> const Bindings& getBindings() const;
+	// Overloaded functions to bind different types of uniforms through precomputed handles
+	void bindUniform(Uniform<glm::mat4> uniform, const glm::mat4& mat) const;
+	void bindUniform(Uniform<glm::vec3> uniform, const glm::vec3& vec) const;
+	void bindUniform(Uniform<glm::vec2> uniform, const glm::vec2& vec) const;
+	void bindUniform(Uniform<int> uniform, int value) const;
+	void bindUniform(Uniform<unsigned int> uniform, unsigned int value) const;
+	void bindUniform(Uniform<float> uniform, float value) const;
+	// Same by name, looked up in the reflected uniform table. Meant for code outside of draw loops
 	void bindUniform(const char* name, const glm::mat4& mat) const;
 	void bindUniform(const char* name, const glm::vec3& vec) const;
 	void bindUniform(const char* name, const glm::vec2& vec) const;
@@ -27,10 +76,65 @@ public:
 	Shader& operator=(const Shader& shader) = delete;
 	Shader& operator=(Shader&& shader) noexcept;
 protected:
-	static unsigned int compileShader(const char* vs_path, const char* fs_path, const char* gs_path, const char* tcs_path, const char* tes_path);
+	// Vertex, fragment, geometry, tesselation control and tesselation evaluation
+	static const unsigned int STAGE_COUNT = 5;
+
+	// Issues compiling and linking of stages with non-empty source and returns the program right away. Created stage
+	// shaders are stored to stageShaders, errors are checked once the shader finishes
+	static unsigned int compileShader(const std::string sources[STAGE_COUNT], unsigned int stageShaders[STAGE_COUNT]);
+	// Reads shader source and inserts the define lines after its #version line, which must stay the first statement
+	static std::string loadSource(const char* path, const std::string& defines);
 	// Utility method that checks and prints compile errors if any for shaders and program itself
 	static bool checkCompileErrors(unsigned int shader, const char* type);
 private:
 	bool m_compiled;
 	unsigned int m_program;
-};
\ No newline at end of file
+	unsigned int m_sortId;
+	// Program may still be compiling, uniforms aren't reflected yet
+	mutable bool m_pending;
+	// Stage shaders this shader compiled, kept for their logs until the program is finished
+	mutable unsigned int m_stageShaders[STAGE_COUNT];
+	// Hash of the sources, binary of the program is saved under it by the shader that compiled it
+	uint64_t m_sourceHash;
+	// Locations of all active uniforms by name, arrays are also registered under their name without "[0]"
+	mutable std::unordered_map<std::string, int> m_uniformLocations;
+	// Texture units of sampler uniforms by name, fixed at link time
+	mutable std::unordered_map<std::string, int> m_textureUnits;
+	// Cached binding structs indexed by their slot, created lazily by getBindings
+	mutable std::vector<std::shared_ptr<void>> m_bindings;
+
+	// Takes program of the stage sources from the cache or compiles it, then reflects its uniforms and attaches its blocks.
+	// Null paths are stages the program doesn't have
+	void compileProgram(const char* const paths[STAGE_COUNT], const std::string& defines);
+	// Reports compile errors, saves the binary of a program compiled by this shader and reflects it
+	void completeCompile() const;
+	// Drops unfinished compile of this shader, its program is still released by the caller
+	void cancelCompile();
+	// Fills location table from the active uniforms of the linked program and assigns texture units to samplers
+	void reflectUniforms() const;
+	// Attaches active uniform blocks to the binding points of their names
+	void bindUniformBlocks() const;
+	// Shaders which were compiled but not finished yet
+	static std::vector<const Shader*>& getPendingShaders();
+	static bool isSamplerType(unsigned int type);
+	int getUniformLocation(const char* name) const;
+	// Gives every binding struct type its own index into m_bindings
+	static size_t allocateBindingSlot();
+};
+
+template<typename Bindings>
+const Bindings & Shader::getBindings() const
+{
+	static const size_t slot = allocateBindingSlot();
+	// Finishing reflects the program, which drops bindings resolved before
+	finishCompile();
+	if (slot >= m_bindings.size())
+	{
+		m_bindings.resize(slot + 1);
+	}
+	if (!m_bindings[slot])
+	{
+		m_bindings[slot] = std::make_shared<Bindings>(*this);
+	}
+	return *static_cast<const Bindings*>(m_bindings[slot].get());
+}
@@ -0,0 +1,44 @@
+#include "ShaderVariants.h"
+
+ShaderVariants::ShaderVariants(const char* vertexPath, const char* fragmentPath) : vertexPath(vertexPath), fragmentPath(fragmentPath)
+{
+}
+
+const Shader & ShaderVariants::get(uint32_t features)
+{
+	uint32_t bits = (features | sceneFeatures) & ((1u << FEATURE_COUNT) - 1);
+	std::unique_ptr<Shader>& variant = variants[bits];
+	if (!variant)
+	{
+		variant.reset(new Shader());
+		variant->compile(vertexPath.c_str(), fragmentPath.c_str(), getDefines(bits));
+	}
+	return *variant;
+}
+
+unsigned int ShaderVariants::getCompiledCount() const
+{
+	unsigned int count = 0;
+	for (const auto& variant : variants)
+	{
+		if (variant)
+		{
+			++count;
+		}
+	}
+	return count;
+}
+
+std::vector<std::string> ShaderVariants::getDefines(uint32_t features)
+{
+	static const char* const names[FEATURE_COUNT] = { "HAS_SPECULAR_MAP", "ALPHA_TEST", "NO_SPOTLIGHT", "NO_CLUSTERED_LIGHTS" };
+	std::vector<std::string> defines;
+	for (unsigned int i = 0; i < FEATURE_COUNT; ++i)
+	{
+		if (features & (1u << i))
+		{
+			defines.push_back(names[i]);
+		}
+	}
+	return defines;
+}
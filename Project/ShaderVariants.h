@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Shader.h"
+
+// Permutations of one vertex and fragment shader pair. Every feature bit set for a variant is compiled in as a #define
+// of its name, so code of the features a variant lacks is removed by the preprocessor instead of branched over per
+// fragment. Materials select their bits when they are loaded, the scene adds bits of its lights to every variant.
+// Variants are compiled on first use and cached by their bits. Must only be used on the GL thread
+class ShaderVariants
+{
+public:
+	enum Feature : uint32_t
+	{
+		HAS_SPECULAR_MAP = 1u << 0,     // Material has its own specular map, otherwise the diffuse map is used
+		ALPHA_TEST = 1u << 1,           // Fragments of almost transparent texels are discarded
+		NO_SPOTLIGHT = 1u << 2,         // Scene has no flashlight
+		NO_CLUSTERED_LIGHTS = 1u << 3   // Scene has no point or spot lights, clusters aren't read
+	};
+	static const unsigned int FEATURE_COUNT = 4;
+
+	ShaderVariants(const char* vertexPath, const char* fragmentPath);
+	// Bits added to the bits of every requested variant. Variants compiled before keep their bits
+	void setSceneFeatures(uint32_t features) { sceneFeatures = features; }
+	uint32_t getSceneFeatures() const { return sceneFeatures; }
+	// Variant with the features and the scene features, compiled if it's the first request
+	const Shader& get(uint32_t features);
+	// Number of variants compiled so far
+	unsigned int getCompiledCount() const;
+	// Names of the defines of the feature bits
+	static std::vector<std::string> getDefines(uint32_t features);
+
+	ShaderVariants(const ShaderVariants& variants) = delete;
+	ShaderVariants& operator=(const ShaderVariants& variants) = delete;
+private:
+	std::string vertexPath;
+	std::string fragmentPath;
+	uint32_t sceneFeatures = 0;
+	// Indexed by the feature bits, there are few enough combinations for a flat table
+	std::unique_ptr<Shader> variants[1u << FEATURE_COUNT];
+};
@@ -3,7 +3,10 @@
 #include <glad/glad.h>
 #include <stb_image/stb_image.h>
 
-SkyBoxModel::SkyBoxModel(const std::vector<std::string>& faces) : vertices{    
+#include "AssetLoader.h"
+#include "TextureCache.h"
+
+SkyBoxModel::SkyBoxModel(const std::vector<std::string>& faces, bool streamed) : vertices{    
 	-1.0f,  1.0f, -1.0f,
 	-1.0f, -1.0f, -1.0f,
 	 1.0f, -1.0f, -1.0f,
@@ -48,8 +51,27 @@ SkyBoxModel::SkyBoxModel(const std::vector<std::string>& faces) : vertices{
 }
 {
 	createSkyBox();
-	texture.id = loadCubemapTexture(faces);
-	
+	// Cubemap is cached under the list of its faces
+	std::string cacheKey;
+	for (const auto& face : faces)
+	{
+		cacheKey += TextureCache::canonicalPath(face) + "|";
+	}
+	if (streamed)
+	{
+		texture.id = AssetLoader::shared().requestCubemap(cacheKey, faces);
+	}
+	else
+	{
+		texture.id = TextureCache::load(cacheKey, [&faces](const std::string&) { return loadCubemapTexture(faces); });
+	}
+}
+
+SkyBoxModel::~SkyBoxModel()
+{
+	glDeleteVertexArrays(1, &vao);
+	glDeleteBuffers(1, &vbo);
+	TextureCache::release(texture.id);
 }
 
 void SkyBoxModel::render(const Shader & shader) const
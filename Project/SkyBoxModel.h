@@ -9,8 +9,9 @@
 class SkyBoxModel : public Model
 {
 public:
-	// Create skybox from 6 textures
-	SkyBoxModel(const std::vector<std::string>& faces);
+	// Create skybox from 6 textures. Streamed skybox shows a placeholder until AssetLoader uploads its faces
+	SkyBoxModel(const std::vector<std::string>& faces, bool streamed = false);
+	~SkyBoxModel();
 	void render(const Shader& shader) const override;
 protected:
 	unsigned int vao, vbo;
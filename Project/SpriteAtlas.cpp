@@ -0,0 +1,185 @@
+#include "SpriteAtlas.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include <glad/glad.h>
+#include <stb_image/stb_image.h>
+
+#include "AtlasPacker.h"
+#include "FileUtil.h"
+#include "Model.h"
+#include "TextureCache.h"
+#include "tinyxml2.h"
+
+using namespace tinyxml2;
+
+const char* const SpriteAtlas::HUD_ATLAS_PATH = "../Assets/hud_atlas";
+
+SpriteAtlas::SpriteAtlas() : textureID(0), cooked(false)
+{
+}
+
+SpriteAtlas::~SpriteAtlas()
+{
+	release();
+}
+
+bool SpriteAtlas::load(const std::string & path, const std::vector<std::string>& spritePaths)
+{
+	release();
+	if (loadCooked(path, spritePaths))
+	{
+		return true;
+	}
+	return packSprites(spritePaths);
+}
+
+const SpriteAtlas::Sprite * SpriteAtlas::findSprite(const std::string & spritePath) const
+{
+	auto found = sprites.find(spriteName(spritePath));
+	return found != sprites.end() ? &found->second : nullptr;
+}
+
+bool SpriteAtlas::loadCooked(const std::string & path, const std::vector<std::string>& spritePaths)
+{
+	std::string texturePath = path + ".dds";
+	std::string descriptorPath = path + ".xml";
+	if (!FileUtil::fileExists(texturePath) || !FileUtil::fileExists(descriptorPath))
+	{
+		return false;
+	}
+	// Images edited after the atlas was cooked would still show their old version
+	bool upToDate = std::all_of(spritePaths.begin(), spritePaths.end(), [&](const std::string& spritePath)
+	{
+		return FileUtil::isUpToDate(spritePath, texturePath) && FileUtil::isUpToDate(spritePath, descriptorPath);
+	});
+	if (!upToDate)
+	{
+		std::cout << "Sprite atlas " << path << " is out of date, run TextureCooker" << std::endl;
+		return false;
+	}
+
+	XMLDocument document;
+	document.LoadFile(descriptorPath.c_str());
+	XMLElement* atlasElement = document.Error() ? nullptr : document.FirstChildElement("Atlas");
+	if (atlasElement == nullptr)
+	{
+		std::cout << "Unable to load " << descriptorPath << std::endl;
+		return false;
+	}
+	float width = static_cast<float>(atlasElement->IntAttribute("width"));
+	float height = static_cast<float>(atlasElement->IntAttribute("height"));
+	if (width <= 0.0f || height <= 0.0f)
+	{
+		return false;
+	}
+
+	for (XMLElement* spriteElement = atlasElement->FirstChildElement("Sprite"); spriteElement != nullptr; spriteElement = spriteElement->NextSiblingElement("Sprite"))
+	{
+		const char* name = spriteElement->Attribute("name");
+		if (name == nullptr)
+		{
+			continue;
+		}
+		float x = static_cast<float>(spriteElement->IntAttribute("x"));
+		float y = static_cast<float>(spriteElement->IntAttribute("y"));
+		Sprite sprite;
+		sprite.uvMin = glm::vec2(x / width, y / height);
+		sprite.uvMax = glm::vec2((x + spriteElement->IntAttribute("width")) / width, (y + spriteElement->IntAttribute("height")) / height);
+		sprites[spriteName(name)] = sprite;
+	}
+	bool complete = std::all_of(spritePaths.begin(), spritePaths.end(), [this](const std::string& spritePath) { return findSprite(spritePath) != nullptr; });
+	if (!complete)
+	{
+		std::cout << "Sprite atlas " << path << " is out of date, run TextureCooker" << std::endl;
+		sprites.clear();
+		return false;
+	}
+
+	textureID = TextureCache::load(texturePath, [](const std::string& path) { return Model::loadDDS(path.c_str()); });
+	cooked = true;
+	return true;
+}
+
+bool SpriteAtlas::packSprites(const std::vector<std::string>& spritePaths)
+{
+	// Decoded to RGBA, so every sprite can be copied into the atlas the same way
+	std::vector<unsigned char*> images(spritePaths.size(), nullptr);
+	std::vector<AtlasPacker::Rect> rects(spritePaths.size());
+	for (size_t i = 0; i < spritePaths.size(); ++i)
+	{
+		int components;
+		images[i] = stbi_load(spritePaths[i].c_str(), &rects[i].width, &rects[i].height, &components, 4);
+		if (images[i] == nullptr)
+		{
+			std::cout << "Texture failed to load at path: " << spritePaths[i] << std::endl;
+			rects[i].width = 0;
+			rects[i].height = 0;
+		}
+	}
+
+	int width = 0;
+	int height = 0;
+	bool packed = AtlasPacker::pack(rects, AtlasPacker::SPRITE_PADDING, AtlasPacker::MAX_ATLAS_SIZE, width, height);
+	if (packed)
+	{
+		std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * 4, 0);
+		for (size_t i = 0; i < spritePaths.size(); ++i)
+		{
+			if (images[i] == nullptr)
+			{
+				continue;
+			}
+			AtlasPacker::copyImage(pixels, width, height, images[i], rects[i], AtlasPacker::SPRITE_PADDING);
+			Sprite sprite;
+			sprite.uvMin = glm::vec2(static_cast<float>(rects[i].x) / width, static_cast<float>(rects[i].y) / height);
+			sprite.uvMax = glm::vec2(static_cast<float>(rects[i].x + rects[i].width) / width, static_cast<float>(rects[i].y + rects[i].height) / height);
+			sprites[spriteName(spritePaths[i])] = sprite;
+		}
+
+		// Pixels stay in the vector, image only describes them
+		ImageData image;
+		image.width = width;
+		image.height = height;
+		image.components = 4;
+		textureID = Model::createTexture(image);
+		Model::setTextureImage(textureID, image, pixels.data());
+		cooked = false;
+	}
+	else
+	{
+		std::cout << "Sprites don't fit into " << AtlasPacker::MAX_ATLAS_SIZE << "x" << AtlasPacker::MAX_ATLAS_SIZE << " atlas" << std::endl;
+	}
+
+	for (auto pixels : images)
+	{
+		stbi_image_free(pixels);
+	}
+	return packed;
+}
+
+void SpriteAtlas::release()
+{
+	if (textureID != 0)
+	{
+		if (cooked)
+		{
+			TextureCache::release(textureID);
+		}
+		else
+		{
+			glDeleteTextures(1, &textureID);
+		}
+	}
+	textureID = 0;
+	cooked = false;
+	sprites.clear();
+}
+
+std::string SpriteAtlas::spriteName(const std::string & spritePath)
+{
+	std::string name = spritePath;
+	std::replace(name.begin(), name.end(), '\\', '/');
+	return name;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Texture holding many 2D images, so HUD elements using any of them can be drawn together. TextureCooker packs the
+// atlas and writes it as <path>.dds with a <path>.xml list of sprite rects. Sprites are named by the path of their
+// source image, as written in the game data
+class SpriteAtlas
+{
+public:
+	// Area of one sprite in texture coordinates, min is its top left corner
+	struct Sprite
+	{
+		glm::vec2 uvMin;
+		glm::vec2 uvMax;
+	};
+
+	SpriteAtlas();
+	~SpriteAtlas();
+	// Loads cooked atlas at path. When it isn't cooked, misses some of the sprites or is older than any of their source
+	// images, all of them are packed from the source images instead. Returns false if no atlas could be made
+	bool load(const std::string& path, const std::vector<std::string>& spritePaths);
+	// Returns sprite of the source image, nullptr if the atlas doesn't have it
+	const Sprite* findSprite(const std::string& spritePath) const;
+	unsigned int getTexture() const { return textureID; }
+
+	// Atlas of the HUD icons and the city map
+	static const char* const HUD_ATLAS_PATH;
+
+	SpriteAtlas(const SpriteAtlas& atlas) = delete;
+	SpriteAtlas& operator=(const SpriteAtlas& atlas) = delete;
+private:
+	std::unordered_map<std::string, Sprite> sprites;
+	unsigned int textureID;
+	// Cooked texture is shared through TextureCache, atlas packed at runtime belongs to this object
+	bool cooked;
+
+	// Loads the cooked atlas only if it has all of the sprites and is up to date with their source images
+	bool loadCooked(const std::string& path, const std::vector<std::string>& spritePaths);
+	bool packSprites(const std::vector<std::string>& spritePaths);
+	void release();
+	// Sprite names use forward slashes so paths written either way find the same sprite
+	static std::string spriteName(const std::string& spritePath);
+};
@@ -0,0 +1,69 @@
+#include "SpriteBatch.h"
+
+#include "SpriteAtlas.h"
+
+SpriteBatch::SpriteBatch(const SpriteAtlas & atlas) : atlas(atlas)
+{
+}
+
+void SpriteBatch::render(const Shader &) const
+{
+	if (dirty)
+	{
+		upload();
+	}
+	// Draw call for all visible sprites
+	quadBuffer.draw(atlas.getTexture());
+}
+
+size_t SpriteBatch::addSprite(const std::string & spritePath, float x, float y, float width, float height, bool visible)
+{
+	Quad quad;
+	quad.position = glm::vec2(x, y);
+	quad.size = glm::vec2(width, height);
+	quad.visible = visible;
+	const SpriteAtlas::Sprite* sprite = atlas.findSprite(spritePath);
+	quad.valid = sprite != nullptr;
+	if (quad.valid)
+	{
+		quad.uvMin = sprite->uvMin;
+		quad.uvMax = sprite->uvMax;
+	}
+	quads.push_back(quad);
+	dirty = dirty || (quad.valid && visible);
+	return quads.size() - 1;
+}
+
+void SpriteBatch::setVisible(size_t slot, bool visible)
+{
+	if (slot < quads.size() && quads[slot].visible != visible)
+	{
+		quads[slot].visible = visible;
+		dirty = dirty || quads[slot].valid;
+	}
+}
+
+void SpriteBatch::setPosition(size_t slot, float x, float y)
+{
+	if (slot < quads.size() && quads[slot].position != glm::vec2(x, y))
+	{
+		quads[slot].position = glm::vec2(x, y);
+		dirty = dirty || (quads[slot].valid && quads[slot].visible);
+	}
+}
+
+void SpriteBatch::upload() const
+{
+	// Room for every quad, hidden ones included, so showing them later doesn't grow anything
+	batchVertices.reserve(quads.size() * 6);
+	batchVertices.clear();
+	for (const auto& quad : quads)
+	{
+		if (quad.valid && quad.visible)
+		{
+			QuadBuffer::addQuad(batchVertices, quad.position, quad.size, quad.uvMin, quad.uvMax);
+		}
+	}
+	quadBuffer.upload(batchVertices, quads.size() * 6);
+	dirty = false;
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Model.h"
+#include "QuadBuffer.h"
+
+#include <glm/glm.hpp>
+
+class SpriteAtlas;
+
+// Screen space quads showing sprites of one atlas, all of them are drawn in a single call with one blend state.
+// Every quad has its own slot and the vertices are uploaded again only after a quad changes. Quads needed later can be
+// added hidden up front, showing and moving them then never allocates
+class SpriteBatch : public Model
+{
+public:
+	// Atlas must outlive the batch
+	explicit SpriteBatch(const SpriteAtlas& atlas);
+	// Render all visible sprites using passed shader
+	void render(const Shader&) const override;
+	// Adds quad showing sprite of the source image with left bottom corner at x,y and returns its slot. Quads of sprites
+	// the atlas doesn't have are never drawn
+	size_t addSprite(const std::string& spritePath, float x, float y, float width, float height, bool visible = true);
+	// Shows or hides quad of the slot, hidden quads keep their slot
+	void setVisible(size_t slot, bool visible);
+	// Moves left bottom corner of the quad to x,y
+	void setPosition(size_t slot, float x, float y);
+	size_t getSpriteCount() const { return quads.size(); }
+
+	SpriteBatch(const SpriteBatch& batch) = delete;
+	SpriteBatch& operator=(const SpriteBatch& batch) = delete;
+private:
+	struct Quad
+	{
+		glm::vec2 position;
+		glm::vec2 size;
+		glm::vec2 uvMin;
+		glm::vec2 uvMax;
+		bool visible;
+		bool valid;
+	};
+
+	const SpriteAtlas& atlas;
+	mutable QuadBuffer quadBuffer;      // Vertices of visible quads
+
+	std::vector<Quad> quads;
+	// Set when a visible quad was added or changed since the last upload
+	mutable bool dirty = false;
+	mutable std::vector<QuadBuffer::Vertex> batchVertices;
+
+	// Uploads vertices of visible quads into the quad buffer
+	void upload() const;
+};
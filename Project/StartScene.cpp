@@ -30,12 +30,11 @@ void StartScene::render(float deltaTime)
 	float fontSize = 26.0f;
 	float x = window->getScreenWidth() / 2 - fontSize * 22;
 	float y = window->getScreenHeight() - fontSize * 7;
-	textModel->setTextToRender("Enter your name and press Enter to start game", x, y, fontSize);
-	textModel->render(shader);
-	// Render user input
+	textModel->setText(0, "Enter your name and press Enter to start game", x, y, fontSize);
+	// Render user input, both strings are laid out only when they change and drawn together
 	x = window->getScreenWidth() / 2 - fontSize * userInput.length() / 2;
 	y = window->getScreenHeight() - fontSize * 10;
-	textModel->setTextToRender(userInput, x, y, fontSize);
+	textModel->setText(1, userInput, x, y, fontSize);
 	textModel->render(shader);
 
 	shader.unbind();
@@ -0,0 +1,163 @@
+#include "StateTracker.h"
+
+#include <glad/glad.h>
+
+StateTracker::StateTracker() : issuedCalls(0), skippedCalls(0)
+{
+	invalidate();
+}
+
+void StateTracker::invalidate()
+{
+	program = UNKNOWN;
+	vertexArray = UNKNOWN;
+	activeTexture = UNKNOWN;
+	for (unsigned int i = 0; i < MAX_TEXTURE_UNITS; ++i)
+	{
+		textures[i] = UNKNOWN;
+		textureTargets[i] = UNKNOWN;
+	}
+	blendEnabled = UNKNOWN;
+	blendSource = UNKNOWN;
+	blendDestination = UNKNOWN;
+	depthFunction = UNKNOWN;
+	depthWrite = UNKNOWN;
+	colorWrite = UNKNOWN;
+	for (auto& range : uniformBuffers)
+	{
+		range = { UNKNOWN, 0, 0 };
+	}
+}
+
+void StateTracker::useProgram(unsigned int newProgram)
+{
+	if (changes(program, newProgram))
+	{
+		glUseProgram(newProgram);
+	}
+}
+
+void StateTracker::bindVertexArray(unsigned int newVertexArray)
+{
+	if (changes(vertexArray, newVertexArray))
+	{
+		glBindVertexArray(newVertexArray);
+	}
+}
+
+void StateTracker::bindTexture(unsigned int unit, unsigned int target, unsigned int texture)
+{
+	// Units beyond the tracked range are always bound
+	if (unit >= MAX_TEXTURE_UNITS)
+	{
+		setActiveTexture(unit);
+		glBindTexture(target, texture);
+		++issuedCalls;
+		return;
+	}
+
+	if (textures[unit] == texture && textureTargets[unit] == target)
+	{
+		++skippedCalls;
+		return;
+	}
+	setActiveTexture(unit);
+	glBindTexture(target, texture);
+	textures[unit] = texture;
+	textureTargets[unit] = target;
+	++issuedCalls;
+}
+
+void StateTracker::resetActiveTexture()
+{
+	setActiveTexture(0);
+}
+
+void StateTracker::setBlend(bool enabled, unsigned int sourceFactor, unsigned int destinationFactor)
+{
+	if (changes(blendEnabled, enabled ? 1 : 0))
+	{
+		if (enabled)
+		{
+			glEnable(GL_BLEND);
+		}
+		else
+		{
+			glDisable(GL_BLEND);
+		}
+	}
+
+	// Factors don't matter while blending is disabled
+	if (!enabled)
+	{
+		return;
+	}
+	if (blendSource != sourceFactor || blendDestination != destinationFactor)
+	{
+		glBlendFunc(sourceFactor, destinationFactor);
+		blendSource = sourceFactor;
+		blendDestination = destinationFactor;
+		++issuedCalls;
+	}
+	else
+	{
+		++skippedCalls;
+	}
+}
+
+void StateTracker::setDepth(unsigned int function, bool write)
+{
+	if (changes(depthFunction, function))
+	{
+		glDepthFunc(function);
+	}
+	if (changes(depthWrite, write ? 1 : 0))
+	{
+		glDepthMask(write ? GL_TRUE : GL_FALSE);
+	}
+}
+
+void StateTracker::setColorWrite(bool enabled)
+{
+	if (changes(colorWrite, enabled ? 1 : 0))
+	{
+		GLboolean mask = enabled ? GL_TRUE : GL_FALSE;
+		glColorMask(mask, mask, mask, mask);
+	}
+}
+
+void StateTracker::bindUniformBufferRange(unsigned int bindingPoint, unsigned int buffer, size_t offset, size_t size)
+{
+	if (bindingPoint < MAX_UNIFORM_BUFFER_BINDINGS)
+	{
+		BufferRange& range = uniformBuffers[bindingPoint];
+		if (range.buffer == buffer && range.offset == offset && range.size == size)
+		{
+			++skippedCalls;
+			return;
+		}
+		range = { buffer, offset, size };
+	}
+	glBindBufferRange(GL_UNIFORM_BUFFER, bindingPoint, buffer, offset, size);
+	++issuedCalls;
+}
+
+void StateTracker::setActiveTexture(unsigned int unit)
+{
+	if (changes(activeTexture, unit))
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+	}
+}
+
+bool StateTracker::changes(unsigned int & current, unsigned int value)
+{
+	if (current == value)
+	{
+		++skippedCalls;
+		return false;
+	}
+	current = value;
+	++issuedCalls;
+	return true;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+
+// Remembers GL state set through it and skips calls that wouldn't change anything. It doesn't see state changed
+// directly through GL, so whoever does that must call invalidate() before the tracker is used again
+class StateTracker
+{
+public:
+	static const unsigned int MAX_TEXTURE_UNITS = 16;
+	static const unsigned int MAX_UNIFORM_BUFFER_BINDINGS = 8;
+
+	StateTracker();
+	// Forgets all remembered state, the next call of every kind goes to GL
+	void invalidate();
+	void useProgram(unsigned int program);
+	void bindVertexArray(unsigned int vertexArray);
+	void bindTexture(unsigned int unit, unsigned int target, unsigned int texture);
+	// Leaves texture unit 0 active, code drawing without the tracker expects it
+	void resetActiveTexture();
+	void setBlend(bool enabled, unsigned int sourceFactor, unsigned int destinationFactor);
+	// Depth comparison function and whether passing fragments write depth, the depth test itself isn't touched
+	void setDepth(unsigned int function, bool write);
+	// Whether fragments write color, all channels at once
+	void setColorWrite(bool enabled);
+	void bindUniformBufferRange(unsigned int bindingPoint, unsigned int buffer, size_t offset, size_t size);
+
+	// Calls issued to GL and skipped as redundant since construction
+	unsigned int getIssuedCalls() const { return issuedCalls; }
+	unsigned int getSkippedCalls() const { return skippedCalls; }
+private:
+	// Value no GL object or enum has, marks state as unknown
+	static const unsigned int UNKNOWN = ~0u;
+
+	struct BufferRange
+	{
+		unsigned int buffer;
+		size_t offset;
+		size_t size;
+	};
+
+	unsigned int program;
+	unsigned int vertexArray;
+	unsigned int activeTexture;
+	unsigned int textures[MAX_TEXTURE_UNITS];
+	unsigned int textureTargets[MAX_TEXTURE_UNITS];
+	unsigned int blendEnabled;
+	unsigned int blendSource;
+	unsigned int blendDestination;
+	unsigned int depthFunction;
+	unsigned int depthWrite;
+	unsigned int colorWrite;
+	BufferRange uniformBuffers[MAX_UNIFORM_BUFFER_BINDINGS];
+	unsigned int issuedCalls;
+	unsigned int skippedCalls;
+
+	void setActiveTexture(unsigned int unit);
+	// Counts the call and returns true if the remembered value differs, in which case it's updated
+	bool changes(unsigned int& current, unsigned int value);
+};
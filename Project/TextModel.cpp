@@ -1,108 +1,91 @@
 #include "TextModel.h"
 
-#include <glad/glad.h>
+#include "TextureCache.h"
 
 TextModel::TextModel(const std::string & fontTexturePath)
 {
-	// Initialize texture
-	text2DTextureID = loadDDS(fontTexturePath.c_str());
-
-	glGenVertexArrays(1, &vao);
-	// Initialize VBO
-	glGenBuffers(1, &text2DVertexBufferID);
-	glGenBuffers(1, &text2DUVBufferID);
+	// Initialize texture, font is shared by all scenes through the texture cache
+	text2DTextureID = TextureCache::load(fontTexturePath, [](const std::string& path) { return loadDDS(path.c_str()); });
 }
 
 TextModel::~TextModel()
 {
-	glDeleteVertexArrays(1, &vao);
-	// Delete buffers
-	glDeleteBuffers(1, &text2DVertexBufferID);
-	glDeleteBuffers(1, &text2DUVBufferID);
+	// Release texture
+	TextureCache::release(text2DTextureID);
+}
 
-	// Delete texture
-	glDeleteTextures(1, &text2DTextureID);
+void TextModel::render(const Shader &) const
+{
+	if (dirty)
+	{
+		upload();
+	}
+	// Draw call for all strings of the batch
+	quadBuffer.draw(text2DTextureID);
 }
 
-void TextModel::render(const Shader & shader) const
+void TextModel::setText(size_t slot, const std::string & text, float x, float y, float size)
 {
-	if (vertices.size() == 0)
+	if (slot >= entries.size())
+	{
+		entries.resize(slot + 1);
+	}
+	TextEntry& entry = entries[slot];
+	if (entry.text == text && entry.x == x && entry.y == y && entry.size == size)
 	{
 		return;
 	}
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-	glBindVertexArray(vao);
-
-	// Bind texture
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, text2DTextureID);	
-
-	// Draw call
-	glDrawArrays(GL_TRIANGLES, 0, vertices.size());
-
-	glBindVertexArray(0);
-
-	glDisable(GL_BLEND);
+	entry.text = text;
+	entry.x = x;
+	entry.y = y;
+	entry.size = size;
+	layoutText(entry);
+	dirty = true;
 }
 
-void TextModel::setTextToRender(const std::string & text, int x, int y, int size)
+void TextModel::clearText(size_t slot)
 {
-	// Fill buffers
-	vertices.clear();
-	std::vector<glm::vec2> UVs;
-	for (unsigned int i = 0; i < text.length(); i++) {
-
-		glm::vec2 vertex_up_left = glm::vec2(x + i * size, y + size);
-		glm::vec2 vertex_up_right = glm::vec2(x + i * size + size, y + size);
-		glm::vec2 vertex_down_right = glm::vec2(x + i * size + size, y);
-		glm::vec2 vertex_down_left = glm::vec2(x + i * size, y);
+	if (slot < entries.size() && !entries[slot].text.empty())
+	{
+		entries[slot] = TextEntry();
+		dirty = true;
+	}
+}
 
-		// A square is transformed into two triangles
-		vertices.push_back(vertex_up_left);
-		vertices.push_back(vertex_down_left);
-		vertices.push_back(vertex_up_right);
+void TextModel::clearTextFrom(size_t first)
+{
+	for (size_t slot = first; slot < entries.size(); ++slot)
+	{
+		clearText(slot);
+	}
+}
 
-		vertices.push_back(vertex_down_right);
-		vertices.push_back(vertex_up_right);
-		vertices.push_back(vertex_down_left);
+void TextModel::upload() const
+{
+	batchVertices.clear();
+	for (const auto& entry : entries)
+	{
+		batchVertices.insert(batchVertices.end(), entry.vertices.begin(), entry.vertices.end());
+	}
+	quadBuffer.upload(batchVertices);
+	dirty = false;
+}
 
-		char character = text[i];
+void TextModel::layoutText(TextEntry & entry)
+{
+	entry.vertices.clear();
+	entry.vertices.reserve(entry.text.length() * 6);
+	const float x = entry.x;
+	const float y = entry.y;
+	const float size = entry.size;
+	for (unsigned int i = 0; i < entry.text.length(); i++) {
+
+		char character = entry.text[i];
 		float uv_x = (character % 16) / 16.0f;
 		float uv_y = (character / 16) / 16.0f;
 
-		glm::vec2 uv_up_left = glm::vec2(uv_x, uv_y);
-		glm::vec2 uv_up_right = glm::vec2(uv_x + 1.0f / 16.0f, uv_y);
-		glm::vec2 uv_down_right = glm::vec2(uv_x + 1.0f / 16.0f, (uv_y + 1.0f / 16.0f));
-		glm::vec2 uv_down_left = glm::vec2(uv_x, (uv_y + 1.0f / 16.0f));
-		UVs.push_back(uv_up_left);
-		UVs.push_back(uv_down_left);
-		UVs.push_back(uv_up_right);
-
-		UVs.push_back(uv_down_right);
-		UVs.push_back(uv_up_right);
-		UVs.push_back(uv_down_left);
+		// Font texture is a 16x16 grid of characters
+		QuadBuffer::addQuad(entry.vertices, glm::vec2(x + i * size, y), glm::vec2(size), glm::vec2(uv_x, uv_y), glm::vec2(uv_x + 1.0f / 16.0f, uv_y + 1.0f / 16.0f));
 	}
-
-	glBindVertexArray(vao);
-	// Load data into vertex buffers
-	glBindBuffer(GL_ARRAY_BUFFER, text2DVertexBufferID);
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec2), &vertices[0], GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, text2DUVBufferID);
-	glBufferData(GL_ARRAY_BUFFER, UVs.size() * sizeof(glm::vec2), &UVs[0], GL_STATIC_DRAW);
-
-	// 1rst attribute buffer : vertices
-	glEnableVertexAttribArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, text2DVertexBufferID);
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
-
-	// 2nd attribute buffer : UVs
-	glEnableVertexAttribArray(1);
-	glBindBuffer(GL_ARRAY_BUFFER, text2DUVBufferID);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
-
-	// Unbind VAO so no one can change it
-	glBindVertexArray(0);
 }
@@ -1,24 +1,48 @@
 #pragma once
 
+#include <string>
 #include <vector>
 #include "Model.h"
+#include "QuadBuffer.h"
 
 #include <glm/glm.hpp>
 
+// Batch of screen space strings drawn with one font in a single draw call. Every string has its own slot and is laid
+// out again only when it changes, the vertices of all strings are then uploaded together into one streaming buffer
 class TextModel : public Model
 {
 public:
 	TextModel(const std::string& fontTexturePath);
 	~TextModel();
-	// Render text using passed shader. Text need to be set in setTextToRender before it can be rendered
-	void render(const Shader& shader) const override;
-	// Set text to render with x and y representing start position and size is size of the letters
-	void setTextToRender(const std::string& text, int x, int y, int size);
+	// Render all non-empty strings of the batch using passed shader
+	void render(const Shader&) const override;
+	// Set string of a slot with x and y representing start position and size is size of the letters.
+	// Slots are small indices chosen by the caller, the batch grows to hold the highest one
+	void setText(size_t slot, const std::string& text, float x, float y, float size);
+	// Removes string of a slot from the batch
+	void clearText(size_t slot);
+	// Removes strings of all slots from first on
+	void clearTextFrom(size_t first);
 private:
+	struct TextEntry
+	{
+		std::string text;
+		float x = 0.0f;
+		float y = 0.0f;
+		float size = 0.0f;
+		std::vector<QuadBuffer::Vertex> vertices;
+	};
+
 	unsigned int text2DTextureID;              // Texture containing the font
-	unsigned int vao;
-	unsigned int text2DVertexBufferID;      // Buffer containing the vertices
-	unsigned int text2DUVBufferID;          // UVs
+	mutable QuadBuffer quadBuffer;          // Vertices of all strings
+
+	std::vector<TextEntry> entries;
+	// Set when a string changed since the last upload
+	mutable bool dirty = false;
+	// Vertices of all strings gathered for the upload, kept to reuse its memory
+	mutable std::vector<QuadBuffer::Vertex> batchVertices;
 
-	std::vector<glm::vec2> vertices;
-};
\ No newline at end of file
+	// Uploads vertices of all strings into the quad buffer
+	void upload() const;
+	static void layoutText(TextEntry& entry);
+};
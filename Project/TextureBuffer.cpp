@@ -0,0 +1,46 @@
+#include "TextureBuffer.h"
+
+#include <glad/glad.h>
+
+TextureBuffer::TextureBuffer(unsigned int internalFormat) : internalFormat(internalFormat), buffer(0), texture(0), capacity(0)
+{
+}
+
+TextureBuffer::~TextureBuffer()
+{
+	if (texture != 0)
+	{
+		glDeleteTextures(1, &texture);
+		glDeleteBuffers(1, &buffer);
+	}
+}
+
+void TextureBuffer::update(const void* data, size_t size)
+{
+	if (size == 0)
+	{
+		return;
+	}
+
+	// Buffer texture keeps referencing the buffer object when its storage is reallocated, so it's attached only once
+	if (texture == 0)
+	{
+		glGenBuffers(1, &buffer);
+		glGenTextures(1, &texture);
+		glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+		glBufferData(GL_TEXTURE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+		glBindTexture(GL_TEXTURE_BUFFER, texture);
+		glTexBuffer(GL_TEXTURE_BUFFER, internalFormat, buffer);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+	}
+
+	// Grows with headroom so the size rarely changes, otherwise the data goes to fresh storage of the same size
+	if (size > capacity)
+	{
+		capacity = size * 2;
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+
+// Buffer object read by shaders through a samplerBuffer, one texel of the internal format at a time. Holds data that
+// doesn't fit uniforms, e.g. matrices of instanced draws or lights of the frame. Must only be used on the GL thread
+class TextureBuffer
+{
+public:
+	// Internal format of the texels, e.g. GL_RGBA32F
+	explicit TextureBuffer(unsigned int internalFormat);
+	~TextureBuffer();
+	// Replaces the content. The storage is reallocated every time, so draws still reading the previous content don't
+	// stall the upload
+	void update(const void* data, size_t size);
+	// Buffer texture to bind to the sampler of the shader
+	unsigned int getTexture() const { return texture; }
+
+	TextureBuffer(const TextureBuffer& buffer) = delete;
+	TextureBuffer& operator=(const TextureBuffer& buffer) = delete;
+private:
+	unsigned int internalFormat;
+	unsigned int buffer;
+	unsigned int texture;
+	size_t capacity;   // In bytes
+};
@@ -0,0 +1,118 @@
+#include "TextureCache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <vector>
+
+#include <glad/glad.h>
+
+std::string TextureCache::canonicalPath(const std::string & path)
+{
+	std::string normalized = path;
+	std::replace(normalized.begin(), normalized.end(), '\\', '/');
+#ifdef _WIN32
+	// Windows file system is case insensitive
+	std::transform(normalized.begin(), normalized.end(), normalized.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+#endif
+
+	bool absolute = !normalized.empty() && normalized[0] == '/';
+	std::vector<std::string> segments;
+	size_t start = 0;
+	while (start <= normalized.size())
+	{
+		size_t end = normalized.find('/', start);
+		if (end == std::string::npos)
+		{
+			end = normalized.size();
+		}
+		std::string segment = normalized.substr(start, end - start);
+		start = end + 1;
+
+		if (segment.empty() || segment == ".")
+		{
+			continue;
+		}
+		// ".." cancels previous directory unless there's nothing left to cancel
+		if (segment == ".." && !segments.empty() && segments.back() != "..")
+		{
+			segments.pop_back();
+			continue;
+		}
+		segments.push_back(segment);
+	}
+
+	std::string result = absolute ? "/" : "";
+	for (size_t i = 0; i < segments.size(); ++i)
+	{
+		result += (i == 0 ? "" : "/") + segments[i];
+	}
+	return result;
+}
+
+unsigned int TextureCache::find(const std::string & path)
+{
+	auto found = getEntries().find(canonicalPath(path));
+	return found != getEntries().end() ? found->second.textureID : 0;
+}
+
+unsigned int TextureCache::acquire(const std::string & path)
+{
+	auto found = getEntries().find(canonicalPath(path));
+	if (found == getEntries().end())
+	{
+		return 0;
+	}
+
+	++found->second.referenceCount;
+	return found->second.textureID;
+}
+
+void TextureCache::insert(const std::string & path, unsigned int textureID)
+{
+	std::string key = canonicalPath(path);
+	getEntries()[key] = Entry{ textureID, 1 };
+	getPaths()[textureID] = key;
+}
+
+unsigned int TextureCache::load(const std::string & path, const std::function<unsigned int(const std::string&)>& loader)
+{
+	unsigned int textureID = acquire(path);
+	if (textureID == 0)
+	{
+		textureID = loader(path);
+		if (textureID != 0)
+		{
+			insert(path, textureID);
+		}
+	}
+	return textureID;
+}
+
+void TextureCache::release(unsigned int textureID)
+{
+	auto path = getPaths().find(textureID);
+	if (path == getPaths().end())
+	{
+		return;
+	}
+
+	auto entry = getEntries().find(path->second);
+	if (--entry->second.referenceCount == 0)
+	{
+		glDeleteTextures(1, &textureID);
+		getEntries().erase(entry);
+		getPaths().erase(path);
+	}
+}
+
+std::unordered_map<std::string, TextureCache::Entry>& TextureCache::getEntries()
+{
+	static std::unordered_map<std::string, Entry> entries;
+	return entries;
+}
+
+std::unordered_map<unsigned int, std::string>& TextureCache::getPaths()
+{
+	static std::unordered_map<unsigned int, std::string> paths;
+	return paths;
+}
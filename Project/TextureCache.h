@@ -0,0 +1,33 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+// Process-wide registry of loaded textures. Textures are keyed by canonical file path and reference counted,
+// so every model and scene asking for the same file shares one GL texture. Must only be used on the GL thread
+class TextureCache
+{
+public:
+	// Converts path to the form used as a key: forward slashes, "." and "dir/.." segments removed, lower case on Windows
+	static std::string canonicalPath(const std::string& path);
+	// Returns texture loaded from the path without changing its reference count, 0 if it isn't loaded
+	static unsigned int find(const std::string& path);
+	// Returns texture loaded from the path and increments its reference count, 0 if it isn't loaded
+	static unsigned int acquire(const std::string& path);
+	// Registers texture created by the caller with reference count of one
+	static void insert(const std::string& path, unsigned int textureID);
+	// Returns shared texture for the path, calling loader to create it on the first request. Increments reference count
+	static unsigned int load(const std::string& path, const std::function<unsigned int(const std::string&)>& loader);
+	// Decrements reference count and deletes the texture once nobody uses it
+	static void release(unsigned int textureID);
+private:
+	struct Entry
+	{
+		unsigned int textureID;
+		unsigned int referenceCount;
+	};
+
+	static std::unordered_map<std::string, Entry>& getEntries();
+	static std::unordered_map<unsigned int, std::string>& getPaths();
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed size pool of worker threads executing queued tasks
+class ThreadPool
+{
+public:
+	// Creates pool with threadCount workers, 0 means one worker per hardware thread
+	explicit ThreadPool(unsigned int threadCount = 0);
+	~ThreadPool();
+	// Pool shared by the whole application, created on first use
+	static ThreadPool& shared();
+	// Queues task to be executed on one of the workers
+	void submit(std::function<void()> task);
+	// Calls function(i) for every i in [0, count) spread across workers and the calling thread, returns when all calls are done
+	void parallelFor(size_t count, const std::function<void(size_t)>& function);
+	unsigned int getThreadCount() const { return static_cast<unsigned int>(workers.size()); }
+
+	ThreadPool(const ThreadPool& pool) = delete;
+	ThreadPool& operator=(const ThreadPool& pool) = delete;
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable taskAvailable;
+	bool stopping;
+
+	void workerLoop();
+};
@@ -0,0 +1,154 @@
+#include "UniformBuffer.h"
+
+#include <glad/glad.h>
+
+#include "StateTracker.h"
+
+unsigned int UniformBuffer::getBindingPoint(const std::string & blockName)
+{
+	if (blockName == "Camera")
+	{
+		return CAMERA_BLOCK;
+	}
+	if (blockName == "Lights")
+	{
+		return LIGHTS_BLOCK;
+	}
+	if (blockName == "MaterialData")
+	{
+		return MATERIAL_BLOCK;
+	}
+	return NO_BINDING_POINT;
+}
+
+size_t UniformBuffer::getOffsetAlignment()
+{
+	static size_t alignment = 0;
+	if (alignment == 0)
+	{
+		GLint value = 0;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &value);
+		// 256 is the largest alignment drivers report
+		alignment = value > 0 ? static_cast<size_t>(value) : 256;
+	}
+	return alignment;
+}
+
+size_t UniformBuffer::alignSize(size_t size)
+{
+	size_t alignment = getOffsetAlignment();
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+UniformBuffer::UniformBuffer() : buffer(0), size(0)
+{
+}
+
+UniformBuffer::~UniformBuffer()
+{
+	if (buffer != 0)
+	{
+		glDeleteBuffers(1, &buffer);
+	}
+}
+
+void UniformBuffer::create(size_t bufferSize)
+{
+	if (buffer == 0)
+	{
+		glGenBuffers(1, &buffer);
+	}
+	size = bufferSize;
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UniformBuffer::update(const void * data, size_t dataSize, size_t offset) const
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, offset, dataSize, data);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UniformBuffer::bindRange(unsigned int bindingPoint, size_t offset, size_t rangeSize) const
+{
+	glBindBufferRange(GL_UNIFORM_BUFFER, bindingPoint, buffer, offset, rangeSize);
+}
+
+UniformBlockPool & UniformBlockPool::get(UniformBuffer::BindingPoint bindingPoint, size_t blockSize)
+{
+	std::vector<std::unique_ptr<UniformBlockPool>>& pools = getPools();
+	if (pools.size() <= bindingPoint)
+	{
+		pools.resize(bindingPoint + 1);
+	}
+	if (!pools[bindingPoint])
+	{
+		pools[bindingPoint].reset(new UniformBlockPool(bindingPoint, blockSize));
+	}
+	return *pools[bindingPoint];
+}
+
+void UniformBlockPool::releaseAll()
+{
+	getPools().clear();
+}
+
+std::vector<std::unique_ptr<UniformBlockPool>>& UniformBlockPool::getPools()
+{
+	static std::vector<std::unique_ptr<UniformBlockPool>> pools;
+	return pools;
+}
+
+UniformBlockPool::UniformBlockPool(UniformBuffer::BindingPoint bindingPoint, size_t blockSize)
+	: bindingPoint(bindingPoint), blockSize(blockSize), blockStride(UniformBuffer::alignSize(blockSize)), buffer(new UniformBuffer()),
+	blockCount(INITIAL_BLOCK_COUNT)
+{
+	buffer->create(blockStride * blockCount);
+	// Hand out low indices first
+	for (unsigned int i = blockCount; i > 0; --i)
+	{
+		freeBlocks.push_back(i - 1);
+	}
+}
+
+unsigned int UniformBlockPool::allocate(const void * data)
+{
+	if (freeBlocks.empty())
+	{
+		grow();
+	}
+	unsigned int block = freeBlocks.back();
+	freeBlocks.pop_back();
+	buffer->update(data, blockSize, block * blockStride);
+	return block;
+}
+
+void UniformBlockPool::free(unsigned int block)
+{
+	freeBlocks.push_back(block);
+}
+
+void UniformBlockPool::bind(unsigned int block, StateTracker & state) const
+{
+	state.bindUniformBufferRange(bindingPoint, buffer->getID(), block * blockStride, blockSize);
+}
+
+void UniformBlockPool::grow()
+{
+	std::unique_ptr<UniformBuffer> newBuffer(new UniformBuffer());
+	newBuffer->create(buffer->getSize() * 2);
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer->getID());
+	glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer->getID());
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, buffer->getSize());
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	buffer = std::move(newBuffer);
+
+	for (unsigned int i = blockCount * 2; i > blockCount; --i)
+	{
+		freeBlocks.push_back(i - 1);
+	}
+	blockCount *= 2;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+class StateTracker;
+
+// Uniform buffer object. Blocks are attached to fixed binding points by their GLSL name when a program is linked
+// (see Shader), so every program declaring a block reads the same buffer. Must only be used on the GL thread
+class UniformBuffer
+{
+public:
+	// Binding points of the blocks shared by all programs
+	enum BindingPoint : unsigned int
+	{
+		CAMERA_BLOCK = 0,     // "Camera": projection, view and camera position
+		LIGHTS_BLOCK = 1,     // "Lights": light sources of the scene
+		MATERIAL_BLOCK = 2    // "MaterialData": properties of the drawn material
+	};
+	static const unsigned int NO_BINDING_POINT = ~0u;
+
+	// Returns binding point of a block by its name in GLSL, NO_BINDING_POINT for unknown blocks
+	static unsigned int getBindingPoint(const std::string& blockName);
+	// Offsets of ranges bound to a binding point must be multiples of this
+	static size_t getOffsetAlignment();
+	// Rounds size up to the offset alignment
+	static size_t alignSize(size_t size);
+
+	UniformBuffer();
+	~UniformBuffer();
+	// Allocates the buffer, its content is undefined until updated
+	void create(size_t size);
+	// Replaces part of the buffer content
+	void update(const void* data, size_t size, size_t offset = 0) const;
+	// Attaches part of the buffer to the binding point
+	void bindRange(unsigned int bindingPoint, size_t offset, size_t size) const;
+	unsigned int getID() const { return buffer; }
+	size_t getSize() const { return size; }
+
+	UniformBuffer(const UniformBuffer& buffer) = delete;
+	UniformBuffer& operator=(const UniformBuffer& buffer) = delete;
+private:
+	unsigned int buffer;
+	size_t size;
+};
+
+// Array of equally sized blocks in one uniform buffer. Every block is written once when allocated and later bound
+// with a single bind-range call. Grows when full, blocks are addressed by index so they stay valid
+class UniformBlockPool
+{
+public:
+	// Pool of blocks for the binding point, created on first use
+	static UniformBlockPool& get(UniformBuffer::BindingPoint bindingPoint, size_t blockSize);
+	// Deletes all pools, must be called after every block is freed and before the GL context is destroyed
+	static void releaseAll();
+
+	// Copies data into a free block and returns its index
+	unsigned int allocate(const void* data);
+	void free(unsigned int block);
+	// Attaches the block to the pool's binding point
+	void bind(unsigned int block, StateTracker& state) const;
+
+	UniformBlockPool(const UniformBlockPool& pool) = delete;
+	UniformBlockPool& operator=(const UniformBlockPool& pool) = delete;
+private:
+	static const unsigned int INITIAL_BLOCK_COUNT = 64;
+
+	UniformBuffer::BindingPoint bindingPoint;
+	size_t blockSize;
+	size_t blockStride;   // Block size rounded up to the offset alignment
+	std::unique_ptr<UniformBuffer> buffer;
+	std::vector<unsigned int> freeBlocks;
+	unsigned int blockCount;
+
+	UniformBlockPool(UniformBuffer::BindingPoint bindingPoint, size_t blockSize);
+	static std::vector<std::unique_ptr<UniformBlockPool>>& getPools();
+	// Doubles number of blocks and copies the existing ones
+	void grow();
+};
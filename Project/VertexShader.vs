@@ -7,15 +7,60 @@ out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
 
+// Depth pre-pass computes the same position in DepthVertexShader.vs and shading tests depth for equality
+invariant gl_Position;
+
+layout (std140) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 uniform mat4 inverseModel;
 
+// Instanced draws read model and normal matrices from the instance buffer, 8 texels per instance
+uniform bool instanced;
+uniform int firstInstance;
+uniform samplerBuffer instanceMatrices;
+
+// Compact vertices store position relative to the mesh bounding box and octahedral encoded normal
+uniform bool compactVertices;
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+mat4 fetchMatrix(int texel)
+{
+    return mat4(texelFetch(instanceMatrices, texel), texelFetch(instanceMatrices, texel + 1),
+        texelFetch(instanceMatrices, texel + 2), texelFetch(instanceMatrices, texel + 3));
+}
+
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(inverseModel) * aNormal;  
+    vec3 position = compactVertices ? positionOffset + aPos * positionScale : aPos;
+    vec3 normal = compactVertices ? decodeOctahedral(aNormal.xy) : aNormal;
+
+    mat4 modelMatrix = model;
+    mat4 normalMatrix = inverseModel;
+    if (instanced)
+    {
+        int texel = (firstInstance + gl_InstanceID) * 8;
+        modelMatrix = fetchMatrix(texel);
+        normalMatrix = fetchMatrix(texel + 4);
+    }
+
+    FragPos = vec3(modelMatrix * vec4(position, 1.0));
+    Normal = mat3(normalMatrix) * normal;  
     TexCoords = aTexCoords;
     
     gl_Position = projection * view * vec4(FragPos, 1.0);
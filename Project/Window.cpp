@@ -10,11 +10,21 @@
 #define _USE_MATH_DEFINES
 #include <math.h> 
 
+#include "AssetLoader.h"
+#include "GeometryBuffer.h"
+#include "HitchDetector.h"
+#include "UniformBuffer.h"
 #include "Scene.h"
+#include "Shader.h"
 #include "GameScene.h"
 #include "MapScene.h"
 #include "StartScene.h"
 
+// Time each frame may spend creating streamed assets on the GL thread
+static const float ASSET_UPLOAD_BUDGET_MS = 4.0f;
+// Frames longer than two refreshes at 60 Hz are logged as hitches
+static const float HITCH_BUDGET_MS = 33.3f;
+
 Window::Window(int _width, int _height, const std::string & _title)
 {
 	// initialize glfw
@@ -73,6 +83,10 @@ Window::~Window()
 	{
 		delete scene;
 	}
+	// Context is destroyed together with the window, streaming resources and shared geometry must go first
+	AssetLoader::shared().shutdown();
+	GeometryBuffer::releaseAll();
+	UniformBlockPool::releaseAll();
 }
 
 void Window::run()
@@ -80,14 +94,20 @@ void Window::run()
 	// Initialize scene before rendering it
 	scenes.back()->initialize(this);	
 
-	float lastFrame = 0.0f;
+	// Time of loading the first scene isn't part of the first frame
+	float lastFrame = glfwGetTime();
 	while (!glfwWindowShouldClose(window.get()))
 	{
 		float currentFrame = glfwGetTime();
 		float deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
+		// Delta is the length of the previous frame, its events were recorded while it ran
+		HitchDetector::shared().endFrame(deltaTime * 1000.0f, HITCH_BUDGET_MS);
 
 		glfwPollEvents();
+		AssetLoader::shared().update(ASSET_UPLOAD_BUDGET_MS);
+		// Shaders linked in the background meanwhile are reflected now instead of stalling their first draw
+		Shader::finishReadyShaders();
 		render(deltaTime);
 	}
 }
@@ -120,9 +140,12 @@ void Window::keyboardPress(int button, int action)
 	bool goToNextScene = scenes.back()->processKeyEvent(button, action);
 	if (goToNextScene)
 	{
-		delete scenes.back();
+		// Initialize next scene before deleting the current one so shared resources (e.g. font texture) stay loaded
+		HitchDetector::shared().addEvent("scene change");
+		Scene* finishedScene = scenes.back();
 		scenes.pop_back();
 		scenes.back()->initialize(this);
+		delete finishedScene;
 	}
 	// Close application
 	if (glfwGetKey(window.get(), GLFW_KEY_ESCAPE) == GLFW_PRESS)
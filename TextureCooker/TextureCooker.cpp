@@ -0,0 +1,373 @@
+#include "TextureCooker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sys/stat.h>
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <stb_image/stb_image.h>
+extern "C"
+{
+#include <stb_image/image_DXT.h>
+}
+
+#include "../Project/AtlasPacker.h"
+#include "../Project/tinyxml2.h"
+#include "../Project/ThreadPool.h"
+
+using namespace tinyxml2;
+
+#define FOURCC_DXT1 0x31545844 // Equivalent to "DXT1" in ASCII
+#define FOURCC_DXT5 0x35545844 // Equivalent to "DXT5" in ASCII
+
+namespace
+{
+	// Halves RGBA image with a box filter. Odd sizes repeat the last row/column
+	std::vector<unsigned char> downsample(const std::vector<unsigned char>& pixels, int width, int height, int& newWidth, int& newHeight)
+	{
+		newWidth = std::max(1, width / 2);
+		newHeight = std::max(1, height / 2);
+		std::vector<unsigned char> result(static_cast<size_t>(newWidth) * newHeight * 4);
+
+		for (int y = 0; y < newHeight; ++y)
+		{
+			int y0 = std::min(2 * y, height - 1);
+			int y1 = std::min(2 * y + 1, height - 1);
+			for (int x = 0; x < newWidth; ++x)
+			{
+				int x0 = std::min(2 * x, width - 1);
+				int x1 = std::min(2 * x + 1, width - 1);
+				for (int c = 0; c < 4; ++c)
+				{
+					int sum = pixels[(static_cast<size_t>(y0) * width + x0) * 4 + c] + pixels[(static_cast<size_t>(y0) * width + x1) * 4 + c]
+						+ pixels[(static_cast<size_t>(y1) * width + x0) * 4 + c] + pixels[(static_cast<size_t>(y1) * width + x1) * 4 + c];
+					result[(static_cast<size_t>(y) * newWidth + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+				}
+			}
+		}
+
+		return result;
+	}
+
+	void writeDDS(std::ofstream& file, int width, int height, unsigned int mipCount, bool hasAlpha, size_t firstLevelSize)
+	{
+		DDS_header header;
+		memset(&header, 0, sizeof(header));
+		header.dwMagic = ('D' << 0) | ('D' << 8) | ('S' << 16) | (' ' << 24);
+		header.dwSize = 124;
+		header.dwFlags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE | DDSD_MIPMAPCOUNT;
+		header.dwWidth = width;
+		header.dwHeight = height;
+		header.dwPitchOrLinearSize = static_cast<unsigned int>(firstLevelSize);
+		header.dwMipMapCount = mipCount;
+		header.sPixelFormat.dwSize = 32;
+		header.sPixelFormat.dwFlags = DDPF_FOURCC;
+		header.sPixelFormat.dwFourCC = hasAlpha ? FOURCC_DXT5 : FOURCC_DXT1;
+		header.sCaps.dwCaps1 = DDSCAPS_TEXTURE | DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	}
+}
+
+TextureCooker::TextureCooker(bool force) : force(force)
+{
+}
+
+bool TextureCooker::addGameData(const std::string & gameFile)
+{
+	XMLDocument document;
+	document.LoadFile(gameFile.c_str());
+	if (document.Error())
+	{
+		std::cout << "Unable to load " << gameFile << std::endl;
+		return false;
+	}
+
+	XMLElement* gameElement = document.FirstChildElement("Game");
+	if (gameElement == nullptr)
+	{
+		std::cout << "Game element is missing in " << gameFile << std::endl;
+		return false;
+	}
+
+	XMLElement* staticModelsElement = gameElement->FirstChildElement("StaticModels");
+	if (staticModelsElement != nullptr)
+	{
+		for (const char* group : { "OpaqueModels", "TransparentModels" })
+		{
+			XMLElement* groupElement = staticModelsElement->FirstChildElement(group);
+			for (XMLElement* modelElement = groupElement ? groupElement->FirstChildElement("Model") : nullptr; modelElement != nullptr; modelElement = modelElement->NextSiblingElement("Model"))
+			{
+				if (modelElement->GetText() != nullptr)
+				{
+					addModelTextures(modelElement->GetText());
+				}
+			}
+		}
+
+		XMLElement* skyboxElement = staticModelsElement->FirstChildElement("Skybox");
+		for (XMLElement* faceElement = skyboxElement ? skyboxElement->FirstChildElement("Face") : nullptr; faceElement != nullptr; faceElement = faceElement->NextSiblingElement("Face"))
+		{
+			if (faceElement->GetText() != nullptr)
+			{
+				addTexture(faceElement->GetText());
+			}
+		}
+	}
+
+	XMLElement* hiddenObjectsElement = gameElement->FirstChildElement("HiddenObjects");
+	for (XMLElement* objectElement = hiddenObjectsElement ? hiddenObjectsElement->FirstChildElement("HiddenObject") : nullptr; objectElement != nullptr; objectElement = objectElement->NextSiblingElement("HiddenObject"))
+	{
+		XMLElement* modelElement = objectElement->FirstChildElement("Model");
+		if (modelElement != nullptr && modelElement->GetText() != nullptr)
+		{
+			addModelTextures(modelElement->GetText());
+		}
+		// Icons are only drawn from the HUD atlas
+		XMLElement* iconElement = objectElement->FirstChildElement("Icon");
+		if (iconElement != nullptr && iconElement->GetText() != nullptr)
+		{
+			addAtlasSprite(iconElement->GetText());
+		}
+	}
+
+	return true;
+}
+
+void TextureCooker::addTexture(const std::string & path)
+{
+	addUnique(textures, path);
+}
+
+void TextureCooker::addAtlasSprite(const std::string & path)
+{
+	addUnique(atlasSprites, path);
+}
+
+void TextureCooker::addUnique(std::vector<std::string>& paths, const std::string & path)
+{
+	std::string normalized = path;
+	std::replace(normalized.begin(), normalized.end(), '\\', '/');
+	if (std::find(paths.begin(), paths.end(), normalized) == paths.end())
+	{
+		paths.push_back(normalized);
+	}
+}
+
+void TextureCooker::addModelTextures(const std::string & modelPath)
+{
+	// Only materials are needed so no post processing is requested
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(modelPath, 0);
+	if (scene == nullptr)
+	{
+		std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+		return;
+	}
+
+	// Texture paths are relative to the model directory, same as in Model3D
+	std::string directory = modelPath.substr(0, modelPath.find_last_of('/'));
+	for (unsigned int i = 0; i < scene->mNumMaterials; ++i)
+	{
+		for (aiTextureType type : { aiTextureType_DIFFUSE, aiTextureType_SPECULAR })
+		{
+			for (unsigned int j = 0; j < scene->mMaterials[i]->GetTextureCount(type); ++j)
+			{
+				aiString texturePath;
+				scene->mMaterials[i]->GetTexture(type, j, &texturePath);
+				addTexture(directory + "/" + texturePath.C_Str());
+			}
+		}
+	}
+}
+
+int TextureCooker::cook(const std::string& atlasPath) const
+{
+	std::atomic<int> failures{ 0 };
+	std::mutex outputMutex;
+	ThreadPool::shared().parallelFor(textures.size(), [this, &failures, &outputMutex](size_t i)
+	{
+		bool cooked = cookTexture(textures[i]);
+		std::lock_guard<std::mutex> lock(outputMutex);
+		std::cout << (cooked ? "Cooked " : "FAILED ") << textures[i] << std::endl;
+		if (!cooked)
+		{
+			++failures;
+		}
+	});
+
+	if (!atlasSprites.empty())
+	{
+		bool cooked = cookAtlas(atlasPath);
+		std::cout << (cooked ? "Cooked " : "FAILED ") << atlasPath << " with " << atlasSprites.size() << " sprites" << std::endl;
+		if (!cooked)
+		{
+			++failures;
+		}
+	}
+	return failures;
+}
+
+bool TextureCooker::cookTexture(const std::string & path) const
+{
+	std::string cookedPath = path + ".dds";
+	if (!force && isUpToDate(path, cookedPath))
+	{
+		return true;
+	}
+
+	// Work in RGBA so every mip level can be filtered the same way
+	int width, height, components;
+	unsigned char* data = stbi_load(path.c_str(), &width, &height, &components, 4);
+	if (data == nullptr)
+	{
+		return false;
+	}
+	std::vector<unsigned char> pixels(data, data + static_cast<size_t>(width) * height * 4);
+	stbi_image_free(data);
+
+	return writeCookedImage(cookedPath, std::move(pixels), width, height);
+}
+
+bool TextureCooker::cookAtlas(const std::string & atlasPath) const
+{
+	std::string cookedPath = atlasPath + ".dds";
+	std::string descriptorPath = atlasPath + ".xml";
+	if (!force && std::all_of(atlasSprites.begin(), atlasSprites.end(), [&](const std::string& path) {
+		return isUpToDate(path, cookedPath) && isUpToDate(path, descriptorPath); }))
+	{
+		// Atlas is still repacked when the set of sprites changed
+		XMLDocument document;
+		document.LoadFile(descriptorPath.c_str());
+		XMLElement* atlasElement = document.Error() ? nullptr : document.FirstChildElement("Atlas");
+		size_t spriteCount = 0;
+		for (XMLElement* spriteElement = atlasElement ? atlasElement->FirstChildElement("Sprite") : nullptr; spriteElement != nullptr; spriteElement = spriteElement->NextSiblingElement("Sprite"))
+		{
+			const char* name = spriteElement->Attribute("name");
+			if (name == nullptr || std::find(atlasSprites.begin(), atlasSprites.end(), name) == atlasSprites.end())
+			{
+				break;
+			}
+			++spriteCount;
+		}
+		if (spriteCount == atlasSprites.size())
+		{
+			return true;
+		}
+	}
+
+	// Same packing as the game uses when the atlas isn't cooked
+	std::vector<std::vector<unsigned char>> images(atlasSprites.size());
+	std::vector<AtlasPacker::Rect> rects(atlasSprites.size());
+	for (size_t i = 0; i < atlasSprites.size(); ++i)
+	{
+		int components;
+		unsigned char* data = stbi_load(atlasSprites[i].c_str(), &rects[i].width, &rects[i].height, &components, 4);
+		if (data == nullptr)
+		{
+			std::cout << "Unable to load atlas sprite " << atlasSprites[i] << std::endl;
+			return false;
+		}
+		images[i].assign(data, data + static_cast<size_t>(rects[i].width) * rects[i].height * 4);
+		stbi_image_free(data);
+	}
+
+	int width = 0;
+	int height = 0;
+	if (!AtlasPacker::pack(rects, AtlasPacker::SPRITE_PADDING, AtlasPacker::MAX_ATLAS_SIZE, width, height))
+	{
+		std::cout << "Atlas sprites don't fit into " << AtlasPacker::MAX_ATLAS_SIZE << "x" << AtlasPacker::MAX_ATLAS_SIZE << std::endl;
+		return false;
+	}
+	std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * 4, 0);
+	for (size_t i = 0; i < atlasSprites.size(); ++i)
+	{
+		AtlasPacker::copyImage(pixels, width, height, images[i].data(), rects[i], AtlasPacker::SPRITE_PADDING);
+	}
+	if (!writeCookedImage(cookedPath, std::move(pixels), width, height))
+	{
+		return false;
+	}
+
+	XMLDocument document;
+	XMLElement* atlasElement = document.NewElement("Atlas");
+	document.InsertEndChild(atlasElement);
+	atlasElement->SetAttribute("width", width);
+	atlasElement->SetAttribute("height", height);
+	for (size_t i = 0; i < atlasSprites.size(); ++i)
+	{
+		XMLElement* spriteElement = document.NewElement("Sprite");
+		atlasElement->InsertEndChild(spriteElement);
+		spriteElement->SetAttribute("name", atlasSprites[i].c_str());
+		spriteElement->SetAttribute("x", rects[i].x);
+		spriteElement->SetAttribute("y", rects[i].y);
+		spriteElement->SetAttribute("width", rects[i].width);
+		spriteElement->SetAttribute("height", rects[i].height);
+	}
+	return document.SaveFile(descriptorPath.c_str()) == XML_SUCCESS;
+}
+
+bool TextureCooker::writeCookedImage(const std::string & cookedPath, std::vector<unsigned char> pixels, int width, int height)
+{
+	// DXT5 is only worth it when the image actually uses its alpha channel
+	bool hasAlpha = false;
+	for (size_t i = 3; i < pixels.size() && !hasAlpha; i += 4)
+	{
+		hasAlpha = pixels[i] != 255;
+	}
+
+	std::ofstream file(cookedPath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	unsigned int mipCount = 1;
+	for (int size = std::max(width, height); size > 1; size /= 2)
+	{
+		++mipCount;
+	}
+	size_t firstLevelSize = static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * (hasAlpha ? 16 : 8);
+	writeDDS(file, width, height, mipCount, hasAlpha, firstLevelSize);
+
+	int levelWidth = width;
+	int levelHeight = height;
+	for (unsigned int level = 0; level < mipCount; ++level)
+	{
+		int compressedSize = 0;
+		unsigned char* compressed = hasAlpha
+			? convert_image_to_DXT5(pixels.data(), levelWidth, levelHeight, 4, &compressedSize)
+			: convert_image_to_DXT1(pixels.data(), levelWidth, levelHeight, 4, &compressedSize);
+		if (compressed == nullptr)
+		{
+			file.close();
+			std::remove(cookedPath.c_str());
+			return false;
+		}
+		file.write(reinterpret_cast<const char*>(compressed), compressedSize);
+		free(compressed);
+
+		if (level + 1 < mipCount)
+		{
+			pixels = downsample(pixels, levelWidth, levelHeight, levelWidth, levelHeight);
+		}
+	}
+
+	return file.good();
+}
+
+bool TextureCooker::isUpToDate(const std::string & path, const std::string & cookedPath)
+{
+	struct stat sourceStat;
+	struct stat cookedStat;
+	if (stat(path.c_str(), &sourceStat) != 0 || stat(cookedPath.c_str(), &cookedStat) != 0)
+	{
+		return false;
+	}
+	return cookedStat.st_mtime >= sourceStat.st_mtime;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Converts textures used by the game into block compressed DDS files (DXT1 for opaque, DXT5 for images with alpha)
+// with full precomputed mip chains. Cooked file is written next to the source image as <image>.dds, which the game
+// loads instead of the source image when it exists. HUD images are packed into one atlas instead, written as
+// <atlas>.dds with an <atlas>.xml list of sprite rects
+class TextureCooker
+{
+public:
+	// When force is false, textures whose cooked file is newer than the source are skipped
+	explicit TextureCooker(bool force);
+	// Collects every texture referenced by the game data file: model materials, hidden object icons and skybox faces
+	bool addGameData(const std::string& gameFile);
+	// Adds single image to cook
+	void addTexture(const std::string& path);
+	// Adds image to pack into the atlas
+	void addAtlasSprite(const std::string& path);
+	// Cooks all collected textures on all cores and packs the atlas at atlasPath, returns number of textures that failed
+	int cook(const std::string& atlasPath) const;
+private:
+	std::vector<std::string> textures;
+	std::vector<std::string> atlasSprites;
+	bool force;
+
+	// Collects diffuse and specular textures of all model materials
+	void addModelTextures(const std::string& modelPath);
+	// Compresses one image with its mip chain and writes it as DDS
+	bool cookTexture(const std::string& path) const;
+	// Packs all atlas sprites into one image, cooks it and writes the sprite list
+	bool cookAtlas(const std::string& atlasPath) const;
+	// Compresses RGBA pixels with their mip chain and writes them as DDS
+	static bool writeCookedImage(const std::string& cookedPath, std::vector<unsigned char> pixels, int width, int height);
+	// Adds path normalized to forward slashes to the list unless it is already there
+	static void addUnique(std::vector<std::string>& paths, const std::string& path);
+	// Checks if the cooked file is newer than the source image
+	static bool isUpToDate(const std::string& path, const std::string& cookedPath);
+};
@@ -0,0 +1,46 @@
+#include <cstring>
+#include <iostream>
+
+#include "TextureCooker.h"
+
+// Usage: TextureCooker [--force] [GameData.xml] [extra images...]
+// Hidden object icons and the city map are packed into the HUD atlas, other images are cooked one by one
+// Paths are resolved the same way as in the game, so run it from a directory next to Assets
+int main(int argc, char* argv[])
+{
+	bool force = false;
+	std::string gameFile = "../Assets/GameData.xml";
+	std::string atlasPath = "../Assets/hud_atlas";
+	std::vector<std::string> extraTextures;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--force") == 0)
+		{
+			force = true;
+		}
+		else if (strstr(argv[i], ".xml") != nullptr)
+		{
+			gameFile = argv[i];
+		}
+		else
+		{
+			extraTextures.push_back(argv[i]);
+		}
+	}
+
+	TextureCooker cooker(force);
+	if (!cooker.addGameData(gameFile))
+	{
+		return 1;
+	}
+	cooker.addAtlasSprite("../Assets/city_map/map.png");
+	for (const auto& texture : extraTextures)
+	{
+		cooker.addTexture(texture);
+	}
+
+	int failures = cooker.cook(atlasPath);
+	std::cout << (failures == 0 ? "All textures cooked" : std::to_string(failures) + " textures failed") << std::endl;
+	return failures == 0 ? 0 : 1;
+}